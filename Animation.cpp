@@ -1,11 +1,144 @@
 #include "Animation.h"
 
+#include <stdlib.h> //malloc, free
+
 #include "GameMaths.h"
 
-void animate(const KmxSkeleton& skeleton, int32 animationIndex, float currentAnimationTime, mat4* inverseBindPoses, mat4** outputPoseMats)
+void init_animation_cursor(KmxAnimationCursor* cursor, const KmxSkeleton& skeleton)
+{
+	cursor->animationIndex = -1;
+	cursor->numBones = skeleton.numBones;
+	cursor->traKeyHints = (uint32*)calloc(skeleton.numBones, sizeof(uint32));
+	cursor->rotKeyHints = (uint32*)calloc(skeleton.numBones, sizeof(uint32));
+}
+
+void free_animation_cursor(KmxAnimationCursor* cursor)
+{
+	free(cursor->traKeyHints);
+	free(cursor->rotKeyHints);
+	*cursor = {};
+}
+
+void sync_animation_cursor(KmxAnimationCursor* cursor, int32 animationIndex)
+{
+	// Hints from a different animation are meaningless
+	if(cursor->animationIndex == animationIndex) return;
+
+	for(uint32 boneIndex = 0; boneIndex < cursor->numBones; ++boneIndex)
+	{
+		cursor->traKeyHints[boneIndex] = 0;
+		cursor->rotKeyHints[boneIndex] = 0;
+	}
+	cursor->animationIndex = animationIndex;
+}
+
+// Finds one bone's local translation, and the two rotation keys either side of time plus how far between them we are
+// (so the slerps can be done for many bones at once). Bones with no keys get identity
+static void _sample_bone_keys(const KmxSkeleton& skeleton, const KmxBoneKeyFrames* boneKeyFrames, uint32 boneIndex, float time,
+							  KmxAnimationCursor* cursor, vec3* outTranslation, versor* outRotateFrom, versor* outRotateTo, float* outRotateT)
+{
+	*outTranslation = {};
+	if(boneKeyFrames->numTraKeys > 0)
+	{
+		float* traKeyTimes = (float*)(&skeleton.data + boneKeyFrames->traKeyTimesOffset);
+		vec3* traKeys = (vec3*)(&skeleton.data + boneKeyFrames->traKeysOffset);
+		uint32 numKeys = boneKeyFrames->numTraKeys;
+
+		uint32 hint = cursor ? cursor->traKeyHints[boneIndex] : 0;
+		uint32 i = find_next_key(traKeyTimes, numKeys, time, hint);
+		if(cursor) cursor->traKeyHints[boneIndex] = i;
+
+		vec3 lerpedTrans = traKeys[numKeys-1]; // hold last key if we're past it
+		if(i < numKeys)
+		{
+			float keyFrameDuration = traKeyTimes[i] - traKeyTimes[i-1];
+			float t = (time - traKeyTimes[i-1]) / keyFrameDuration;
+
+			vec3 transFrom = traKeys[i-1];
+			vec3 transTo   = traKeys[i];
+			lerpedTrans = transFrom + (transTo-transFrom) * t;
+		}
+		*outTranslation = lerpedTrans;
+	}
+
+	*outRotateFrom = {1, 0, 0, 0};
+	*outRotateTo = {1, 0, 0, 0};
+	*outRotateT = 0;
+	if(boneKeyFrames->numRotKeys > 0)
+	{
+		float* rotKeyTimes = (float*)(&skeleton.data + boneKeyFrames->rotKeyTimesOffset);
+		versor* rotKeys = (versor*)(&skeleton.data + boneKeyFrames->rotKeysOffset);
+		uint32 numKeys = boneKeyFrames->numRotKeys;
+
+		uint32 hint = cursor ? cursor->rotKeyHints[boneIndex] : 0;
+		uint32 i = find_next_key(rotKeyTimes, numKeys, time, hint);
+		if(cursor) cursor->rotKeyHints[boneIndex] = i;
+
+		if(i < numKeys)
+		{
+			float keyFrameDuration = rotKeyTimes[i] - rotKeyTimes[i-1];
+			*outRotateT = (time - rotKeyTimes[i-1]) / keyFrameDuration;
+			*outRotateFrom = rotKeys[i-1];
+			*outRotateTo   = rotKeys[i];
+		}
+		else *outRotateFrom = *outRotateTo = rotKeys[numKeys-1]; // hold last key if we're past it
+	}
+}
+
+#define SAMPLE_BONE_GROUP_SIZE 64 // bones sampled together, their rotations go through one slerp_batch() call
+
+// One group's local pose, laid out like LocalPose. Entry i is bone boneIndex[i]
+struct _BoneGroupSample {
+	uint32 numBones;
+	uint32 boneIndex[SAMPLE_BONE_GROUP_SIZE];
+	float tx[SAMPLE_BONE_GROUP_SIZE], ty[SAMPLE_BONE_GROUP_SIZE], tz[SAMPLE_BONE_GROUP_SIZE];
+	float qw[SAMPLE_BONE_GROUP_SIZE], qx[SAMPLE_BONE_GROUP_SIZE], qy[SAMPLE_BONE_GROUP_SIZE], qz[SAMPLE_BONE_GROUP_SIZE];
+};
+
+// Samples bones [firstBone, firstBone + numBones), leaving out any boneMask (optional) is 0 for.
+// Keys are looked up bone by bone, then every rotation in the group is slerped in one go
+static void _sample_bone_group(const KmxSkeleton& skeleton, const KmxBoneKeyFrames* keys, uint32 firstBone, uint32 numBones,
+							   float time, KmxAnimationCursor* cursor, const uint8* boneMask, _BoneGroupSample* outSample)
+{
+	assert(numBones <= SAMPLE_BONE_GROUP_SIZE);
+	float toW[SAMPLE_BONE_GROUP_SIZE], toX[SAMPLE_BONE_GROUP_SIZE], toY[SAMPLE_BONE_GROUP_SIZE], toZ[SAMPLE_BONE_GROUP_SIZE];
+	float rotateT[SAMPLE_BONE_GROUP_SIZE];
+
+	// Masked out bones are skipped here, so the group is packed and slerp_batch() only does the bones we need
+	uint32 numSampled = 0;
+	for(uint32 boneIndex = firstBone; boneIndex < firstBone + numBones; ++boneIndex)
+	{
+		if(boneMask && !boneMask[boneIndex]) continue;
+		uint32 i = numSampled++;
+		outSample->boneIndex[i] = boneIndex;
+
+		vec3 translation;
+		versor rotateFrom, rotateTo;
+		_sample_bone_keys(skeleton, &keys[boneIndex], boneIndex, time, cursor, &translation, &rotateFrom, &rotateTo, &rotateT[i]);
+
+		outSample->tx[i] = translation.x;
+		outSample->ty[i] = translation.y;
+		outSample->tz[i] = translation.z;
+		outSample->qw[i] = rotateFrom.q[0];
+		outSample->qx[i] = rotateFrom.q[1];
+		outSample->qy[i] = rotateFrom.q[2];
+		outSample->qz[i] = rotateFrom.q[3];
+		toW[i] = rotateTo.q[0];
+		toX[i] = rotateTo.q[1];
+		toY[i] = rotateTo.q[2];
+		toZ[i] = rotateTo.q[3];
+	}
+	outSample->numBones = numSampled;
+
+	versor_soa rotations = {outSample->qw, outSample->qx, outSample->qy, outSample->qz};
+	versor_soa rotateToKeys = {toW, toX, toY, toZ};
+	slerp_batch(rotations, rotateToKeys, rotateT, rotations, numSampled);
+}
+
+void animate(const KmxSkeleton& skeleton, int32 animationIndex, float currentAnimationTime, const mat4* inverseBindPoses, mat4** outputPoseMats, KmxAnimationCursor* cursor)
 {
 	// Invalid animationIndex, set output to bind pose
-	if((animationIndex >= skeleton.numAnimations) || (animationIndex < 0))
+	if((animationIndex < 0) || ((uint32)animationIndex >= skeleton.numAnimations))
 	{
 		// printf("Warning: Invalid animation index %i\n", animationIndex);
 		for(uint32 boneIndex = 0; boneIndex < skeleton.numBones; ++boneIndex)
@@ -15,7 +148,6 @@ void animate(const KmxSkeleton& skeleton, int32 animationIndex, float currentAni
 		return;
 	}
 	
-	KmxBone* bones = (KmxBone*)(&skeleton.data + skeleton.bonesOffset);
 	KmxAnimation* animations = (KmxAnimation*)(&skeleton.data + skeleton.animationsOffset);
 	
 	KmxAnimation* animation = &animations[animationIndex];
@@ -23,55 +155,152 @@ void animate(const KmxSkeleton& skeleton, int32 animationIndex, float currentAni
 
 	KmxBoneKeyFrames* keys = (KmxBoneKeyFrames*)(&skeleton.data + animation->keyFramesOffset);
 
-	for(uint32 boneIndex = 0; boneIndex < skeleton.numBones; ++boneIndex)
+	if(cursor)
+	{
+		assert(cursor->numBones == skeleton.numBones);
+		sync_animation_cursor(cursor, animationIndex);
+	}
+
+	// Bones are independent until we walk the hierarchy, so sample them all first
+	for(uint32 firstBone = 0; firstBone < skeleton.numBones; firstBone += SAMPLE_BONE_GROUP_SIZE)
+	{
+		uint32 numGroupBones = MIN(skeleton.numBones - firstBone, (uint32)SAMPLE_BONE_GROUP_SIZE);
+		_BoneGroupSample sample;
+		_sample_bone_group(skeleton, keys, firstBone, numGroupBones, currentAnimationTime, cursor, NULL, &sample);
+
+		for(uint32 i = 0; i < numGroupBones; ++i)
+		{
+			vec3 currBoneTranslation = {sample.tx[i], sample.ty[i], sample.tz[i]};
+			versor currBoneRotation = {sample.qw[i], sample.qx[i], sample.qy[i], sample.qz[i]};
+			(*outputPoseMats)[firstBone + i] = bone_local_mat(currBoneTranslation, currBoneRotation);
+		}
+	}
+
+	concatenate_bone_transforms(skeleton, *outputPoseMats);
+	multiply_inverse_bind_poses(*outputPoseMats, inverseBindPoses, skeleton.numBones, *outputPoseMats);
+}
+
+void local_pose_from_channels(LocalPose* pose, uint32 numBones, float* channels)
+{
+	pose->numBones = numBones;
+	pose->stride = LOCAL_POSE_STRIDE(numBones);
+	pose->tx = channels;
+	pose->ty = channels + pose->stride;
+	pose->tz = channels + 2*pose->stride;
+	pose->qw = channels + 3*pose->stride;
+	pose->qx = channels + 4*pose->stride;
+	pose->qy = channels + 5*pose->stride;
+	pose->qz = channels + 6*pose->stride;
+}
+
+void init_local_pose(LocalPose* pose, uint32 numBones)
+{
+	float* channels = (float*)malloc(LOCAL_POSE_NUM_CHANNELS * LOCAL_POSE_STRIDE(numBones) * sizeof(float));
+	local_pose_from_channels(pose, numBones, channels);
+
+	for(uint32 boneIndex = 0; boneIndex < pose->stride; ++boneIndex)
+	{
+		pose->tx[boneIndex] = pose->ty[boneIndex] = pose->tz[boneIndex] = 0;
+		pose->qw[boneIndex] = 1;
+		pose->qx[boneIndex] = pose->qy[boneIndex] = pose->qz[boneIndex] = 0;
+	}
+}
+
+void free_local_pose(LocalPose* pose)
+{
+	free(pose->tx); // start of the allocation
+	*pose = {};
+}
+
+void sample_local_pose(const KmxSkeleton& skeleton, int32 animationIndex, float currentAnimationTime, LocalPose* outputPose,
+					   KmxAnimationCursor* cursor, const uint8* boneMask)
+{
+	assert(outputPose->numBones == skeleton.numBones);
+	bool isValidAnimation = (animationIndex >= 0) && ((uint32)animationIndex < skeleton.numAnimations);
+
+	KmxBoneKeyFrames* keys = NULL;
+	if(isValidAnimation)
 	{
-		KmxBoneKeyFrames* currBoneKeyFrames = &keys[boneIndex];
+		KmxAnimation* animations = (KmxAnimation*)(&skeleton.data + skeleton.animationsOffset);
+		KmxAnimation* animation = &animations[animationIndex];
+		assert(currentAnimationTime <= animation->duration);
+		keys = (KmxBoneKeyFrames*)(&skeleton.data + animation->keyFramesOffset);
 
-		mat4 currBoneTranslation = identity_mat4();
-		for(uint32 i = 0; (i < (currBoneKeyFrames->numTraKeys - 1)); ++i)
+		if(cursor)
 		{
-			float* traKeyTimes = (float*)(&skeleton.data + currBoneKeyFrames->traKeyTimesOffset);
-
-			if(traKeyTimes[i+1] >= currentAnimationTime)
-			{
-				vec3* traKeys = (vec3*)(&skeleton.data + currBoneKeyFrames->traKeysOffset);
-				float keyFrameDuration = traKeyTimes[i+1] - traKeyTimes[i];
-				float t = (currentAnimationTime - traKeyTimes[i]) / keyFrameDuration;
-
-				vec3 transFrom = traKeys[i];
-				vec3 transTo   = traKeys[i+1];
-				vec3 lerpedTrans = transFrom + (transTo-transFrom) * t;
-				currBoneTranslation = translate(identity_mat4(), lerpedTrans);
-				break;
-			}
+			assert(cursor->numBones == skeleton.numBones);
+			sync_animation_cursor(cursor, animationIndex);
 		}
+	}
 
-		mat4 currBoneRotation = identity_mat4();
-		for(uint32 i = 0; (i < (currBoneKeyFrames->numRotKeys - 1)); ++i)
+	if(!isValidAnimation)
+	{
+		for(uint32 boneIndex = 0; boneIndex < skeleton.numBones; ++boneIndex)
 		{
-			float* rotKeyTimes = (float*)(&skeleton.data + currBoneKeyFrames->rotKeyTimesOffset);
-
-			if(rotKeyTimes[i+1] >= currentAnimationTime)
-			{
-				versor* rotKeys = (versor*)(&skeleton.data + currBoneKeyFrames->rotKeysOffset);
-				float keyFrameDuration = rotKeyTimes[i+1] - rotKeyTimes[i];
-				float t = (currentAnimationTime - rotKeyTimes[i]) / keyFrameDuration;
-
-				versor rotateFrom = rotKeys[i];
-				versor rotateTo   = rotKeys[i+1];
-				versor slerpedRot = slerp(rotateFrom, rotateTo, t);
-				currBoneRotation = quat_to_mat4(slerpedRot);
-				break;
-			}
+			if(boneMask && !boneMask[boneIndex]) continue;
+			outputPose->tx[boneIndex] = outputPose->ty[boneIndex] = outputPose->tz[boneIndex] = 0;
+			outputPose->qw[boneIndex] = 1;
+			outputPose->qx[boneIndex] = outputPose->qy[boneIndex] = outputPose->qz[boneIndex] = 0;
 		}
+		return;
+	}
+
+	for(uint32 firstBone = 0; firstBone < skeleton.numBones; firstBone += SAMPLE_BONE_GROUP_SIZE)
+	{
+		uint32 numGroupBones = MIN(skeleton.numBones - firstBone, (uint32)SAMPLE_BONE_GROUP_SIZE);
+		_BoneGroupSample sample;
+		_sample_bone_group(skeleton, keys, firstBone, numGroupBones, currentAnimationTime, cursor, boneMask, &sample);
 
-		KmxBone* currBone = &bones[boneIndex];
-		mat4 parentMat = identity_mat4();
-		if(currBone->parentIndex >= 0){
-			parentMat = (*outputPoseMats)[currBone->parentIndex];
+		for(uint32 i = 0; i < sample.numBones; ++i)
+		{
+			uint32 boneIndex = sample.boneIndex[i];
+			outputPose->tx[boneIndex] = sample.tx[i];
+			outputPose->ty[boneIndex] = sample.ty[i];
+			outputPose->tz[boneIndex] = sample.tz[i];
+			outputPose->qw[boneIndex] = sample.qw[i];
+			outputPose->qx[boneIndex] = sample.qx[i];
+			outputPose->qy[boneIndex] = sample.qy[i];
+			outputPose->qz[boneIndex] = sample.qz[i];
 		}
-		mat4 currBoneLocalTransform = currBoneTranslation * currBoneRotation;
-		mat4 currBonePoseMat = parentMat * currBoneLocalTransform * inverseBindPoses[boneIndex];
-		(*outputPoseMats)[boneIndex] = currBonePoseMat;
 	}
 }
+
+void local_pose_to_pose_mats(const KmxSkeleton& skeleton, const LocalPose& pose, const mat4* inverseBindPoses, mat4* outputPoseMats)
+{
+	for(uint32 boneIndex = 0; boneIndex < skeleton.numBones; ++boneIndex)
+	{
+		vec3 translation = {pose.tx[boneIndex], pose.ty[boneIndex], pose.tz[boneIndex]};
+		versor rotation = {pose.qw[boneIndex], pose.qx[boneIndex], pose.qy[boneIndex], pose.qz[boneIndex]};
+		outputPoseMats[boneIndex] = bone_local_mat(translation, rotation);
+	}
+
+	concatenate_bone_transforms(skeleton, outputPoseMats);
+	multiply_inverse_bind_poses(outputPoseMats, inverseBindPoses, skeleton.numBones, outputPoseMats);
+}
+
+mat4 bone_local_mat(vec3 translation, versor rotation)
+{
+	// Same as translate(identity_mat4(), translation) * quat_to_mat4(rotation)
+	mat4 result = quat_to_mat4(rotation);
+	result.m[12] = translation.x;
+	result.m[13] = translation.y;
+	result.m[14] = translation.z;
+	return result;
+}
+
+void concatenate_bone_transforms(const KmxSkeleton& skeleton, mat4* mats)
+{
+	KmxBone* bones = (KmxBone*)(&skeleton.data + skeleton.bonesOffset);
+	for(uint32 boneIndex = 0; boneIndex < skeleton.numBones; ++boneIndex)
+	{
+		int32 parentIndex = bones[boneIndex].parentIndex;
+		assert(parentIndex < (int32)boneIndex); // parents first, see validate_kmx_skeleton()
+		if(parentIndex >= 0) mats[boneIndex] = mats[parentIndex] * mats[boneIndex];
+	}
+}
+
+void multiply_inverse_bind_poses(const mat4* modelMats, const mat4* inverseBindPoses, uint32 numBones, mat4* outputPoseMats)
+{
+	// No dependencies between bones here, unlike concatenate_bone_transforms()
+	mul_mat4_array(modelMats, inverseBindPoses, outputPoseMats, numBones);
+}
@@ -61,8 +61,91 @@ struct KmxBoneKeyFrames {
 };
 
 struct mat4;
+struct vec3;
+struct versor;
+
+// Optional per-instance playback state for animate()
+// Remembers which keyframes each bone used last time, so playing forwards finds the next keys in O(1)
+// instead of a binary search. Gives exactly the same poses as animating without one.
+struct KmxAnimationCursor {
+	int32 animationIndex;
+	uint32 numBones;
+	uint32* traKeyHints; // per bone: index of the key after the current time at the last sample
+	uint32* rotKeyHints;
+};
+
+void init_animation_cursor(KmxAnimationCursor* cursor, const KmxSkeleton& skeleton);
+void free_animation_cursor(KmxAnimationCursor* cursor);
+// Clears the cursor's hints if it was last used for a different animation
+void sync_animation_cursor(KmxAnimationCursor* cursor, int32 animationIndex);
+
+// Returns the index of the first key at or after time, not counting key 0 (so in [1, numKeys-1]),
+// or numKeys if time is past the last key. Keys [result-1, result] then bracket time.
+// hint is a previous result for this track (0 if there isn't one). It's checked first so forward playback is O(1),
+// otherwise we binary search whichever side of it time is on.
+// KeyTime is float for KmxSkeleton animations, uint16 for compressed ones (time in the same units as the keys)
+template <typename KeyTime>
+uint32 find_next_key(const KeyTime* keyTimes, uint32 numKeys, float time, uint32 hint)
+{
+	// Answer is in [lo, hi], treating keyTimes[numKeys] as +infinity
+	uint32 lo = 1;
+	uint32 hi = numKeys;
+	if((hint >= 1) && (hint <= numKeys))
+	{
+		if((hint == 1) || (keyTimes[hint-1] < time)) // answer is hint or later
+		{
+			if((hint == numKeys) || (keyTimes[hint] >= time)) return hint;
+			if((hint+1 == numKeys) || (keyTimes[hint+1] >= time)) return hint+1;
+			lo = hint+2;
+		}
+		else hi = hint-1; // went backwards (e.g. looped)
+	}
+
+	while(lo < hi)
+	{
+		uint32 mid = lo + (hi - lo)/2;
+		if(keyTimes[mid] >= time) hi = mid;
+		else lo = mid+1;
+	}
+	return lo;
+}
 
-void animate(const KmxSkeleton& skeleton, int32 animationIndex, float currentAnimationTime, mat4* inverseBindPoses, mat4** outputPoseMats);
+// A skeleton's local (relative to parent) bone transforms, one array per component so they can be
+// processed 4 (SSE) or 8 (AVX) bones at a time. Arrays are padded to a multiple of 8 bones so
+// there's never a leftover, padding bones are identity.
+struct LocalPose {
+	uint32 numBones;
+	uint32 stride; // LOCAL_POSE_STRIDE(numBones)
+	float* tx; float* ty; float* tz;             // translation
+	float* qw; float* qx; float* qy; float* qz;  // rotation
+};
+#define LOCAL_POSE_NUM_CHANNELS 7
+#define LOCAL_POSE_STRIDE(numBones) (((numBones) + 7) & ~7u)
+
+void init_local_pose(LocalPose* pose, uint32 numBones);
+void free_local_pose(LocalPose* pose);
+// Points pose at existing data laid out like a LocalPose's (LOCAL_POSE_NUM_CHANNELS arrays of stride floats), doesn't allocate
+void local_pose_from_channels(LocalPose* pose, uint32 numBones, float* channels);
+
+// Same sampling as animate(), but stops at local transforms. Invalid animationIndex gives identity transforms
+// boneMask (optional, one per bone): bones where it's 0 aren't sampled and keep whatever outputPose had
+void sample_local_pose(const KmxSkeleton& skeleton, int32 animationIndex, float currentAnimationTime, LocalPose* outputPose,
+					   KmxAnimationCursor* cursor = NULL, const uint8* boneMask = NULL);
+// Concatenates local transforms down the hierarchy into skinning matrices, like the second half of animate()
+void local_pose_to_pose_mats(const KmxSkeleton& skeleton, const LocalPose& pose, const mat4* inverseBindPoses, mat4* outputPoseMats);
+
+// Rotation keys are interpolated SAMPLE_BONE_GROUP_SIZE bones at a time with slerp_batch() (see slerp_fast() for its accuracy)
+void animate(const KmxSkeleton& skeleton, int32 animationIndex, float currentAnimationTime, const mat4* inverseBindPoses, mat4** outputPoseMats, KmxAnimationCursor* cursor = NULL);
+
+// Skinning matrices are built in two passes over the whole skeleton, after every bone's local transform is known:
+//  1. concatenate_bone_transforms() walks the hierarchy, turning local transforms into model space ones
+//  2. multiply_inverse_bind_poses() multiplies each by its bone's inverse bind pose, no dependencies between bones
+// Pass 1 needs parents to come before their children, KmxLoader refuses skeletons where they don't.
+mat4 bone_local_mat(vec3 translation, versor rotation);
+// In place: mats[i] = mats[parent] * mats[i] in bone order
+void concatenate_bone_transforms(const KmxSkeleton& skeleton, mat4* mats);
+// outputPoseMats[i] = modelMats[i] * inverseBindPoses[i], outputPoseMats may be modelMats
+void multiply_inverse_bind_poses(const mat4* modelMats, const mat4* inverseBindPoses, uint32 numBones, mat4* outputPoseMats);
 
 /*
 	KmxSkeleton skel;
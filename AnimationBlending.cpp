@@ -0,0 +1,175 @@
+#include "AnimationBlending.h"
+
+#include "GameMaths.h"
+
+// The kernels below are written once against "Lanes", a group of bones processed together:
+// 8 with AVX, 4 with SSE, 1 without SIMD. LocalPose arrays are padded to a multiple of 8 so
+// there's never a leftover.
+#if GAMEMATHS_AVX
+#define LANE_COUNT 8
+typedef __m256 Lanes;
+static inline Lanes lanes_load(const float* p) { return _mm256_loadu_ps(p); }
+static inline void lanes_store(float* p, Lanes a) { _mm256_storeu_ps(p, a); }
+static inline Lanes lanes_set(float x) { return _mm256_set1_ps(x); }
+static inline Lanes lanes_add(Lanes a, Lanes b) { return _mm256_add_ps(a, b); }
+static inline Lanes lanes_sub(Lanes a, Lanes b) { return _mm256_sub_ps(a, b); }
+static inline Lanes lanes_mul(Lanes a, Lanes b) { return _mm256_mul_ps(a, b); }
+static inline Lanes lanes_inv_sqrt(Lanes a) { return fast_inv_sqrt256_ps(a); }
+// a with its sign flipped wherever signSource is negative
+static inline Lanes lanes_flip_sign(Lanes a, Lanes signSource) { return _mm256_xor_ps(a, _mm256_and_ps(signSource, _mm256_set1_ps(-0.0f))); }
+
+#elif GAMEMATHS_SSE
+#define LANE_COUNT 4
+typedef __m128 Lanes;
+static inline Lanes lanes_load(const float* p) { return _mm_loadu_ps(p); }
+static inline void lanes_store(float* p, Lanes a) { _mm_storeu_ps(p, a); }
+static inline Lanes lanes_set(float x) { return _mm_set1_ps(x); }
+static inline Lanes lanes_add(Lanes a, Lanes b) { return _mm_add_ps(a, b); }
+static inline Lanes lanes_sub(Lanes a, Lanes b) { return _mm_sub_ps(a, b); }
+static inline Lanes lanes_mul(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+static inline Lanes lanes_inv_sqrt(Lanes a) { return fast_inv_sqrt_ps(a); }
+static inline Lanes lanes_flip_sign(Lanes a, Lanes signSource) { return _mm_xor_ps(a, _mm_and_ps(signSource, _mm_set1_ps(-0.0f))); }
+
+#else
+#define LANE_COUNT 1
+typedef float Lanes;
+static inline Lanes lanes_load(const float* p) { return *p; }
+static inline void lanes_store(float* p, Lanes a) { *p = a; }
+static inline Lanes lanes_set(float x) { return x; }
+static inline Lanes lanes_add(Lanes a, Lanes b) { return a + b; }
+static inline Lanes lanes_sub(Lanes a, Lanes b) { return a - b; }
+static inline Lanes lanes_mul(Lanes a, Lanes b) { return a * b; }
+static inline Lanes lanes_inv_sqrt(Lanes a) { return fast_inv_sqrtf(a); }
+static inline Lanes lanes_flip_sign(Lanes a, Lanes signSource) { return (signSource < 0) ? -a : a; }
+#endif
+
+struct LanesQuat {
+	Lanes w, x, y, z;
+};
+
+static inline LanesQuat _load_rotations(const LocalPose& pose, uint32 b)
+{
+	LanesQuat q = {lanes_load(&pose.qw[b]), lanes_load(&pose.qx[b]), lanes_load(&pose.qy[b]), lanes_load(&pose.qz[b])};
+	return q;
+}
+
+static inline void _store_normalised_rotations(LocalPose* pose, uint32 b, LanesQuat q)
+{
+	Lanes lengthSq = lanes_add(lanes_add(lanes_mul(q.w, q.w), lanes_mul(q.x, q.x)), lanes_add(lanes_mul(q.y, q.y), lanes_mul(q.z, q.z)));
+	Lanes invLength = lanes_inv_sqrt(lengthSq);
+	lanes_store(&pose->qw[b], lanes_mul(q.w, invLength));
+	lanes_store(&pose->qx[b], lanes_mul(q.x, invLength));
+	lanes_store(&pose->qy[b], lanes_mul(q.y, invLength));
+	lanes_store(&pose->qz[b], lanes_mul(q.z, invLength));
+}
+
+static inline Lanes _quat_dot(LanesQuat a, LanesQuat b)
+{
+	return lanes_add(lanes_add(lanes_mul(a.w, b.w), lanes_mul(a.x, b.x)), lanes_add(lanes_mul(a.y, b.y), lanes_mul(a.z, b.z)));
+}
+
+// a * b, same convention as versor operator*
+static inline LanesQuat _quat_mul(LanesQuat a, LanesQuat b)
+{
+	LanesQuat result;
+	result.w = lanes_sub(lanes_sub(lanes_mul(a.w, b.w), lanes_mul(a.x, b.x)), lanes_add(lanes_mul(a.y, b.y), lanes_mul(a.z, b.z)));
+	result.x = lanes_add(lanes_add(lanes_mul(a.w, b.x), lanes_mul(a.x, b.w)), lanes_sub(lanes_mul(a.y, b.z), lanes_mul(a.z, b.y)));
+	result.y = lanes_add(lanes_add(lanes_mul(a.w, b.y), lanes_mul(a.y, b.w)), lanes_sub(lanes_mul(a.z, b.x), lanes_mul(a.x, b.z)));
+	result.z = lanes_add(lanes_add(lanes_mul(a.w, b.z), lanes_mul(a.z, b.w)), lanes_sub(lanes_mul(a.x, b.y), lanes_mul(a.y, b.x)));
+	return result;
+}
+
+void blend_local_poses(const LocalPose* poses, const float* weights, uint32 numPoses, LocalPose* outputPose)
+{
+	assert(numPoses > 0);
+	float totalWeight = 0;
+	for(uint32 i = 0; i < numPoses; ++i)
+	{
+		assert(poses[i].stride == outputPose->stride);
+		totalWeight += weights[i];
+	}
+	assert(totalWeight > 0);
+	float invTotalWeight = 1.0f / totalWeight;
+
+	for(uint32 b = 0; b < outputPose->stride; b += LANE_COUNT)
+	{
+		Lanes w = lanes_set(weights[0] * invTotalWeight);
+		Lanes tx = lanes_mul(lanes_load(&poses[0].tx[b]), w);
+		Lanes ty = lanes_mul(lanes_load(&poses[0].ty[b]), w);
+		Lanes tz = lanes_mul(lanes_load(&poses[0].tz[b]), w);
+		LanesQuat first = _load_rotations(poses[0], b);
+		LanesQuat q = {lanes_mul(first.w, w), lanes_mul(first.x, w), lanes_mul(first.y, w), lanes_mul(first.z, w)};
+
+		for(uint32 i = 1; i < numPoses; ++i)
+		{
+			w = lanes_set(weights[i] * invTotalWeight);
+			tx = lanes_add(tx, lanes_mul(lanes_load(&poses[i].tx[b]), w));
+			ty = lanes_add(ty, lanes_mul(lanes_load(&poses[i].ty[b]), w));
+			tz = lanes_add(tz, lanes_mul(lanes_load(&poses[i].tz[b]), w));
+
+			// q and -q are the same rotation, keep everything on the same side as the first pose
+			LanesQuat r = _load_rotations(poses[i], b);
+			Lanes signedW = lanes_flip_sign(w, _quat_dot(first, r));
+			q.w = lanes_add(q.w, lanes_mul(r.w, signedW));
+			q.x = lanes_add(q.x, lanes_mul(r.x, signedW));
+			q.y = lanes_add(q.y, lanes_mul(r.y, signedW));
+			q.z = lanes_add(q.z, lanes_mul(r.z, signedW));
+		}
+
+		lanes_store(&outputPose->tx[b], tx);
+		lanes_store(&outputPose->ty[b], ty);
+		lanes_store(&outputPose->tz[b], tz);
+		_store_normalised_rotations(outputPose, b, q);
+	}
+}
+
+void make_additive_pose(const LocalPose& pose, const LocalPose& referencePose, LocalPose* outputDelta)
+{
+	assert((pose.stride == referencePose.stride) && (pose.stride == outputDelta->stride));
+
+	for(uint32 b = 0; b < pose.stride; b += LANE_COUNT)
+	{
+		lanes_store(&outputDelta->tx[b], lanes_sub(lanes_load(&pose.tx[b]), lanes_load(&referencePose.tx[b])));
+		lanes_store(&outputDelta->ty[b], lanes_sub(lanes_load(&pose.ty[b]), lanes_load(&referencePose.ty[b])));
+		lanes_store(&outputDelta->tz[b], lanes_sub(lanes_load(&pose.tz[b]), lanes_load(&referencePose.tz[b])));
+
+		// delta = pose * inverse(reference), so delta * reference = pose
+		LanesQuat ref = _load_rotations(referencePose, b);
+		LanesQuat invRef = {ref.w, lanes_sub(lanes_set(0), ref.x), lanes_sub(lanes_set(0), ref.y), lanes_sub(lanes_set(0), ref.z)};
+		_store_normalised_rotations(outputDelta, b, _quat_mul(_load_rotations(pose, b), invRef));
+	}
+}
+
+void apply_additive_pose(LocalPose* pose, const LocalPose& additivePose, float weight, const float* boneWeights)
+{
+	assert(pose->stride == additivePose.stride);
+
+	for(uint32 b = 0; b < pose->stride; b += LANE_COUNT)
+	{
+		Lanes w = lanes_set(weight);
+		if(boneWeights)
+		{
+			// boneWeights isn't padded, pad with 0 so the identity padding bones stay identity
+			float maskedWeights[LANE_COUNT];
+			for(uint32 i = 0; i < LANE_COUNT; ++i)
+				maskedWeights[i] = (b + i < pose->numBones) ? weight * boneWeights[b + i] : 0.0f;
+			w = lanes_load(maskedWeights);
+		}
+
+		lanes_store(&pose->tx[b], lanes_add(lanes_load(&pose->tx[b]), lanes_mul(lanes_load(&additivePose.tx[b]), w)));
+		lanes_store(&pose->ty[b], lanes_add(lanes_load(&pose->ty[b]), lanes_mul(lanes_load(&additivePose.ty[b]), w)));
+		lanes_store(&pose->tz[b], lanes_add(lanes_load(&pose->tz[b]), lanes_mul(lanes_load(&additivePose.tz[b]), w)));
+
+		// Scale the delta rotation by nlerping it from identity, then apply it on top
+		LanesQuat delta = _load_rotations(additivePose, b);
+		// q and -q are the same rotation, use the one nearest identity (w >= 0) to nlerp the short way
+		Lanes sign = lanes_flip_sign(lanes_set(1.0f), delta.w);
+		LanesQuat scaledDelta;
+		scaledDelta.w = lanes_add(lanes_set(1.0f), lanes_mul(lanes_sub(lanes_mul(delta.w, sign), lanes_set(1.0f)), w));
+		scaledDelta.x = lanes_mul(lanes_mul(delta.x, sign), w);
+		scaledDelta.y = lanes_mul(lanes_mul(delta.y, sign), w);
+		scaledDelta.z = lanes_mul(lanes_mul(delta.z, sign), w);
+
+		_store_normalised_rotations(pose, b, _quat_mul(scaledDelta, _load_rotations(*pose, b)));
+	}
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "utils.h"
+#include "Animation.h"
+
+// Local space pose blending. The pipeline for a character is:
+//   sample_local_pose()/sample_soa_clip() for each clip
+//   -> blend_local_poses() to mix them (e.g. walk/run by speed)
+//   -> apply_additive_pose() for layers on top (e.g. breathing, aim offsets)
+//   -> local_pose_to_pose_mats() once at the end to walk the hierarchy
+// Rotations are blended with normalised lerp, which is cheap and fine for the small angles
+// between poses that are being mixed. All poses must be for the same number of bones.
+
+// outputPose = weighted average of poses. Weights don't need to add up to 1 but must be > 0 in total
+// outputPose can be one of the inputs
+void blend_local_poses(const LocalPose* poses, const float* weights, uint32 numPoses, LocalPose* outputPose);
+
+// outputDelta = the difference between pose and referencePose, to be layered on other poses with apply_additive_pose()
+// (e.g. referencePose = first frame of an idle, pose = the same idle leaning left)
+void make_additive_pose(const LocalPose& pose, const LocalPose& referencePose, LocalPose* outputDelta);
+
+// Adds weight * additivePose on top of pose. boneWeights (optional, one per bone) scales the weight per bone,
+// so a layer can be masked to part of the skeleton
+void apply_additive_pose(LocalPose* pose, const LocalPose& additivePose, float weight, const float* boneWeights = NULL);
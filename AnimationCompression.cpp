@@ -0,0 +1,432 @@
+#include "AnimationCompression.h"
+
+#include <stdlib.h> //malloc, free
+#include <string.h> //memcpy, memset
+#include <stddef.h> //offsetof
+
+#include "GameMaths.h"
+
+#define KMX_COMPRESSED_CLIPS_MAGIC   0x43584D4B // "KMXC"
+#define KMX_COMPRESSED_CLIPS_VERSION 1
+
+// Key times and translations are quantised to the full uint16 range
+#define UINT16_QUANT 65535.0f
+// Smallest-three components are in [-1/sqrt(2), 1/sqrt(2)]
+#define ROT_COMPONENT_RANGE 0.70710678f
+#define ROT_COMPONENT_QUANT 32767.0f
+
+static uint32 _align4(uint32 x) { return (x + 3) & ~3u; }
+
+static uint16 _quantise_unit(float x, float quant) // x in [0,1]
+{
+	return (uint16)(CLAMP(x, 0.0f, 1.0f) * quant + 0.5f);
+}
+
+static void _encode_rotation(versor q, uint16* out)
+{
+	uint32 largest = 0;
+	for(uint32 i = 1; i < 4; ++i){
+		if(fabs(q.q[i]) > fabs(q.q[largest])) largest = i;
+	}
+	// q and -q are the same rotation, pick the one where the dropped component is positive
+	if(q.q[largest] < 0) q = -q;
+
+	uint32 j = 0;
+	for(uint32 i = 0; i < 4; ++i){
+		if(i == largest) continue;
+		float c = (q.q[i] / ROT_COMPONENT_RANGE) * 0.5f + 0.5f;
+		out[j++] = _quantise_unit(c, ROT_COMPONENT_QUANT);
+	}
+	out[0] |= (uint16)((largest >> 1) << 15);
+	out[1] |= (uint16)((largest & 1) << 15);
+}
+
+static versor _decode_rotation(const uint16* in)
+{
+	uint32 largest = ((in[0] >> 15) << 1) | (in[1] >> 15);
+
+	versor result;
+	float sumSq = 0;
+	uint32 j = 0;
+	for(uint32 i = 0; i < 4; ++i){
+		if(i == largest) continue;
+		float c = ((in[j++] & 0x7FFF) / ROT_COMPONENT_QUANT * 2.0f - 1.0f) * ROT_COMPONENT_RANGE;
+		result.q[i] = c;
+		sumSq += c*c;
+	}
+	result.q[largest] = sqrtf(MAX(1.0f - sumSq, 0.0f));
+	return result;
+}
+
+// Angle of the rotation between q and r
+// (2*acos(|dot(q, r)|) is too imprecise in float for angles this small)
+static float _rotation_error(versor q, versor r)
+{
+	if(dot(q, r) < 0) r = -r;
+	float distSq = 0;
+	for(int i = 0; i < 4; ++i){
+		float d = q.q[i] - r.q[i];
+		distSq += d*d;
+	}
+	return 4.0f * asinf(MIN(0.5f * sqrtf(distSq), 1.0f));
+}
+
+// Worst case _rotation_error() of an _encode_rotation()/_decode_rotation() round trip: each stored component is off by
+// at most half a step, and rebuilding the dropped one (>= 0.5) from them can triple that, ~7.5e-5 chord length
+#define ROT_QUANT_MAX_ERROR 1.5e-4f
+
+// How far key k is from interpolating keys a and b at t (with a == b, t = 0, how far it is from key a)
+typedef float (*KeyErrorFunc)(const void* keys, uint32 a, uint32 b, uint32 k, float t);
+
+static float _translation_key_error(const void* keys, uint32 a, uint32 b, uint32 k, float t)
+{
+	const vec3* tra = (const vec3*)keys;
+	vec3 lerped = tra[a] + (tra[b] - tra[a]) * t;
+	return length(lerped - tra[k]);
+}
+
+static float _rotation_key_error(const void* keys, uint32 a, uint32 b, uint32 k, float t)
+{
+	const versor* rot = (const versor*)keys;
+	return _rotation_error(slerp_fast(rot[a], rot[b], t), rot[k]);
+}
+
+// Greedy keyframe reduction: starting from a kept key, extend the span to the furthest key such that
+// interpolating across it (the same way animate_compressed() does) reproduces every skipped key within tolerance.
+// Sampling between keys is linear in both versions, so checking the skipped keys is enough.
+// Quantisation adds its own error on top, so the tolerance used here is maxError minus:
+//  - quantError: worst case error from quantising the key values
+//  - the track's fastest key-to-key speed times timeQuantError (how far quantising can move a key time)
+// Writes indices of kept keys to outKept and returns how many there are.
+// A track that never moves further than the tolerance from its first key collapses to a single key.
+static uint32 _reduce_keys(const float* times, const void* keys, uint32 numKeys, KeyErrorFunc keyError,
+						   float maxError, float quantError, float timeQuantError, uint32* outKept)
+{
+	float maxSpeed = 0;
+	for(uint32 k = 0; k+1 < numKeys; ++k){
+		float keyDuration = times[k+1] - times[k];
+		if(keyDuration > 0) maxSpeed = MAX(maxSpeed, keyError(keys, k, k, k+1, 0.0f) / keyDuration);
+	}
+	float tolerance = MAX(maxError - quantError - maxSpeed * timeQuantError, 0.0f);
+
+	bool isConstant = true;
+	for(uint32 k = 1; k < numKeys && isConstant; ++k){
+		isConstant = keyError(keys, 0, 0, k, 0.0f) <= tolerance;
+	}
+	if(isConstant || numKeys < 3){
+		uint32 numKept = 0;
+		for(uint32 k = 0; k < (isConstant ? MIN(numKeys, 1u) : numKeys); ++k) outKept[numKept++] = k;
+		return numKept;
+	}
+
+	uint32 numKept = 0;
+	uint32 anchor = 0;
+	outKept[numKept++] = anchor;
+	while(anchor < numKeys-1)
+	{
+		uint32 end = anchor + 1;
+		while(end+1 < numKeys)
+		{
+			uint32 candidate = end + 1;
+			float spanDuration = times[candidate] - times[anchor];
+			bool fits = true;
+			for(uint32 k = anchor+1; k < candidate && fits; ++k)
+			{
+				float t = (spanDuration > 0) ? (times[k] - times[anchor]) / spanDuration : 0.0f;
+				fits = keyError(keys, anchor, candidate, k, t) <= tolerance;
+			}
+			if(!fits) break;
+			end = candidate;
+		}
+		outKept[numKept++] = end;
+		anchor = end;
+	}
+	return numKept;
+}
+
+// Worst case error from quantising translations to 16 bits of their range: half a step per component
+static float _translation_quant_error(const vec3* keys, uint32 numKeys)
+{
+	if(numKeys == 0) return 0.0f;
+	vec3 minTra = keys[0];
+	vec3 maxTra = keys[0];
+	for(uint32 k = 1; k < numKeys; ++k){
+		for(int c = 0; c < 3; ++c){
+			minTra.v[c] = MIN(minTra.v[c], keys[k].v[c]);
+			maxTra.v[c] = MAX(maxTra.v[c], keys[k].v[c]);
+		}
+	}
+	return 0.5f * length(maxTra - minTra) / UINT16_QUANT;
+}
+
+KmxCompressedClips* compress_animations(const KmxSkeleton& skeleton, const KmxCompressionSettings& settings, uint32* outSize)
+{
+	KmxAnimation* animations = (KmxAnimation*)(&skeleton.data + skeleton.animationsOffset);
+	uint32 numBones = skeleton.numBones;
+	uint32 numTracks = skeleton.numAnimations * numBones;
+
+	// Pass 1: pick which keys to keep for every track, and work out how big everything is
+	uint32 totalKeys = 0;
+	for(uint32 animIndex = 0; animIndex < skeleton.numAnimations; ++animIndex){
+		KmxBoneKeyFrames* keys = (KmxBoneKeyFrames*)(&skeleton.data + animations[animIndex].keyFramesOffset);
+		for(uint32 boneIndex = 0; boneIndex < numBones; ++boneIndex){
+			totalKeys += keys[boneIndex].numTraKeys + keys[boneIndex].numRotKeys;
+		}
+	}
+	uint32* keptKeys = (uint32*)malloc(MAX(totalKeys, 1u) * sizeof(uint32));
+	uint32* numKeptTraKeys = (uint32*)malloc(MAX(numTracks, 1u) * sizeof(uint32));
+	uint32* numKeptRotKeys = (uint32*)malloc(MAX(numTracks, 1u) * sizeof(uint32));
+
+	uint32 headerSize = offsetof(KmxCompressedClips, data);
+	uint32 animationsOffset = 0;
+	uint32 dataSize = animationsOffset + skeleton.numAnimations * sizeof(KmxCompressedAnimation);
+	uint32 firstTrackOffset = dataSize;
+	dataSize += numTracks * sizeof(KmxCompressedTrack);
+
+	uint32 keptCursor = 0;
+	for(uint32 animIndex = 0; animIndex < skeleton.numAnimations; ++animIndex)
+	{
+		KmxBoneKeyFrames* keys = (KmxBoneKeyFrames*)(&skeleton.data + animations[animIndex].keyFramesOffset);
+		// Key times are rounded to the nearest 1/65535th of the clip
+		float timeQuantError = 0.5f * animations[animIndex].duration / UINT16_QUANT;
+		for(uint32 boneIndex = 0; boneIndex < numBones; ++boneIndex)
+		{
+			KmxBoneKeyFrames* boneKeys = &keys[boneIndex];
+			uint32 trackIndex = animIndex * numBones + boneIndex;
+
+			vec3* traKeys = (vec3*)(&skeleton.data + boneKeys->traKeysOffset);
+			numKeptTraKeys[trackIndex] = _reduce_keys((float*)(&skeleton.data + boneKeys->traKeyTimesOffset), traKeys, boneKeys->numTraKeys,
+				_translation_key_error, settings.maxTranslationError, _translation_quant_error(traKeys, boneKeys->numTraKeys), timeQuantError,
+				&keptKeys[keptCursor]);
+			keptCursor += numKeptTraKeys[trackIndex];
+
+			numKeptRotKeys[trackIndex] = _reduce_keys((float*)(&skeleton.data + boneKeys->rotKeyTimesOffset),
+				(versor*)(&skeleton.data + boneKeys->rotKeysOffset), boneKeys->numRotKeys,
+				_rotation_key_error, settings.maxRotationError, ROT_QUANT_MAX_ERROR, timeQuantError, &keptKeys[keptCursor]);
+			keptCursor += numKeptRotKeys[trackIndex];
+
+			dataSize += _align4(numKeptTraKeys[trackIndex] * sizeof(uint16));
+			dataSize += _align4(numKeptTraKeys[trackIndex] * 3 * sizeof(uint16));
+			dataSize += _align4(numKeptRotKeys[trackIndex] * sizeof(uint16));
+			dataSize += _align4(numKeptRotKeys[trackIndex] * 3 * sizeof(uint16));
+		}
+	}
+
+	// Pass 2: write it out
+	uint32 totalSize = headerSize + dataSize;
+	KmxCompressedClips* clips = (KmxCompressedClips*)malloc(totalSize);
+	memset(clips, 0, totalSize);
+	clips->magic = KMX_COMPRESSED_CLIPS_MAGIC;
+	clips->version = KMX_COMPRESSED_CLIPS_VERSION;
+	clips->numBones = numBones;
+	clips->numAnimations = skeleton.numAnimations;
+	clips->animationsOffset = animationsOffset;
+
+	KmxCompressedAnimation* compressedAnims = (KmxCompressedAnimation*)(&clips->data + animationsOffset);
+	KmxCompressedTrack* tracks = (KmxCompressedTrack*)(&clips->data + firstTrackOffset);
+	uint32 keyDataOffset = firstTrackOffset + numTracks * sizeof(KmxCompressedTrack);
+
+	keptCursor = 0;
+	for(uint32 animIndex = 0; animIndex < skeleton.numAnimations; ++animIndex)
+	{
+		KmxAnimation* animation = &animations[animIndex];
+		KmxCompressedAnimation* compressedAnim = &compressedAnims[animIndex];
+		memcpy(compressedAnim->name, animation->name, sizeof(compressedAnim->name));
+		compressedAnim->duration = animation->duration;
+		compressedAnim->tracksOffset = firstTrackOffset + animIndex * numBones * sizeof(KmxCompressedTrack);
+
+		float invDuration = (animation->duration > 0) ? 1.0f / animation->duration : 0.0f;
+
+		KmxBoneKeyFrames* keys = (KmxBoneKeyFrames*)(&skeleton.data + animation->keyFramesOffset);
+		for(uint32 boneIndex = 0; boneIndex < numBones; ++boneIndex)
+		{
+			KmxBoneKeyFrames* boneKeys = &keys[boneIndex];
+			uint32 trackIndex = animIndex * numBones + boneIndex;
+			KmxCompressedTrack* track = &tracks[trackIndex];
+
+			// Translations
+			{
+				float* srcTimes = (float*)(&skeleton.data + boneKeys->traKeyTimesOffset);
+				vec3* srcKeys = (vec3*)(&skeleton.data + boneKeys->traKeysOffset);
+				uint32* kept = &keptKeys[keptCursor];
+				uint32 numKept = numKeptTraKeys[trackIndex];
+				keptCursor += numKept;
+
+				track->numTraKeys = numKept;
+				track->traKeyTimesOffset = keyDataOffset;
+				keyDataOffset += _align4(numKept * sizeof(uint16));
+				track->traKeysOffset = keyDataOffset;
+				keyDataOffset += _align4(numKept * 3 * sizeof(uint16));
+
+				vec3 minTra = (numKept > 0) ? srcKeys[kept[0]] : vec3{};
+				vec3 maxTra = minTra;
+				for(uint32 k = 1; k < numKept; ++k){
+					vec3 v = srcKeys[kept[k]];
+					for(int c = 0; c < 3; ++c){
+						minTra.v[c] = MIN(minTra.v[c], v.v[c]);
+						maxTra.v[c] = MAX(maxTra.v[c], v.v[c]);
+					}
+				}
+				for(int c = 0; c < 3; ++c){
+					track->traMin[c] = minTra.v[c];
+					track->traScale[c] = (maxTra.v[c] - minTra.v[c]) / UINT16_QUANT;
+				}
+
+				uint16* dstTimes = (uint16*)(&clips->data + track->traKeyTimesOffset);
+				uint16* dstKeys = (uint16*)(&clips->data + track->traKeysOffset);
+				for(uint32 k = 0; k < numKept; ++k)
+				{
+					dstTimes[k] = _quantise_unit(srcTimes[kept[k]] * invDuration, UINT16_QUANT);
+					vec3 v = srcKeys[kept[k]];
+					for(int c = 0; c < 3; ++c){
+						float range = maxTra.v[c] - minTra.v[c];
+						float x = (range > 0) ? (v.v[c] - minTra.v[c]) / range : 0.0f;
+						dstKeys[3*k + c] = _quantise_unit(x, UINT16_QUANT);
+					}
+				}
+			}
+
+			// Rotations
+			{
+				float* srcTimes = (float*)(&skeleton.data + boneKeys->rotKeyTimesOffset);
+				versor* srcKeys = (versor*)(&skeleton.data + boneKeys->rotKeysOffset);
+				uint32* kept = &keptKeys[keptCursor];
+				uint32 numKept = numKeptRotKeys[trackIndex];
+				keptCursor += numKept;
+
+				track->numRotKeys = numKept;
+				track->rotKeyTimesOffset = keyDataOffset;
+				keyDataOffset += _align4(numKept * sizeof(uint16));
+				track->rotKeysOffset = keyDataOffset;
+				keyDataOffset += _align4(numKept * 3 * sizeof(uint16));
+
+				uint16* dstTimes = (uint16*)(&clips->data + track->rotKeyTimesOffset);
+				uint16* dstKeys = (uint16*)(&clips->data + track->rotKeysOffset);
+				for(uint32 k = 0; k < numKept; ++k)
+				{
+					dstTimes[k] = _quantise_unit(srcTimes[kept[k]] * invDuration, UINT16_QUANT);
+					_encode_rotation(srcKeys[kept[k]], &dstKeys[3*k]);
+				}
+			}
+		}
+	}
+	assert(keyDataOffset == dataSize);
+
+	free(keptKeys);
+	free(numKeptTraKeys);
+	free(numKeptRotKeys);
+
+	if(outSize) *outSize = totalSize;
+	return clips;
+}
+
+uint32 animation_data_size(const KmxSkeleton& skeleton)
+{
+	KmxAnimation* animations = (KmxAnimation*)(&skeleton.data + skeleton.animationsOffset);
+	uint32 size = skeleton.numAnimations * (sizeof(KmxAnimation) + skeleton.numBones * sizeof(KmxBoneKeyFrames));
+	for(uint32 animIndex = 0; animIndex < skeleton.numAnimations; ++animIndex){
+		KmxBoneKeyFrames* keys = (KmxBoneKeyFrames*)(&skeleton.data + animations[animIndex].keyFramesOffset);
+		for(uint32 boneIndex = 0; boneIndex < skeleton.numBones; ++boneIndex){
+			size += keys[boneIndex].numTraKeys * (sizeof(float) + sizeof(vec3));
+			size += keys[boneIndex].numRotKeys * (sizeof(float) + sizeof(versor));
+		}
+	}
+	return size;
+}
+
+// Interpolation factor between two quantised key times. Keys can land on the same time after quantising
+static float _key_lerp_factor(const uint16* keyTimes, uint32 i, float time)
+{
+	float keyFrameDuration = (float)(keyTimes[i] - keyTimes[i-1]);
+	if(keyFrameDuration <= 0) return 1.0f;
+	return (time - keyTimes[i-1]) / keyFrameDuration;
+}
+
+void animate_compressed(const KmxSkeleton& skeleton, const KmxCompressedClips& clips, int32 animationIndex, float currentAnimationTime,
+						const mat4* inverseBindPoses, mat4** outputPoseMats, KmxAnimationCursor* cursor)
+{
+	assert(clips.magic == KMX_COMPRESSED_CLIPS_MAGIC);
+	assert(clips.numBones == skeleton.numBones);
+
+	// Invalid animationIndex, set output to bind pose
+	if((animationIndex < 0) || ((uint32)animationIndex >= clips.numAnimations))
+	{
+		for(uint32 boneIndex = 0; boneIndex < skeleton.numBones; ++boneIndex)
+		{
+			(*outputPoseMats)[boneIndex] = identity_mat4();
+		}
+		return;
+	}
+
+	KmxCompressedAnimation* animations = (KmxCompressedAnimation*)(&clips.data + clips.animationsOffset);
+	KmxCompressedAnimation* animation = &animations[animationIndex];
+	assert(currentAnimationTime <= animation->duration);
+
+	KmxCompressedTrack* tracks = (KmxCompressedTrack*)(&clips.data + animation->tracksOffset);
+
+	if(cursor)
+	{
+		assert(cursor->numBones == skeleton.numBones);
+		sync_animation_cursor(cursor, animationIndex);
+	}
+
+	// Sample in quantised key time units so we never have to decode key times
+	float keyTime = (animation->duration > 0) ? currentAnimationTime * (UINT16_QUANT / animation->duration) : 0.0f;
+
+	for(uint32 boneIndex = 0; boneIndex < skeleton.numBones; ++boneIndex)
+	{
+		KmxCompressedTrack* track = &tracks[boneIndex];
+
+		vec3 currBoneTranslation = {};
+		if(track->numTraKeys > 0)
+		{
+			uint16* traKeyTimes = (uint16*)(&clips.data + track->traKeyTimesOffset);
+			uint16* traKeys = (uint16*)(&clips.data + track->traKeysOffset);
+			uint32 numKeys = track->numTraKeys;
+
+			uint32 hint = cursor ? cursor->traKeyHints[boneIndex] : 0;
+			uint32 i = find_next_key(traKeyTimes, numKeys, keyTime, hint);
+			if(cursor) cursor->traKeyHints[boneIndex] = i;
+
+			// Interpolate the quantised values, then dequantise once
+			uint16* transFrom = &traKeys[3*(numKeys-1)]; // hold last key if we're past it
+			uint16* transTo = transFrom;
+			float t = 0;
+			if(i < numKeys)
+			{
+				transFrom = &traKeys[3*(i-1)];
+				transTo   = &traKeys[3*i];
+				t = _key_lerp_factor(traKeyTimes, i, keyTime);
+			}
+			for(int c = 0; c < 3; ++c){
+				float lerped = transFrom[c] + (transTo[c] - transFrom[c]) * t;
+				currBoneTranslation.v[c] = track->traMin[c] + track->traScale[c] * lerped;
+			}
+		}
+
+		versor currBoneRotation = {1, 0, 0, 0};
+		if(track->numRotKeys > 0)
+		{
+			uint16* rotKeyTimes = (uint16*)(&clips.data + track->rotKeyTimesOffset);
+			uint16* rotKeys = (uint16*)(&clips.data + track->rotKeysOffset);
+			uint32 numKeys = track->numRotKeys;
+
+			uint32 hint = cursor ? cursor->rotKeyHints[boneIndex] : 0;
+			uint32 i = find_next_key(rotKeyTimes, numKeys, keyTime, hint);
+			if(cursor) cursor->rotKeyHints[boneIndex] = i;
+
+			if(i < numKeys)
+			{
+				versor rotateFrom = _decode_rotation(&rotKeys[3*(i-1)]);
+				versor rotateTo   = _decode_rotation(&rotKeys[3*i]);
+				currBoneRotation = slerp_fast(rotateFrom, rotateTo, _key_lerp_factor(rotKeyTimes, i, keyTime));
+			}
+			else currBoneRotation = _decode_rotation(&rotKeys[3*(numKeys-1)]); // hold last key if we're past it
+		}
+
+		(*outputPoseMats)[boneIndex] = bone_local_mat(currBoneTranslation, currBoneRotation);
+	}
+
+	concatenate_bone_transforms(skeleton, *outputPoseMats);
+	multiply_inverse_bind_poses(*outputPoseMats, inverseBindPoses, skeleton.numBones, *outputPoseMats);
+}
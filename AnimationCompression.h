@@ -0,0 +1,78 @@
+#pragma once
+
+#include "utils.h"
+#include "Animation.h"
+
+// Compressed copies of a KmxSkeleton's animations:
+//  - keys that linear interpolation (lerp/slerp) of their neighbours reproduces within tolerance are removed
+//  - key times are 16 bit fractions of the clip duration
+//  - translations are 16 bits per component, quantised to the track's range
+//  - rotations use "smallest three" encoding: the largest component is dropped (and rebuilt from |q| = 1),
+//    the other three are 15 bits each, plus 2 bits saying which one was dropped. 6 bytes instead of 16.
+// Bones/hierarchy still come from the source KmxSkeleton.
+
+// Tolerances are per bone, in the bone's local space, and cover quantisation as well as key reduction
+// (rotations lose up to 1.5e-4 radians to quantisation, translations half of 1/65535th of the track's range,
+// key times half of 1/65535th of the clip). Tolerances below that keep every key but can't be met.
+// Errors add up down the hierarchy, so the deeper the skeleton the tighter these should be.
+struct KmxCompressionSettings {
+	float maxTranslationError; // model units
+	float maxRotationError;    // radians
+};
+
+struct KmxCompressedClips {
+	uint32 magic;
+	uint32 version;
+
+	uint32 numBones;
+	uint32 numAnimations;
+	uint32 animationsOffset;
+
+	uint8 data;
+};
+
+struct KmxCompressedAnimation {
+	char name[32];
+	float duration;
+	uint32 tracksOffset;
+};
+
+// One per bone per animation
+struct KmxCompressedTrack {
+	uint32 numTraKeys;
+	uint32 numRotKeys;
+
+	uint32 traKeyTimesOffset; // uint16 per key
+	uint32 rotKeyTimesOffset; // uint16 per key
+	uint32 traKeysOffset;     // uint16[3] per key
+	uint32 rotKeysOffset;     // uint16[3] per key
+
+	float traMin[3];   // translation = traMin + traScale * key
+	float traScale[3];
+};
+
+/* // Compressed Clips Layout (offsets relative to &clips.data, like KmxSkeleton)
+
+	KmxCompressedClips clips;
+
+	// &clips.data + clips.animationsOffset:
+	KmxCompressedAnimation anims[numAnimations];
+
+	// &clips.data + anim.tracksOffset:
+	KmxCompressedTrack tracks[numBones];
+
+	// &clips.data + track.*Offset, each array 4-byte aligned:
+	uint16 traKeyTimes[numTraKeys], traKeys[numTraKeys][3], rotKeyTimes[numRotKeys], rotKeys[numRotKeys][3];
+*/
+
+// Builds compressed copies of all of skeleton's animations in one allocation. Release with free()
+// outSize (optional) gets the total size in bytes
+KmxCompressedClips* compress_animations(const KmxSkeleton& skeleton, const KmxCompressionSettings& settings, uint32* outSize = NULL);
+
+// Bytes used by skeleton's keyframe data (times + keys + KmxBoneKeyFrames), to compare against compressed size
+uint32 animation_data_size(const KmxSkeleton& skeleton);
+
+// Same as animate(), sampling clips instead of skeleton's own animations. Rotations use slerp_fast()
+// Don't share a cursor between compressed and uncompressed playback, key indices differ
+void animate_compressed(const KmxSkeleton& skeleton, const KmxCompressedClips& clips, int32 animationIndex, float currentAnimationTime,
+						const mat4* inverseBindPoses, mat4** outputPoseMats, KmxAnimationCursor* cursor = NULL);
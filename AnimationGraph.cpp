@@ -0,0 +1,298 @@
+#include "AnimationGraph.h"
+
+#include <string.h> //memcpy
+
+#include "GameMaths.h"
+#include "AnimationBlending.h"
+
+void init_animation_graph_instance(AnimationGraphInstance* instance, const AnimationGraph* graph, const KmxSkeleton& skeleton)
+{
+	assert(graph->numParameters <= ANIMATION_GRAPH_MAX_PARAMETERS);
+	assert(graph->initialState < graph->numStates);
+	for(uint32 nodeIndex = 0; nodeIndex < graph->numNodes; ++nodeIndex)
+	{
+		// Children after parents means the node tree can't loop
+		const AnimationNode* node = &graph->nodes[nodeIndex];
+		if(node->type != ANIMATION_NODE_BLEND_1D) continue;
+		assert((node->numChildren > 0) && (node->numChildren <= ANIMATION_GRAPH_MAX_BLEND_CHILDREN));
+		for(uint32 i = 0; i < node->numChildren; ++i)
+			assert((node->children[i] > nodeIndex) && (node->children[i] < graph->numNodes));
+	}
+
+	*instance = {};
+	instance->graph = graph;
+	instance->state = graph->initialState;
+	instance->previousState = -1;
+
+	for(uint32 i = 0; i < ANIMATION_GRAPH_MAX_SAMPLES; ++i)
+	{
+		instance->samples[i].animationIndex = -1;
+		init_local_pose(&instance->samples[i].pose, skeleton.numBones);
+		init_animation_cursor(&instance->samples[i].cursor, skeleton);
+	}
+	init_local_pose(&instance->pose, skeleton.numBones);
+}
+
+void free_animation_graph_instance(AnimationGraphInstance* instance)
+{
+	for(uint32 i = 0; i < ANIMATION_GRAPH_MAX_SAMPLES; ++i)
+	{
+		free_local_pose(&instance->samples[i].pose);
+		free_animation_cursor(&instance->samples[i].cursor);
+	}
+	free_local_pose(&instance->pose);
+	*instance = {};
+}
+
+void set_animation_parameter(AnimationGraphInstance* instance, uint32 parameterIndex, float value)
+{
+	assert(parameterIndex < instance->graph->numParameters);
+	instance->parameters[parameterIndex] = value;
+}
+
+static bool _transition_passes(const AnimationGraphInstance* instance, const AnimationTransition& transition)
+{
+	if((transition.fromState != ANIMATION_GRAPH_ANY_STATE) && ((uint32)transition.fromState != instance->state)) return false;
+	if(transition.toState == instance->state) return false;
+
+	switch(transition.condition){
+		case ANIMATION_CONDITION_GREATER:    return instance->parameters[transition.parameterIndex] > transition.threshold;
+		case ANIMATION_CONDITION_LESS:       return instance->parameters[transition.parameterIndex] < transition.threshold;
+		case ANIMATION_CONDITION_STATE_TIME: return instance->stateTime >= transition.threshold;
+		default: assert(false);              return false;
+	}
+}
+
+void update_animation_graph(AnimationGraphInstance* instance, float dt)
+{
+	const AnimationGraph* graph = instance->graph;
+
+	instance->stateTime += dt;
+	if(instance->previousState >= 0)
+	{
+		instance->previousStateTime += dt;
+		instance->transitionTime += dt;
+		if(instance->transitionTime >= instance->transitionDuration) instance->previousState = -1;
+	}
+
+	if(instance->previousState >= 0) return;
+
+	for(uint32 i = 0; i < graph->numTransitions; ++i)
+	{
+		const AnimationTransition& transition = graph->transitions[i];
+		if(!_transition_passes(instance, transition)) continue;
+
+		assert(transition.toState < graph->numStates);
+		if(transition.duration > 0)
+		{
+			instance->previousState = (int32)instance->state;
+			instance->previousStateTime = instance->stateTime;
+			instance->transitionTime = 0;
+			instance->transitionDuration = transition.duration;
+		}
+		instance->state = transition.toState;
+		instance->stateTime = 0;
+		break;
+	}
+}
+
+struct _ContributionList {
+	AnimationGraphContribution contributions[ANIMATION_GRAPH_MAX_SAMPLES];
+	uint32 numContributions;
+	uint32 numSkippedNodes;
+};
+
+static void _add_contribution(_ContributionList* list, int32 animationIndex, float time, float weight)
+{
+	// Another state (or another branch of this one) may already want this clip at this time
+	for(uint32 i = 0; i < list->numContributions; ++i)
+	{
+		AnimationGraphContribution* contribution = &list->contributions[i];
+		if((contribution->animationIndex == animationIndex) && (contribution->time == time))
+		{
+			contribution->weight += weight;
+			return;
+		}
+	}
+
+	assert(list->numContributions < ANIMATION_GRAPH_MAX_SAMPLES);
+	if(list->numContributions == ANIMATION_GRAPH_MAX_SAMPLES) return; // drop it, blending renormalises the rest
+	list->contributions[list->numContributions++] = {animationIndex, time, weight};
+}
+
+// nodeIndex and everything below it
+static uint32 _count_nodes(const AnimationGraph* graph, uint32 nodeIndex)
+{
+	const AnimationNode* node = &graph->nodes[nodeIndex];
+	uint32 count = 1;
+	if(node->type == ANIMATION_NODE_BLEND_1D)
+	{
+		for(uint32 i = 0; i < node->numChildren; ++i) count += _count_nodes(graph, node->children[i]);
+	}
+	return count;
+}
+
+// Walks the node tree below nodeIndex handing out weight, only visiting nodes that get some
+static void _gather_contributions(const AnimationGraphInstance* instance, const KmxSkeleton& skeleton, uint32 nodeIndex,
+								  float stateTime, float weight, _ContributionList* list)
+{
+	const AnimationNode* node = &instance->graph->nodes[nodeIndex];
+	if(node->type == ANIMATION_NODE_CLIP)
+	{
+		float time = 0.0f;
+		if((node->animationIndex >= 0) && ((uint32)node->animationIndex < skeleton.numAnimations))
+		{
+			KmxAnimation* animations = (KmxAnimation*)(&skeleton.data + skeleton.animationsOffset);
+			float duration = animations[node->animationIndex].duration;
+			time = stateTime * node->playbackRate;
+			if(node->loop) time = (duration > 0) ? fmodf(time, duration) : 0.0f;
+			else time = MIN(time, duration);
+		}
+		_add_contribution(list, node->animationIndex, time, weight);
+		return;
+	}
+
+	assert(node->type == ANIMATION_NODE_BLEND_1D);
+	float parameter = instance->parameters[node->parameterIndex];
+
+	// Children either side of parameter share the weight, the rest get none
+	uint32 upper = 0;
+	while((upper < node->numChildren) && (node->thresholds[upper] < parameter)) ++upper;
+	uint32 lower = upper;
+	float upperWeight = 0.0f;
+	if(upper == node->numChildren) lower = upper = node->numChildren - 1; // past the last threshold
+	else if(upper > 0)
+	{
+		lower = upper - 1;
+		float range = node->thresholds[upper] - node->thresholds[lower];
+		upperWeight = (range > 0) ? (parameter - node->thresholds[lower]) / range : 1.0f;
+	}
+
+	for(uint32 i = 0; i < node->numChildren; ++i)
+	{
+		float childWeight = 0.0f;
+		if(i == upper) childWeight += weight * upperWeight;
+		if(i == lower) childWeight += weight * (1.0f - upperWeight);
+
+		if(childWeight > 0) _gather_contributions(instance, skeleton, node->children[i], stateTime, childWeight, list);
+		else list->numSkippedNodes += _count_nodes(instance->graph, node->children[i]);
+	}
+}
+
+static bool _same_contributions(const AnimationGraphInstance* instance, const _ContributionList& list)
+{
+	if(list.numContributions != instance->numContributions) return false;
+	for(uint32 i = 0; i < list.numContributions; ++i)
+	{
+		const AnimationGraphContribution& a = list.contributions[i];
+		const AnimationGraphContribution& b = instance->contributions[i];
+		if((a.animationIndex != b.animationIndex) || (a.time != b.time) || (a.weight != b.weight)) return false;
+	}
+	return true;
+}
+
+bool evaluate_animation_graph(AnimationGraphInstance* instance, const KmxSkeleton& skeleton, const mat4* inverseBindPoses,
+							  mat4* outputPoseMats)
+{
+	const AnimationGraph* graph = instance->graph;
+	instance->stats.numEvaluations++;
+
+	_ContributionList list;
+	list.numContributions = 0;
+	list.numSkippedNodes = 0;
+	if(instance->previousState >= 0)
+	{
+		float t = CLAMP(instance->transitionTime / instance->transitionDuration, 0.0f, 1.0f);
+		if(t < 1.0f) _gather_contributions(instance, skeleton, graph->stateNodes[instance->previousState], instance->previousStateTime, 1.0f - t, &list);
+		if(t > 0.0f) _gather_contributions(instance, skeleton, graph->stateNodes[instance->state], instance->stateTime, t, &list);
+	}
+	else _gather_contributions(instance, skeleton, graph->stateNodes[instance->state], instance->stateTime, 1.0f, &list);
+	instance->stats.numSkippedNodes += list.numSkippedNodes;
+
+	if(instance->hasPose && _same_contributions(instance, list))
+	{
+		instance->stats.numCachedEvaluations++;
+		return false;
+	}
+
+	// Find which samples we already have, then fill in the rest
+	int32 sampleForContribution[ANIMATION_GRAPH_MAX_SAMPLES];
+	bool sampleUsed[ANIMATION_GRAPH_MAX_SAMPLES] = {};
+	for(uint32 c = 0; c < list.numContributions; ++c)
+	{
+		sampleForContribution[c] = -1;
+		for(uint32 s = 0; s < ANIMATION_GRAPH_MAX_SAMPLES; ++s)
+		{
+			const AnimationGraphSample& sample = instance->samples[s];
+			if(!sampleUsed[s] && (sample.animationIndex == list.contributions[c].animationIndex) && (sample.time == list.contributions[c].time))
+			{
+				sampleForContribution[c] = (int32)s;
+				sampleUsed[s] = true;
+				instance->stats.numReusedSamples++;
+				break;
+			}
+		}
+	}
+	for(uint32 c = 0; c < list.numContributions; ++c)
+	{
+		if(sampleForContribution[c] >= 0) continue;
+		const AnimationGraphContribution& contribution = list.contributions[c];
+
+		// Prefer a free sample that last played the same clip, its cursor makes playing forwards O(1)
+		int32 best = -1;
+		for(uint32 s = 0; s < ANIMATION_GRAPH_MAX_SAMPLES; ++s)
+		{
+			if(sampleUsed[s]) continue;
+			if((best < 0) || (instance->samples[s].animationIndex == contribution.animationIndex)) best = (int32)s;
+			if(instance->samples[s].animationIndex == contribution.animationIndex) break;
+		}
+		assert(best >= 0); // there are as many samples as contributions
+
+		AnimationGraphSample* sample = &instance->samples[best];
+		sample_local_pose(skeleton, contribution.animationIndex, contribution.time, &sample->pose, &sample->cursor);
+		sample->animationIndex = contribution.animationIndex;
+		sample->time = contribution.time;
+		sampleForContribution[c] = best;
+		sampleUsed[best] = true;
+		instance->stats.numSamples++;
+	}
+
+	if(list.numContributions == 1)
+	{
+		const LocalPose& only = instance->samples[sampleForContribution[0]].pose;
+		memcpy(instance->pose.tx, only.tx, LOCAL_POSE_NUM_CHANNELS * only.stride * sizeof(float));
+	}
+	else
+	{
+		LocalPose poses[ANIMATION_GRAPH_MAX_SAMPLES];
+		float weights[ANIMATION_GRAPH_MAX_SAMPLES];
+		for(uint32 c = 0; c < list.numContributions; ++c)
+		{
+			poses[c] = instance->samples[sampleForContribution[c]].pose;
+			weights[c] = list.contributions[c].weight;
+		}
+		blend_local_poses(poses, weights, list.numContributions, &instance->pose);
+	}
+
+	memcpy(instance->contributions, list.contributions, list.numContributions * sizeof(AnimationGraphContribution));
+	instance->numContributions = list.numContributions;
+	instance->hasPose = true;
+
+	local_pose_to_pose_mats(skeleton, instance->pose, inverseBindPoses, outputPoseMats);
+	return true;
+}
+
+void gather_animation_graph_stats(AnimationGraphInstance* instances, uint32 numInstances, AnimationGraphStats* outStats)
+{
+	*outStats = {};
+	for(uint32 i = 0; i < numInstances; ++i)
+	{
+		AnimationGraphStats* stats = &instances[i].stats;
+		outStats->numEvaluations += stats->numEvaluations;
+		outStats->numCachedEvaluations += stats->numCachedEvaluations;
+		outStats->numSamples += stats->numSamples;
+		outStats->numReusedSamples += stats->numReusedSamples;
+		outStats->numSkippedNodes += stats->numSkippedNodes;
+		*stats = {};
+	}
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "utils.h"
+#include "Animation.h"
+
+// Animation state machine: states, the transitions between them and blend nodes, described as data
+// (const arrays, shared by every character using the graph) and evaluated lazily per character:
+//  - blend weights are worked out first, nodes with zero weight are never visited or sampled
+//  - every (clip, time) pair is sampled once per evaluation, so states blending in and out during a
+//    transition share any clip they both play at the same time
+//  - samples are kept between evaluations and reused if the same clip is asked for at the same time again
+//  - if nothing that feeds the final pose changed since the last evaluation (e.g. a held idle pose, a
+//    non-looping clip that's finished) the last result is reused and no matrices are rebuilt at all
+
+#define ANIMATION_GRAPH_MAX_BLEND_CHILDREN 8
+#define ANIMATION_GRAPH_MAX_PARAMETERS 16
+#define ANIMATION_GRAPH_MAX_SAMPLES 8 // distinct clip samples that can be blended together in one evaluation
+#define ANIMATION_GRAPH_ANY_STATE -1
+
+enum AnimationNodeType {
+	ANIMATION_NODE_CLIP,
+	ANIMATION_NODE_BLEND_1D, // weights two neighbouring children by where a parameter falls between their thresholds
+};
+
+struct AnimationNode {
+	AnimationNodeType type;
+
+	// ANIMATION_NODE_CLIP: plays from the start when its state is entered
+	int32 animationIndex;
+	float playbackRate;
+	bool loop; // otherwise holds the last frame
+
+	// ANIMATION_NODE_BLEND_1D
+	uint32 parameterIndex;
+	uint32 numChildren;
+	uint32 children[ANIMATION_GRAPH_MAX_BLEND_CHILDREN];   // node indices, must be greater than this node's
+	float thresholds[ANIMATION_GRAPH_MAX_BLEND_CHILDREN]; // ascending
+};
+
+enum AnimationCondition {
+	ANIMATION_CONDITION_GREATER,    // parameter > threshold
+	ANIMATION_CONDITION_LESS,       // parameter < threshold
+	ANIMATION_CONDITION_STATE_TIME, // the current state has been playing for threshold seconds
+};
+
+struct AnimationTransition {
+	int32 fromState; // or ANIMATION_GRAPH_ANY_STATE
+	uint32 toState;
+	AnimationCondition condition;
+	uint32 parameterIndex;
+	float threshold;
+	float duration; // cross fade length in seconds, 0 to cut
+};
+
+struct AnimationGraph {
+	const AnimationNode* nodes;
+	uint32 numNodes;
+	const uint32* stateNodes; // root node of each state
+	uint32 numStates;
+	const AnimationTransition* transitions; // checked in order, the first that passes is taken
+	uint32 numTransitions;
+	uint32 numParameters;
+	uint32 initialState;
+};
+
+// Counters so savings can be measured. Reset by gather_animation_graph_stats()
+struct AnimationGraphStats {
+	uint32 numEvaluations;
+	uint32 numCachedEvaluations; // evaluations that reused the last result
+	uint32 numSamples;           // clips sampled
+	uint32 numReusedSamples;     // clip samples reused from an earlier evaluation
+	uint32 numSkippedNodes;      // nodes not visited because their weight was 0, counting everything below them
+};
+
+// A clip at a time, blended into the final pose with weight
+struct AnimationGraphContribution {
+	int32 animationIndex;
+	float time;
+	float weight;
+};
+
+// Kept between evaluations so it can be reused
+struct AnimationGraphSample {
+	int32 animationIndex; // -1 if empty
+	float time;
+	LocalPose pose;
+	KmxAnimationCursor cursor;
+};
+
+// Per character state
+struct AnimationGraphInstance {
+	const AnimationGraph* graph;
+	float parameters[ANIMATION_GRAPH_MAX_PARAMETERS];
+
+	uint32 state;
+	float stateTime;
+	// Cross fading out of previousState while it's >= 0
+	int32 previousState;
+	float previousStateTime;
+	float transitionTime;
+	float transitionDuration;
+
+	AnimationGraphSample samples[ANIMATION_GRAPH_MAX_SAMPLES];
+	AnimationGraphContribution contributions[ANIMATION_GRAPH_MAX_SAMPLES]; // what the current pose was made of
+	uint32 numContributions;
+	bool hasPose;
+	LocalPose pose;
+
+	AnimationGraphStats stats;
+};
+
+void init_animation_graph_instance(AnimationGraphInstance* instance, const AnimationGraph* graph, const KmxSkeleton& skeleton);
+void free_animation_graph_instance(AnimationGraphInstance* instance);
+
+void set_animation_parameter(AnimationGraphInstance* instance, uint32 parameterIndex, float value);
+// Advances time and takes any transition whose condition passes. Call on the main thread, before evaluating.
+// Transitions aren't checked while one is already in progress
+void update_animation_graph(AnimationGraphInstance* instance, float dt);
+
+// Samples and blends whatever contributes to the pose right now and writes skinning matrices like animate().
+// Returns false if nothing changed since the last call, outputPoseMats is then left alone,
+// so it should be the same array every call (e.g. AnimationInstance::poseMats)
+bool evaluate_animation_graph(AnimationGraphInstance* instance, const KmxSkeleton& skeleton, const mat4* inverseBindPoses,
+							  mat4* outputPoseMats);
+
+// Adds up (and resets) the counters of numInstances characters
+void gather_animation_graph_stats(AnimationGraphInstance* instances, uint32 numInstances, AnimationGraphStats* outStats);
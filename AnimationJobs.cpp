@@ -0,0 +1,117 @@
+#include "AnimationJobs.h"
+
+#include "Animation.h"
+#include "AnimationLod.h"
+#include "AnimationGraph.h"
+#include "GameMaths.h"
+
+// Instances grabbed per trip to the shared counter. Big enough to keep contention down,
+// small enough that threads finish at about the same time
+#define ANIMATION_JOBS_BATCH_SIZE 4
+
+// Animates batches of instances until there are none left
+static void _do_animation_work(AnimationJobSystem* jobs)
+{
+    for(;;)
+    {
+        uint32 first = jobs->next_instance.fetch_add(ANIMATION_JOBS_BATCH_SIZE);
+        if(first >= jobs->num_instances) break;
+        uint32 last = MIN(first + ANIMATION_JOBS_BATCH_SIZE, jobs->num_instances);
+
+        for(uint32 i = first; i < last; ++i)
+        {
+            AnimationInstance* instance = &jobs->instances[i];
+            if(instance->graph)
+                evaluate_animation_graph(instance->graph, *instance->skeleton, instance->inverseBindPoses, instance->poseMats);
+            else if(instance->lod)
+                animate_lod(instance->lod, *instance->skeleton, instance->animationIndex, instance->time, instance->inverseBindPoses, instance->poseMats, instance->cursor);
+            else
+                animate(*instance->skeleton, instance->animationIndex, instance->time, instance->inverseBindPoses, &instance->poseMats, instance->cursor);
+        }
+
+        uint32 completed = jobs->num_completed.fetch_add(last - first) + (last - first);
+        if(completed == jobs->num_instances){
+            std::lock_guard<std::mutex> lock(jobs->mutex);
+            jobs->work_done.notify_all();
+        }
+    }
+}
+
+static void _animation_worker(AnimationJobSystem* jobs)
+{
+    uint64 last_generation = 0;
+    for(;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(jobs->mutex);
+            jobs->work_ready.wait(lock, [&]{ return jobs->should_quit || (jobs->generation != last_generation); });
+            if(jobs->should_quit) return;
+            last_generation = jobs->generation;
+            ++jobs->num_busy_threads;
+        }
+
+        _do_animation_work(jobs);
+
+        {
+            std::lock_guard<std::mutex> lock(jobs->mutex);
+            --jobs->num_busy_threads;
+        }
+        jobs->work_done.notify_all();
+    }
+}
+
+void init_animation_jobs(AnimationJobSystem* jobs, uint32 num_threads)
+{
+    if(num_threads == 0){
+        uint32 hardware_threads = std::thread::hardware_concurrency();
+        num_threads = (hardware_threads > 1) ? hardware_threads - 1 : 1;
+    }
+    jobs->num_threads = MIN(num_threads, ANIMATION_JOBS_MAX_THREADS);
+    jobs->generation = 0;
+    jobs->num_busy_threads = 0;
+    jobs->should_quit = false;
+    jobs->instances = NULL;
+    jobs->num_instances = 0;
+    jobs->next_instance = 0;
+    jobs->num_completed = 0;
+
+    for(uint32 i = 0; i < jobs->num_threads; ++i)
+        jobs->threads[i] = std::thread(_animation_worker, jobs);
+}
+
+void kick_animation_jobs(AnimationJobSystem* jobs, AnimationInstance* instances, uint32 num_instances)
+{
+    {
+        std::unique_lock<std::mutex> lock(jobs->mutex);
+        // A worker that woke up too late for the last kick may still be finding there's nothing left to do
+        jobs->work_done.wait(lock, [&]{ return jobs->num_busy_threads == 0; });
+        jobs->instances = instances;
+        jobs->num_instances = num_instances;
+        jobs->next_instance = 0;
+        jobs->num_completed = 0;
+        ++jobs->generation;
+    }
+    jobs->work_ready.notify_all();
+}
+
+void wait_for_animation_jobs(AnimationJobSystem* jobs)
+{
+    _do_animation_work(jobs);
+
+    // Wait for the poses and for every worker to be back asleep
+    std::unique_lock<std::mutex> lock(jobs->mutex);
+    jobs->work_done.wait(lock, [&]{ return (jobs->num_completed >= jobs->num_instances) && (jobs->num_busy_threads == 0); });
+}
+
+void shutdown_animation_jobs(AnimationJobSystem* jobs)
+{
+    {
+        std::lock_guard<std::mutex> lock(jobs->mutex);
+        jobs->should_quit = true;
+    }
+    jobs->work_ready.notify_all();
+
+    for(uint32 i = 0; i < jobs->num_threads; ++i)
+        jobs->threads[i].join();
+    jobs->num_threads = 0;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include "utils.h"
+
+struct mat4;
+struct KmxSkeleton;
+struct KmxAnimationCursor;
+struct AnimationLodState;
+struct AnimationGraphInstance;
+
+// Everything animate() needs to pose one character
+struct AnimationInstance {
+    const KmxSkeleton* skeleton;
+    int32 animationIndex;
+    float time;
+    const mat4* inverseBindPoses;
+    mat4* poseMats;                // output, skeleton->numBones matrices per instance
+    KmxAnimationCursor* cursor;    // optional, must not be shared between instances
+    AnimationLodState* lod;        // optional, animates with animate_lod() instead of animate()
+    AnimationGraphInstance* graph; // optional, poses with evaluate_animation_graph() instead (animationIndex, time, cursor and lod unused)
+};
+
+#define ANIMATION_JOBS_MAX_THREADS 64
+
+// Pool of worker threads that animate many characters in parallel.
+// kick_animation_jobs() hands out the instances and returns straight away,
+// wait_for_animation_jobs() helps out on the calling thread then blocks until every pose is written.
+struct AnimationJobSystem {
+    uint32 num_threads;
+    std::thread threads[ANIMATION_JOBS_MAX_THREADS];
+
+    std::mutex mutex;
+    std::condition_variable work_ready;
+    std::condition_variable work_done;
+    uint64 generation;       // bumped for every kick, workers wake up when it changes
+    uint32 num_busy_threads;
+    bool should_quit;
+
+    AnimationInstance* instances;
+    uint32 num_instances;
+    std::atomic<uint32> next_instance;
+    std::atomic<uint32> num_completed;
+};
+
+// num_threads == 0 uses one worker per hardware thread, minus one for the calling thread
+void init_animation_jobs(AnimationJobSystem* jobs, uint32 num_threads = 0);
+// instances must stay alive and untouched until wait_for_animation_jobs() returns
+void kick_animation_jobs(AnimationJobSystem* jobs, AnimationInstance* instances, uint32 num_instances);
+void wait_for_animation_jobs(AnimationJobSystem* jobs);
+void shutdown_animation_jobs(AnimationJobSystem* jobs);
@@ -0,0 +1,175 @@
+#include "AnimationLod.h"
+
+#include <stdlib.h> //malloc, free
+#include <string.h> //memcpy
+
+#include "GameMaths.h"
+#include "AnimationBlending.h"
+
+void build_far_bone_mask(const KmxSkeleton& skeleton, uint8* outMask)
+{
+	KmxBone* bones = (KmxBone*)(&skeleton.data + skeleton.bonesOffset);
+
+	// KMX has no per-bone flags, so leaf bones are the ones nothing else is parented to
+	for(uint32 boneIndex = 0; boneIndex < skeleton.numBones; ++boneIndex)
+		outMask[boneIndex] = 0;
+	for(uint32 boneIndex = 0; boneIndex < skeleton.numBones; ++boneIndex)
+	{
+		if(bones[boneIndex].parentIndex >= 0) outMask[bones[boneIndex].parentIndex] = 1;
+	}
+	// Always keep the root, even if it's all there is
+	for(uint32 boneIndex = 0; boneIndex < skeleton.numBones; ++boneIndex)
+	{
+		if(bones[boneIndex].parentIndex < 0) outMask[boneIndex] = 1;
+	}
+}
+
+void init_animation_lod(AnimationLodState* lod, const KmxSkeleton& skeleton, const uint8* farBoneMask)
+{
+	*lod = {};
+	lod->level = ANIMATION_LOD_FULL;
+	lod->farBoneMask = farBoneMask;
+	for(uint32 boneIndex = 0; boneIndex < skeleton.numBones; ++boneIndex)
+		lod->numFarBones += farBoneMask[boneIndex] ? 1 : 0;
+
+	init_local_pose(&lod->prevPose, skeleton.numBones);
+	init_local_pose(&lod->nextPose, skeleton.numBones);
+	init_local_pose(&lod->pose, skeleton.numBones);
+	lod->sampledAnimationIndex = -1;
+	lod->leafAnimationIndex = -1; // poses start as identity, same as sampling an invalid animation
+}
+
+void free_animation_lod(AnimationLodState* lod)
+{
+	free_local_pose(&lod->prevPose);
+	free_local_pose(&lod->nextPose);
+	free_local_pose(&lod->pose);
+	*lod = {};
+}
+
+AnimationLodLevel choose_animation_lod(AnimationLodState* lod, const AnimationLodSettings& settings, vec3 cameraPos,
+									   vec3 boundsCentre, float boundsRadius, bool inViewFrustum, float dt)
+{
+	float distance = length(boundsCentre - cameraPos) - boundsRadius;
+
+	AnimationLodLevel level = ANIMATION_LOD_FULL;
+	if(distance > settings.quarterRateDistance) level = ANIMATION_LOD_QUARTER;
+	else if(distance > settings.halfRateDistance) level = ANIMATION_LOD_HALF;
+
+	if(!inViewFrustum) level = ANIMATION_LOD_OFFSCREEN;
+
+	lod->level = level;
+	lod->cullLeafBones = (distance > settings.leafBoneCullDistance);
+	lod->dt = dt;
+	return level;
+}
+
+// Culled leaf bones keep whatever outputPose had, so only cull them when that's a pose from this animation
+static void _sample(AnimationLodState* lod, const KmxSkeleton& skeleton, int32 animationIndex, float time,
+					LocalPose* outputPose, KmxAnimationCursor* cursor, bool outputHasLeafBones)
+{
+	bool cullLeafBones = lod->cullLeafBones && outputHasLeafBones;
+	const uint8* boneMask = cullLeafBones ? lod->farBoneMask : NULL;
+	sample_local_pose(skeleton, animationIndex, time, outputPose, cursor, boneMask);
+
+	uint32 numBonesSampled = cullLeafBones ? lod->numFarBones : skeleton.numBones;
+	lod->stats.numSamples++;
+	lod->stats.numBonesSampled += numBonesSampled;
+	lod->stats.numBonesSkipped += skeleton.numBones - numBonesSampled;
+}
+
+static void _copy_local_pose(const LocalPose& src, LocalPose* dst)
+{
+	memcpy(dst->tx, src.tx, LOCAL_POSE_NUM_CHANNELS * src.stride * sizeof(float));
+}
+
+bool animate_lod(AnimationLodState* lod, const KmxSkeleton& skeleton, int32 animationIndex, float currentAnimationTime,
+				 const mat4* inverseBindPoses, mat4* outputPoseMats, KmxAnimationCursor* cursor)
+{
+	lod->stats.numInstanceFrames++;
+
+	if(lod->level == ANIMATION_LOD_OFFSCREEN)
+	{
+		lod->stats.numSkippedOffscreen++;
+		lod->stats.numBonesSkipped += skeleton.numBones;
+		lod->sampledAnimationIndex = -1; // samples will be stale by the time we're back on screen
+		return false;
+	}
+
+	// Whether pose's leaf bones can be held instead of sampled (they're from an earlier sample of this animation)
+	bool hasLeafBones = (lod->leafAnimationIndex == animationIndex);
+
+	uint32 updateInterval = 1u << (uint32)lod->level;
+	if(updateInterval == 1)
+	{
+		_sample(lod, skeleton, animationIndex, currentAnimationTime, &lod->pose, cursor, hasLeafBones);
+		lod->sampledAnimationIndex = -1;
+	}
+	else
+	{
+		bool needsResample = (lod->sampledAnimationIndex != animationIndex) || (lod->updateInterval != updateInterval);
+		if(needsResample || (lod->framesSinceSample >= updateInterval))
+		{
+			if(needsResample)
+			{
+				// prevPose may be stale, hold the leaf bones we last output instead
+				if(lod->cullLeafBones && hasLeafBones) _copy_local_pose(lod->pose, &lod->prevPose);
+				_sample(lod, skeleton, animationIndex, currentAnimationTime, &lod->prevPose, cursor, hasLeafBones);
+			}
+			else
+			{
+				// The last sample was taken for about now
+				LocalPose temp = lod->prevPose;
+				lod->prevPose = lod->nextPose;
+				lod->nextPose = temp;
+			}
+
+			// Sample where we'll be at the next update, and blend towards it until then
+			float nextTime = currentAnimationTime + updateInterval * lod->dt;
+			if((animationIndex >= 0) && ((uint32)animationIndex < skeleton.numAnimations))
+			{
+				KmxAnimation* animations = (KmxAnimation*)(&skeleton.data + skeleton.animationsOffset);
+				float duration = animations[animationIndex].duration;
+				if(nextTime > duration) nextTime = (duration > 0) ? fmodf(nextTime, duration) : 0.0f;
+			}
+			// Leaf bones aren't sampled when culled, keep them in step with the other buffer
+			if(lod->cullLeafBones) _copy_local_pose(lod->prevPose, &lod->nextPose);
+			_sample(lod, skeleton, animationIndex, nextTime, &lod->nextPose, cursor, true);
+
+			lod->sampledAnimationIndex = animationIndex;
+			lod->updateInterval = updateInterval;
+			lod->framesSinceSample = 0;
+		}
+		else
+		{
+			lod->stats.numSkippedByRate++;
+			lod->stats.numBonesSkipped += skeleton.numBones;
+		}
+
+		float t = (float)lod->framesSinceSample / updateInterval;
+		const LocalPose poses[2] = {lod->prevPose, lod->nextPose};
+		const float weights[2] = {1.0f - t, t};
+		blend_local_poses(poses, weights, 2, &lod->pose);
+		lod->framesSinceSample++;
+	}
+	lod->leafAnimationIndex = animationIndex;
+
+	local_pose_to_pose_mats(skeleton, lod->pose, inverseBindPoses, outputPoseMats);
+	return true;
+}
+
+void gather_animation_lod_stats(AnimationLodState* states, uint32 numStates, AnimationLodStats* outStats)
+{
+	*outStats = {};
+	for(uint32 i = 0; i < numStates; ++i)
+	{
+		AnimationLodStats* stats = &states[i].stats;
+		outStats->numInstanceFrames += stats->numInstanceFrames;
+		outStats->numSamples += stats->numSamples;
+		outStats->numSkippedByRate += stats->numSkippedByRate;
+		outStats->numSkippedOffscreen += stats->numSkippedOffscreen;
+		outStats->numBonesSampled += stats->numBonesSampled;
+		outStats->numBonesSkipped += stats->numBonesSkipped;
+		*stats = {};
+	}
+}
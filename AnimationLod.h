@@ -0,0 +1,79 @@
+#pragma once
+
+#include "utils.h"
+#include "Animation.h"
+
+struct vec3;
+
+// Animation level of detail, picked per character per frame from its distance to the camera:
+//  - far characters sample their animation every 2nd or 4th frame and blend between samples in between
+//  - far enough away, leaf bones (fingers, toes etc.) stop being sampled and hold their last pose
+//  - characters outside the view frustum aren't animated at all
+enum AnimationLodLevel {
+	ANIMATION_LOD_FULL,      // sample every frame
+	ANIMATION_LOD_HALF,      // sample every 2nd frame
+	ANIMATION_LOD_QUARTER,   // sample every 4th frame
+	ANIMATION_LOD_OFFSCREEN, // don't animate
+};
+
+struct AnimationLodSettings {
+	float halfRateDistance;
+	float quarterRateDistance;
+	float leafBoneCullDistance;
+};
+
+// Counters so savings can be measured, see gather_animation_lod_stats()
+struct AnimationLodStats {
+	uint32 numInstanceFrames;   // times animate_lod() was called
+	uint32 numSamples;          // clip samples taken
+	uint32 numSkippedByRate;    // frames that blended between existing samples instead of sampling
+	uint32 numSkippedOffscreen; // frames that did nothing
+	uint64 numBonesSampled;
+	uint64 numBonesSkipped;     // bones not sampled on a frame a full rate update would have sampled them
+};
+
+// Per character LOD state
+struct AnimationLodState {
+	// Set each frame by choose_animation_lod()
+	AnimationLodLevel level;
+	bool cullLeafBones;
+	float dt;
+
+	const uint8* farBoneMask; // from build_far_bone_mask(), shared by every character using the skeleton
+	uint32 numFarBones;       // bones still sampled when leaf bones are culled
+
+	// Samples either side of the current time when updating at reduced rate
+	LocalPose prevPose;
+	LocalPose nextPose;
+	LocalPose pose;
+	int32 sampledAnimationIndex; // -1 means prevPose/nextPose need resampling
+	int32 leafAnimationIndex;    // animation pose's leaf bones were last sampled from. Leaf bones are only culled
+	                             // once they have been, until then every bone is sampled
+	uint32 updateInterval;       // frames between samples
+	uint32 framesSinceSample;
+
+	AnimationLodStats stats;
+};
+
+// Marks bones that are sampled at far LODs (1) and leaf bones that aren't (0). outMask needs skeleton.numBones entries
+void build_far_bone_mask(const KmxSkeleton& skeleton, uint8* outMask);
+
+void init_animation_lod(AnimationLodState* lod, const KmxSkeleton& skeleton, const uint8* farBoneMask);
+void free_animation_lod(AnimationLodState* lod);
+
+// Picks the LOD for this frame from the distance between the camera and the character's bounding sphere,
+// and whether the sphere is in the camera's view frustum. Call on the main thread before animating.
+// inViewFrustum is meant to come from one spheres_in_frustum() over every character's bounds, so the frustum
+// is built and tested against once per frame rather than per character.
+// dt is the frame time, used to sample ahead when updating at reduced rate
+AnimationLodLevel choose_animation_lod(AnimationLodState* lod, const AnimationLodSettings& settings, vec3 cameraPos,
+									   vec3 boundsCentre, float boundsRadius, bool inViewFrustum, float dt);
+
+// Like animate(), at the rate and bone count chosen by choose_animation_lod()
+// Clips are assumed to loop when sampling ahead past the end.
+// Returns false if nothing was written (off screen), outputPoseMats then still has the last pose
+bool animate_lod(AnimationLodState* lod, const KmxSkeleton& skeleton, int32 animationIndex, float currentAnimationTime,
+				 const mat4* inverseBindPoses, mat4* outputPoseMats, KmxAnimationCursor* cursor = NULL);
+
+// Adds up (and resets) the counters of numStates characters
+void gather_animation_lod_stats(AnimationLodState* states, uint32 numStates, AnimationLodStats* outStats);
@@ -0,0 +1,64 @@
+#include "AnimationSoa.h"
+
+#include <stdlib.h> //malloc, free
+#include <string.h> //memcpy
+
+#include "GameMaths.h"
+#include "AnimationBlending.h"
+
+void build_soa_clip(SoaAnimationClip* clip, const KmxSkeleton& skeleton, int32 animationIndex, float sampleRate)
+{
+	assert((animationIndex >= 0) && ((uint32)animationIndex < skeleton.numAnimations));
+	KmxAnimation* animations = (KmxAnimation*)(&skeleton.data + skeleton.animationsOffset);
+	float duration = animations[animationIndex].duration;
+
+	clip->duration = duration;
+	clip->numFrames = (duration > 0) ? (uint32)ceilf(duration * sampleRate) + 1 : 1;
+	clip->framesPerSecond = (clip->numFrames > 1) ? (clip->numFrames - 1) / duration : 0.0f;
+	clip->numBones = skeleton.numBones;
+	clip->stride = LOCAL_POSE_STRIDE(skeleton.numBones);
+
+	uint32 frameSize = LOCAL_POSE_NUM_CHANNELS * clip->stride;
+	clip->frames = (float*)malloc(clip->numFrames * frameSize * sizeof(float));
+
+	// Sampling forwards with a cursor makes this O(keys) rather than O(frames * log(keys))
+	LocalPose pose;
+	init_local_pose(&pose, skeleton.numBones);
+	KmxAnimationCursor cursor;
+	init_animation_cursor(&cursor, skeleton);
+
+	for(uint32 frameIndex = 0; frameIndex < clip->numFrames; ++frameIndex)
+	{
+		float time = (frameIndex + 1 == clip->numFrames) ? duration : frameIndex / clip->framesPerSecond;
+		sample_local_pose(skeleton, animationIndex, time, &pose, &cursor);
+		memcpy(&clip->frames[frameIndex * frameSize], pose.tx, frameSize * sizeof(float)); // channels are contiguous
+	}
+
+	free_animation_cursor(&cursor);
+	free_local_pose(&pose);
+}
+
+void free_soa_clip(SoaAnimationClip* clip)
+{
+	free(clip->frames);
+	*clip = {};
+}
+
+void sample_soa_clip(const SoaAnimationClip& clip, float currentAnimationTime, LocalPose* outputPose)
+{
+	assert(outputPose->numBones == clip.numBones);
+	assert(currentAnimationTime <= clip.duration);
+
+	float frameTime = currentAnimationTime * clip.framesPerSecond;
+	uint32 frameIndex = (uint32)frameTime;
+	if(frameIndex + 1 >= clip.numFrames) frameIndex = (clip.numFrames > 1) ? clip.numFrames - 2 : 0;
+	uint32 nextFrameIndex = (clip.numFrames > 1) ? frameIndex + 1 : frameIndex;
+	float t = CLAMP(frameTime - frameIndex, 0.0f, 1.0f);
+
+	// View the two frames as LocalPoses (same layout) and blend between them
+	LocalPose frames[2];
+	local_pose_from_channels(&frames[0], clip.numBones, &clip.frames[frameIndex * LOCAL_POSE_NUM_CHANNELS * clip.stride]);
+	local_pose_from_channels(&frames[1], clip.numBones, &clip.frames[nextFrameIndex * LOCAL_POSE_NUM_CHANNELS * clip.stride]);
+	const float weights[2] = {1.0f - t, t};
+	blend_local_poses(frames, weights, 2, outputPose);
+}
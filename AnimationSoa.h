@@ -0,0 +1,26 @@
+#pragma once
+
+#include "utils.h"
+#include "Animation.h"
+
+// Runtime layout for one animation, built from a KmxSkeleton at load time.
+// The KMX layout keeps each bone's keys in separate arrays, so sampling hops between
+// numBones * 4 places in memory and needs a key search per track. Here the clip is resampled
+// at a fixed rate and each frame holds every bone's transform in the same channel layout as
+// LocalPose (7 arrays of stride floats). Sampling reads 2 consecutive frames and blends them with
+// blend_local_poses(), which does several bones at a time.
+// Rotations between frames are nlerped rather than slerped; at 30Hz+ the difference is tiny.
+struct SoaAnimationClip {
+	float duration;
+	float framesPerSecond; // (numFrames-1) / duration, so the last frame lands exactly on duration
+	uint32 numFrames;
+	uint32 numBones;
+	uint32 stride; // LOCAL_POSE_STRIDE(numBones)
+	float* frames; // [numFrames][LOCAL_POSE_NUM_CHANNELS][stride]
+};
+
+// sampleRate is in frames per second, it gets rounded up so frames are evenly spaced over the clip
+void build_soa_clip(SoaAnimationClip* clip, const KmxSkeleton& skeleton, int32 animationIndex, float sampleRate = 30.0f);
+void free_soa_clip(SoaAnimationClip* clip);
+
+void sample_soa_clip(const SoaAnimationClip& clip, float currentAnimationTime, LocalPose* outputPose);
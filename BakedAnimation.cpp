@@ -0,0 +1,95 @@
+#include "BakedAnimation.h"
+
+#include <stdlib.h> //malloc, free
+
+#include "Animation.h"
+
+void bake_animations(BakedAnimation* baked, const KmxSkeleton& skeleton, const mat4* inverse_bind_poses, float sample_rate)
+{
+    assert(sample_rate > 0);
+    KmxAnimation* animations = (KmxAnimation*)(&skeleton.data + skeleton.animationsOffset);
+
+    *baked = {};
+    baked->num_bones = skeleton.numBones;
+    baked->num_clips = skeleton.numAnimations;
+    baked->clips = (BakedClip*)malloc(skeleton.numAnimations * sizeof(BakedClip));
+
+    // Same frame spacing as build_soa_clip(): an exact number of frames per clip, first and last on the clip's ends
+    for(uint32 clip_index = 0; clip_index < baked->num_clips; ++clip_index)
+    {
+        BakedClip* clip = &baked->clips[clip_index];
+        float duration = animations[clip_index].duration;
+        clip->first_frame = baked->num_frames;
+        clip->num_frames = (duration > 0) ? (uint32)ceilf(duration * sample_rate) + 1 : 1;
+        clip->frames_per_second = (clip->num_frames > 1) ? (clip->num_frames - 1) / duration : 0.0f;
+        clip->duration = duration;
+        baked->num_frames += clip->num_frames;
+    }
+
+    baked->frames = (mat3x4*)malloc(baked->num_frames * baked->num_bones * sizeof(mat3x4));
+    mat4* pose_mats = (mat4*)malloc(skeleton.numBones * sizeof(mat4));
+    KmxAnimationCursor cursor;
+    init_animation_cursor(&cursor, skeleton);
+
+    for(uint32 clip_index = 0; clip_index < baked->num_clips; ++clip_index)
+    {
+        const BakedClip& clip = baked->clips[clip_index];
+        for(uint32 frame_index = 0; frame_index < clip.num_frames; ++frame_index)
+        {
+            float time = (frame_index + 1 == clip.num_frames) ? clip.duration : frame_index / clip.frames_per_second;
+            animate(skeleton, (int32)clip_index, time, inverse_bind_poses, &pose_mats, &cursor);
+
+            mat3x4* frame = &baked->frames[(clip.first_frame + frame_index) * baked->num_bones];
+            for(uint32 bone_index = 0; bone_index < baked->num_bones; ++bone_index)
+                frame[bone_index] = mat4_to_mat3x4(pose_mats[bone_index]);
+        }
+    }
+
+    free_animation_cursor(&cursor);
+    free(pose_mats);
+}
+
+void free_baked_animation(BakedAnimation* baked)
+{
+    assert(baked->texture == 0);
+    free(baked->clips);
+    free(baked->frames);
+    *baked = {};
+}
+
+void sample_baked_animation(const BakedAnimation& baked, uint32 clip_index, float time, mat3x4* out_pose_mats)
+{
+    assert(baked.frames);
+    assert(clip_index < baked.num_clips);
+    const BakedClip& clip = baked.clips[clip_index];
+
+    float frame = 0.0f;
+    if(clip.num_frames > 1) {
+        float duration = (clip.num_frames - 1) / clip.frames_per_second;
+        frame = fmodf(time, duration);
+        if(frame < 0) frame += duration; // GLSL's mod() is always positive
+        frame *= clip.frames_per_second;
+    }
+    uint32 frame0 = MIN((uint32)frame, (clip.num_frames > 1) ? clip.num_frames - 2 : 0);
+    uint32 frame1 = MIN(frame0 + 1, clip.num_frames - 1);
+    float t = CLAMP(frame - frame0, 0.0f, 1.0f);
+
+    const mat3x4* from = &baked.frames[(clip.first_frame + frame0) * baked.num_bones];
+    const mat3x4* to = &baked.frames[(clip.first_frame + frame1) * baked.num_bones];
+    for(uint32 bone_index = 0; bone_index < baked.num_bones; ++bone_index)
+    {
+        for(int i = 0; i < 12; ++i)
+            out_pose_mats[bone_index].m[i] = from[bone_index].m[i] + (to[bone_index].m[i] - from[bone_index].m[i]) * t;
+    }
+}
+
+void set_baked_instance(BakedInstance* instance, const BakedAnimation& baked, uint32 clip_index, float time_offset, const mat4& M)
+{
+    assert(clip_index < baked.num_clips);
+    const BakedClip& clip = baked.clips[clip_index];
+    instance->M = M;
+    instance->first_frame = (float)clip.first_frame;
+    instance->num_frames = (float)clip.num_frames;
+    instance->frames_per_second = clip.frames_per_second;
+    instance->time_offset = time_offset;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "utils.h"
+#include "GameMaths.h"
+
+struct KmxSkeleton;
+
+// Animations sampled ahead of time into a texture so crowds can be skinned entirely on the GPU:
+// one instanced draw call (Shaders/Skinning_baked.vert) and no per-frame CPU animation at all.
+// Every clip is sampled with animate() at a fixed rate and stored as rows of the texture, one row per frame,
+// 3 RGBA32F texels (a mat3x4) per bone. The shader lerps between the two frames either side of the current time.
+// Costs num_bones * 48 bytes per frame, e.g. ~144KB per second of animation for 100 bones at 30Hz.
+// Nothing in here uses GL so it builds headless, uploading and drawing are in BakedCrowd.h
+
+struct BakedClip {
+    uint32 first_frame;      // row of the clip's first frame
+    uint32 num_frames;       // includes both ends, the first and last frame are time 0 and duration
+    float frames_per_second;
+    float duration;
+};
+
+struct BakedAnimation {
+    uint32 num_bones;
+    uint32 num_clips;
+    uint32 num_frames;       // rows in the texture, all clips back to back
+    BakedClip* clips;
+    mat3x4* frames;          // num_frames * num_bones pose matrices, NULL once uploaded unless kept
+    uint32 texture;          // GL texture from upload_baked_animation(), 0 until then
+};
+
+// Samples every animation of skeleton (pose matrices, so inverse bind poses are baked in)
+void bake_animations(BakedAnimation* baked, const KmxSkeleton& skeleton, const mat4* inverse_bind_poses, float sample_rate = 30.0f);
+// Frees the CPU side only, use delete_baked_animation() if it was uploaded
+void free_baked_animation(BakedAnimation* baked);
+
+// Same lookup as Skinning_baked.vert, for checking it and for CPU skinning. Needs the CPU copy of the frames
+void sample_baked_animation(const BakedAnimation& baked, uint32 clip_index, float time, mat3x4* out_pose_mats);
+
+// Per instance data read by Skinning_baked.vert, BAKED_INSTANCE_NUM_TEXELS texels each
+struct BakedInstance {
+    mat4 M;
+    float first_frame;
+    float num_frames;
+    float frames_per_second;
+    float time_offset;       // added to the time passed to draw_baked_crowd()
+};
+#define BAKED_INSTANCE_NUM_TEXELS 5 // passed to the shader as instanceNumTexels
+static_assert(sizeof(BakedInstance) == BAKED_INSTANCE_NUM_TEXELS*4*sizeof(float), "BakedInstance must be exactly BAKED_INSTANCE_NUM_TEXELS RGBA32F texels");
+
+void set_baked_instance(BakedInstance* instance, const BakedAnimation& baked, uint32 clip_index, float time_offset, const mat4& M);
@@ -0,0 +1,96 @@
+#include "BakedCrowd.h"
+
+#include <stdio.h>
+#include <stdlib.h> //free
+
+#include "Shader.h"
+
+bool upload_baked_animation(BakedAnimation* baked, bool keep_frames)
+{
+    assert(baked->frames);
+
+    // Each frame is one row, so the longest dimension is usually the number of frames
+    GLint max_texture_size = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
+    uint32 width = baked->num_bones * sizeof(mat3x4) / (4*sizeof(float));
+    if((width > (uint32)max_texture_size) || (baked->num_frames > (uint32)max_texture_size)) {
+        fprintf(stderr, "ERROR: Baked animation is %ux%u texels, max texture size is %d. Try a lower sample rate\n", width, baked->num_frames, max_texture_size);
+        return false;
+    }
+
+    glGenTextures(1, &baked->texture);
+    glBindTexture(GL_TEXTURE_2D, baked->texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, baked->num_frames, 0, GL_RGBA, GL_FLOAT, baked->frames);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    check_gl_error();
+
+    if(!keep_frames) {
+        free(baked->frames);
+        baked->frames = NULL;
+    }
+    return true;
+}
+
+void delete_baked_animation(BakedAnimation* baked)
+{
+    if(baked->texture) glDeleteTextures(1, &baked->texture);
+    baked->texture = 0;
+    free_baked_animation(baked);
+}
+
+void init_baked_crowd(BakedCrowd* crowd, uint32 max_instances)
+{
+    crowd->max_instances = max_instances;
+    crowd->num_instances = 0;
+
+    glGenBuffers(1, &crowd->tbo);
+    glBindBuffer(GL_TEXTURE_BUFFER, crowd->tbo);
+    glBufferData(GL_TEXTURE_BUFFER, max_instances * sizeof(BakedInstance), NULL, GL_DYNAMIC_DRAW);
+
+    glGenTextures(1, &crowd->texture);
+    glBindTexture(GL_TEXTURE_BUFFER, crowd->texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, crowd->tbo);
+
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    check_gl_error();
+}
+
+void upload_baked_crowd(BakedCrowd* crowd, const BakedInstance* instances, uint32 num_instances)
+{
+    assert(num_instances <= crowd->max_instances);
+    crowd->num_instances = num_instances;
+
+    glBindBuffer(GL_TEXTURE_BUFFER, crowd->tbo);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, num_instances * sizeof(BakedInstance), instances);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void draw_baked_crowd(const BakedCrowd& crowd, const BakedAnimation& baked, const Shader& shader, GLuint vao, uint32 index_count,
+                      float time, uint32 texture_unit)
+{
+    if(crowd.num_instances == 0) return;
+
+    glActiveTexture(GL_TEXTURE0 + texture_unit);
+    glBindTexture(GL_TEXTURE_2D, baked.texture);
+    glUniform1i(shader.baked_frames_loc, texture_unit);
+
+    glActiveTexture(GL_TEXTURE0 + texture_unit + 1);
+    glBindTexture(GL_TEXTURE_BUFFER, crowd.texture);
+    glUniform1i(shader.instances_loc, texture_unit + 1);
+    glUniform1i(shader.instance_num_texels_loc, BAKED_INSTANCE_NUM_TEXELS);
+
+    glUniform1f(shader.anim_time_loc, time);
+
+    glBindVertexArray(vao);
+    glDrawElementsInstanced(GL_TRIANGLES, index_count, GL_UNSIGNED_SHORT, 0, crowd.num_instances);
+}
+
+void delete_baked_crowd(BakedCrowd* crowd)
+{
+    glDeleteTextures(1, &crowd->texture);
+    glDeleteBuffers(1, &crowd->tbo);
+    *crowd = {};
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "gl_lite.h"
+#include "utils.h"
+#include "BakedAnimation.h"
+
+struct Shader;
+
+// GPU side of BakedAnimation.h: the baked frames texture, and crowds of instances drawn with Shaders/Skinning_baked.vert
+
+// Creates baked->texture. The CPU copy of the frames is freed unless keep_frames is set
+bool upload_baked_animation(BakedAnimation* baked, bool keep_frames = false);
+// Deletes baked->texture and frees the CPU side
+void delete_baked_animation(BakedAnimation* baked);
+
+// Instances stored in a texture buffer. They only need uploading when they change (not every frame),
+// clips advance by themselves with the time passed to draw_baked_crowd()
+struct BakedCrowd {
+    GLuint tbo;
+    GLuint texture;
+    uint32 max_instances;
+    uint32 num_instances;
+};
+
+void init_baked_crowd(BakedCrowd* crowd, uint32 max_instances);
+void upload_baked_crowd(BakedCrowd* crowd, const BakedInstance* instances, uint32 num_instances);
+// Draws every instance of the mesh in vao (GL_UNSIGNED_SHORT indices) with shader, which must be Skinning_baked.vert.
+// Uses texture units texture_unit and texture_unit+1. time is in seconds, as a float it stays well within a frame for hours
+void draw_baked_crowd(const BakedCrowd& crowd, const BakedAnimation& baked, const Shader& shader, GLuint vao, uint32 index_count,
+                      float time, uint32 texture_unit = 0);
+void delete_baked_crowd(BakedCrowd* crowd);
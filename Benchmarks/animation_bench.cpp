@@ -0,0 +1,648 @@
+// Headless animation sampling benchmark: animate() over a crowd of instances, and its parts on their own
+// (sample_local_pose, local_pose_to_pose_mats, slerp, slerp_batch, quat_to_mat4), compressed clips and pose blending,
+// plus checks of LOD'd and baked animation and the animation graph's lazy evaluation.
+// Every instance plays its own skeleton's clip from a different start time, like characters in a level.
+// Usage: animation_bench [bone_count] [keys_per_track] [clip_ms] [instance_count] [frames]
+
+#include "benchmark.h"
+#include "bench_skeleton.h"
+
+#include "../GameMaths.h"
+#include "../Animation.h"
+#include "../AnimationCompression.h"
+#include "../AnimationBlending.h"
+#include "../AnimationLod.h"
+#include "../Camera3D.h"
+#include "../BakedAnimation.h"
+#include "../AnimationGraph.h"
+
+#include "../Animation.cpp"
+#include "../AnimationCompression.cpp"
+#include "../AnimationBlending.cpp"
+#include "../AnimationLod.cpp"
+#include "../BakedAnimation.cpp"
+#include "../AnimationGraph.cpp"
+
+#define BENCH_DT (1.0f / 60.0f)
+#define BENCH_MICRO_COUNT 1024 // inputs for the slerp/slerp_batch/quat_to_mat4 loops, small enough to stay in L1
+
+struct AnimationTestData {
+    uint32 bone_count;
+    uint32 instance_count;
+    float clip_duration;
+    KmxSkeleton** skeletons;        // one per instance
+    KmxAnimationCursor* cursors;
+    float* time_offsets;
+    mat4* inverse_bind_poses;       // shared, identity: the multiply costs the same whatever's in it
+    mat4** pose_mats;               // one array per instance
+    LocalPose pose;
+};
+
+static void report_animation(const char* name, double elapsed, double poses, uint32 bone_count)
+{
+    report_result(name, "ns_per_bone", elapsed * 1e9 / (poses * bone_count));
+    report_result(name, "pose_mats_per_sec", poses * bone_count / elapsed);
+    report_result(name, "us_per_instance", elapsed * 1e6 / poses);
+}
+
+// The whole of animate(): every instance advances by BENCH_DT per frame
+static void bench_animate(const char* name, AnimationTestData* data, uint32 frames, bool use_cursors)
+{
+    double start = get_time_seconds();
+    for(uint32 frame = 0; frame < frames; ++frame)
+    {
+        for(uint32 i = 0; i < data->instance_count; ++i){
+            float time = fmodf(data->time_offsets[i] + frame * BENCH_DT, data->clip_duration);
+            animate(*data->skeletons[i], 0, time, data->inverse_bind_poses, &data->pose_mats[i], use_cursors ? &data->cursors[i] : NULL);
+            benchmark_sink = data->pose_mats[i][frame % data->bone_count].m[12];
+        }
+    }
+    double elapsed = get_time_seconds() - start;
+    report_animation(name, elapsed, (double)frames * data->instance_count, data->bone_count);
+}
+
+// First half of animate(): keyframe search and interpolation only
+// bone_masks (optional, bone_count per instance) leaves bones out like AnimationLod does for far characters
+static void bench_sample_local_pose(const char* name, AnimationTestData* data, uint32 frames, const uint8* bone_masks = NULL)
+{
+    double start = get_time_seconds();
+    for(uint32 frame = 0; frame < frames; ++frame)
+    {
+        for(uint32 i = 0; i < data->instance_count; ++i){
+            float time = fmodf(data->time_offsets[i] + frame * BENCH_DT, data->clip_duration);
+            const uint8* bone_mask = bone_masks ? &bone_masks[i * data->bone_count] : NULL;
+            sample_local_pose(*data->skeletons[i], 0, time, &data->pose, &data->cursors[i], bone_mask);
+            benchmark_sink = data->pose.qw[frame % data->bone_count];
+        }
+    }
+    double elapsed = get_time_seconds() - start;
+    report_animation(name, elapsed, (double)frames * data->instance_count, data->bone_count);
+}
+
+// Second half of animate(): local transforms to skinning matrices, from the same pose every time
+static void bench_pose_mats(const char* name, AnimationTestData* data, uint32 frames)
+{
+    sample_local_pose(*data->skeletons[0], 0, 0.5f * data->clip_duration, &data->pose);
+    double start = get_time_seconds();
+    for(uint32 frame = 0; frame < frames; ++frame)
+    {
+        for(uint32 i = 0; i < data->instance_count; ++i){
+            local_pose_to_pose_mats(*data->skeletons[i], data->pose, data->inverse_bind_poses, data->pose_mats[i]);
+            benchmark_sink = data->pose_mats[i][frame % data->bone_count].m[12];
+        }
+    }
+    double elapsed = get_time_seconds() - start;
+    report_animation(name, elapsed, (double)frames * data->instance_count, data->bone_count);
+}
+
+static void bench_slerp(uint32 iterations, BenchRng* rng)
+{
+    versor* from = (versor*)malloc(BENCH_MICRO_COUNT * sizeof(versor));
+    versor* to = (versor*)malloc(BENCH_MICRO_COUNT * sizeof(versor));
+    float* t = (float*)malloc(BENCH_MICRO_COUNT * sizeof(float));
+    for(uint32 i = 0; i < BENCH_MICRO_COUNT; ++i){
+        vec3 axis = normalise(vec3{rand_float(rng, -1, 1), rand_float(rng, -1, 1), rand_float(rng, -1, 1)});
+        from[i] = quat_from_axis_deg(rand_float(rng, -180, 180), axis);
+        to[i] = quat_from_axis_deg(rand_float(rng, -180, 180), axis);
+        t[i] = rand_float(rng, 0, 1);
+    }
+
+    double start = get_time_seconds();
+    for(uint32 iteration = 0; iteration < iterations; ++iteration){
+        float sum = 0;
+        for(uint32 i = 0; i < BENCH_MICRO_COUNT; ++i){
+            versor q = from[i]; //slerp() can negate its first argument
+            sum += slerp(q, to[i], t[i]).q[0];
+        }
+        benchmark_sink = sum;
+    }
+    double elapsed = get_time_seconds() - start;
+    report_result("animation/slerp", "ns_per_call", elapsed * 1e9 / ((double)iterations * BENCH_MICRO_COUNT));
+
+    //The same pairs as SoA arrays through slerp_batch(), which is what sampling uses
+    float* soa = (float*)malloc(12 * BENCH_MICRO_COUNT * sizeof(float));
+    versor_soa soa_from = {soa, soa + BENCH_MICRO_COUNT, soa + 2*BENCH_MICRO_COUNT, soa + 3*BENCH_MICRO_COUNT};
+    versor_soa soa_to = {soa + 4*BENCH_MICRO_COUNT, soa + 5*BENCH_MICRO_COUNT, soa + 6*BENCH_MICRO_COUNT, soa + 7*BENCH_MICRO_COUNT};
+    versor_soa soa_out = {soa + 8*BENCH_MICRO_COUNT, soa + 9*BENCH_MICRO_COUNT, soa + 10*BENCH_MICRO_COUNT, soa + 11*BENCH_MICRO_COUNT};
+    for(uint32 i = 0; i < BENCH_MICRO_COUNT; ++i){
+        soa_from.w[i] = from[i].q[0]; soa_from.x[i] = from[i].q[1]; soa_from.y[i] = from[i].q[2]; soa_from.z[i] = from[i].q[3];
+        soa_to.w[i] = to[i].q[0]; soa_to.x[i] = to[i].q[1]; soa_to.y[i] = to[i].q[2]; soa_to.z[i] = to[i].q[3];
+    }
+
+    start = get_time_seconds();
+    for(uint32 iteration = 0; iteration < iterations; ++iteration){
+        slerp_batch(soa_from, soa_to, t, soa_out, BENCH_MICRO_COUNT);
+        benchmark_sink = soa_out.w[iteration % BENCH_MICRO_COUNT];
+    }
+    elapsed = get_time_seconds() - start;
+    report_result("animation/slerp_batch", "ns_per_call", elapsed * 1e9 / ((double)iterations * BENCH_MICRO_COUNT));
+
+    free(soa);
+    free(from);
+    free(to);
+    free(t);
+}
+
+static void bench_quat_to_mat4(uint32 iterations, BenchRng* rng)
+{
+    versor* quats = (versor*)malloc(BENCH_MICRO_COUNT * sizeof(versor));
+    for(uint32 i = 0; i < BENCH_MICRO_COUNT; ++i){
+        vec3 axis = normalise(vec3{rand_float(rng, -1, 1), rand_float(rng, -1, 1), rand_float(rng, -1, 1)});
+        quats[i] = quat_from_axis_deg(rand_float(rng, -180, 180), axis);
+    }
+
+    double start = get_time_seconds();
+    for(uint32 iteration = 0; iteration < iterations; ++iteration){
+        float sum = 0;
+        for(uint32 i = 0; i < BENCH_MICRO_COUNT; ++i)
+            sum += quat_to_mat4(quats[i]).m[(i + iteration) % 16];
+        benchmark_sink = sum;
+    }
+    double elapsed = get_time_seconds() - start;
+    report_result("animation/quat_to_mat4", "ns_per_call", elapsed * 1e9 / ((double)iterations * BENCH_MICRO_COUNT));
+
+    free(quats);
+}
+
+// Bone's transform relative to its parent, from model space matrices (rigid, so the inverse is a transpose)
+static void local_from_model(const KmxSkeleton& skeleton, const mat4* model_mats, uint32 b, float* out_rot, vec3* out_tra)
+{
+    const KmxBone* bones = (const KmxBone*)(&skeleton.data + skeleton.bonesOffset);
+    const mat4& m = model_mats[b];
+    mat4 p = identity_mat4();
+    if(bones[b].parentIndex >= 0) p = model_mats[bones[b].parentIndex];
+    vec3 d = {m.m[12] - p.m[12], m.m[13] - p.m[13], m.m[14] - p.m[14]};
+    for(int col = 0; col < 3; ++col){
+        for(int row = 0; row < 3; ++row){
+            float sum = 0;
+            for(int k = 0; k < 3; ++k) sum += p.m[4*row + k] * m.m[4*col + k];
+            out_rot[3*col + row] = sum;
+        }
+    }
+    for(int row = 0; row < 3; ++row)
+        out_tra->v[row] = p.m[4*row] * d.v[0] + p.m[4*row + 1] * d.v[1] + p.m[4*row + 2] * d.v[2];
+}
+
+// Largest per-bone local translation distance and rotation angle between two sets of model space matrices,
+// which is what the compression tolerances are measured in
+static void max_local_error(const KmxSkeleton& skeleton, const mat4* a, const mat4* b, float* max_tra_error, float* max_rot_error)
+{
+    for(uint32 bone = 0; bone < skeleton.numBones; ++bone){
+        float rot_a[9], rot_b[9];
+        vec3 tra_a, tra_b;
+        local_from_model(skeleton, a, bone, rot_a, &tra_a);
+        local_from_model(skeleton, b, bone, rot_b, &tra_b);
+        float dist_sq = 0;
+        for(int i = 0; i < 9; ++i) dist_sq += (rot_a[i] - rot_b[i]) * (rot_a[i] - rot_b[i]);
+        // |Ra - Rb| (Frobenius) = 2*sqrt(2)*sin(angle/2)
+        float angle = 2.0f * asinf(MIN(sqrtf(dist_sq) / 2.82842712f, 1.0f));
+        *max_tra_error = MAX(*max_tra_error, length(tra_a - tra_b));
+        *max_rot_error = MAX(*max_rot_error, angle);
+    }
+}
+
+// animate_compressed() over the same crowd as bench_animate(), then every frame of the first few instances
+// checked against animate(). Returns false if any bone is further off than the tolerances allow
+static bool bench_compression(AnimationTestData* data, uint32 frames)
+{
+    KmxCompressionSettings settings = {0.001f, 0.002f};
+    KmxCompressedClips** clips = (KmxCompressedClips**)malloc(data->instance_count * sizeof(KmxCompressedClips*));
+    KmxAnimationCursor* cursors = (KmxAnimationCursor*)malloc(data->instance_count * sizeof(KmxAnimationCursor));
+    double source_bytes = 0, compressed_bytes = 0;
+    double start = get_time_seconds();
+    for(uint32 i = 0; i < data->instance_count; ++i){
+        uint32 size;
+        clips[i] = compress_animations(*data->skeletons[i], settings, &size);
+        compressed_bytes += size;
+        source_bytes += animation_data_size(*data->skeletons[i]);
+        init_animation_cursor(&cursors[i], *data->skeletons[i]);
+    }
+    double elapsed = get_time_seconds() - start;
+    report_result("animation/compress_animations", "ms_per_skeleton", elapsed * 1e3 / data->instance_count);
+    report_result("animation/compress_animations", "size_ratio", source_bytes / compressed_bytes);
+
+    start = get_time_seconds();
+    for(uint32 frame = 0; frame < frames; ++frame)
+    {
+        for(uint32 i = 0; i < data->instance_count; ++i){
+            float time = fmodf(data->time_offsets[i] + frame * BENCH_DT, data->clip_duration);
+            animate_compressed(*data->skeletons[i], *clips[i], 0, time, data->inverse_bind_poses, &data->pose_mats[i], &cursors[i]);
+            benchmark_sink = data->pose_mats[i][frame % data->bone_count].m[12];
+        }
+    }
+    elapsed = get_time_seconds() - start;
+    report_animation("animation/animate_compressed", elapsed, (double)frames * data->instance_count, data->bone_count);
+
+    // The tolerances are against the source keys, which animate() interpolates with slerp_batch() and
+    // animate_compressed() with slerp_fast(). Those agree to within float rounding, allow a little for that
+    mat4* reference = (mat4*)malloc(data->bone_count * sizeof(mat4));
+    float max_tra_error = 0, max_rot_error = 0;
+    for(uint32 i = 0; i < MIN(data->instance_count, 16u); ++i){
+        for(uint32 frame = 0; frame < frames; ++frame){
+            float time = fmodf(data->time_offsets[i] + frame * BENCH_DT, data->clip_duration);
+            animate(*data->skeletons[i], 0, time, data->inverse_bind_poses, &reference);
+            animate_compressed(*data->skeletons[i], *clips[i], 0, time, data->inverse_bind_poses, &data->pose_mats[i], &cursors[i]);
+            max_local_error(*data->skeletons[i], reference, data->pose_mats[i], &max_tra_error, &max_rot_error);
+        }
+    }
+    report_result("animation/compressed_vs_animate", "max_translation_error", max_tra_error);
+    report_result("animation/compressed_vs_animate", "max_rotation_error", max_rot_error);
+    bool passed = (max_tra_error <= settings.maxTranslationError + 1e-5f) && (max_rot_error <= settings.maxRotationError + 1e-5f);
+
+    for(uint32 i = 0; i < data->instance_count; ++i){
+        free(clips[i]);
+        free_animation_cursor(&cursors[i]);
+    }
+    free(clips);
+    free(cursors);
+    free(reference);
+    return passed;
+}
+
+// Largest per-bone translation distance and rotation angle between two local poses (q and -q count as equal)
+static void max_pose_error(const LocalPose& a, const LocalPose& b, float* max_tra_error, float* max_rot_error)
+{
+    for(uint32 bone = 0; bone < a.numBones; ++bone){
+        vec3 d = {a.tx[bone] - b.tx[bone], a.ty[bone] - b.ty[bone], a.tz[bone] - b.tz[bone]};
+        versor qa = {a.qw[bone], a.qx[bone], a.qy[bone], a.qz[bone]};
+        versor qb = {b.qw[bone], b.qx[bone], b.qy[bone], b.qz[bone]};
+        if(dot(qa, qb) < 0) qb = -qb;
+        float dist_sq = 0;
+        for(int i = 0; i < 4; ++i) dist_sq += (qa.q[i] - qb.q[i]) * (qa.q[i] - qb.q[i]);
+        *max_tra_error = MAX(*max_tra_error, length(d));
+        *max_rot_error = MAX(*max_rot_error, 4.0f * asinf(MIN(0.5f * sqrtf(dist_sq), 1.0f)));
+    }
+}
+
+static void copy_pose(const LocalPose& from, LocalPose* to)
+{
+    float* src[LOCAL_POSE_NUM_CHANNELS] = {from.tx, from.ty, from.tz, from.qw, from.qx, from.qy, from.qz};
+    float* dst[LOCAL_POSE_NUM_CHANNELS] = {to->tx, to->ty, to->tz, to->qw, to->qx, to->qy, to->qz};
+    for(int c = 0; c < LOCAL_POSE_NUM_CHANNELS; ++c)
+        memcpy(dst[c], src[c], from.stride * sizeof(float));
+}
+
+// blend_local_poses() of 3 poses, make_additive_pose() and a masked apply_additive_pose(), once per instance per frame
+// on the same inputs (so this is the cost of the kernels with everything in cache), then checks that:
+//  - a blend with weights {1, 0, 0} gives back the first pose
+//  - applying make_additive_pose(pose, reference) to reference at weight 1 gives back pose
+//  - an additive layer with every bone weight 0 changes nothing
+// Returns false if any of those are off by more than float rounding
+static bool bench_blending(AnimationTestData* data, uint32 frames)
+{
+    LocalPose poses[3], reference, delta, output;
+    for(int i = 0; i < 3; ++i){
+        init_local_pose(&poses[i], data->bone_count);
+        sample_local_pose(*data->skeletons[i % data->instance_count], 0, data->time_offsets[i % data->instance_count], &poses[i]);
+    }
+    init_local_pose(&reference, data->bone_count);
+    init_local_pose(&delta, data->bone_count);
+    init_local_pose(&output, data->bone_count);
+    sample_local_pose(*data->skeletons[0], 0, 0.0f, &reference);
+    float* bone_weights = (float*)malloc(data->bone_count * sizeof(float));
+    for(uint32 b = 0; b < data->bone_count; ++b)
+        bone_weights[b] = (b % 2) ? 1.0f : 0.5f;
+
+    uint32 count = frames * data->instance_count;
+    float weights[3] = {0.5f, 0.3f, 0.2f};
+    double start = get_time_seconds();
+    for(uint32 i = 0; i < count; ++i){
+        blend_local_poses(poses, weights, 3, &output);
+        benchmark_sink = output.qw[i % data->bone_count];
+    }
+    report_animation("animation/blend_local_poses_3", get_time_seconds() - start, count, data->bone_count);
+
+    start = get_time_seconds();
+    for(uint32 i = 0; i < count; ++i){
+        make_additive_pose(poses[i % 3], reference, &delta);
+        benchmark_sink = delta.qw[i % data->bone_count];
+    }
+    report_animation("animation/make_additive_pose", get_time_seconds() - start, count, data->bone_count);
+
+    make_additive_pose(poses[1], reference, &delta);
+    start = get_time_seconds();
+    for(uint32 i = 0; i < count; ++i){
+        apply_additive_pose(&output, delta, 0.5f, bone_weights);
+        benchmark_sink = output.qw[i % data->bone_count];
+    }
+    report_animation("animation/apply_additive_pose", get_time_seconds() - start, count, data->bone_count);
+
+    float first_tra = 0, first_rot = 0;
+    float unit_weights[3] = {1.0f, 0.0f, 0.0f};
+    blend_local_poses(poses, unit_weights, 3, &output);
+    max_pose_error(output, poses[0], &first_tra, &first_rot);
+    report_result("animation/blend_weights_1_0_0", "max_translation_error", first_tra);
+    report_result("animation/blend_weights_1_0_0", "max_rotation_error", first_rot);
+
+    float round_trip_tra = 0, round_trip_rot = 0;
+    for(int i = 0; i < 3; ++i){
+        make_additive_pose(poses[i], reference, &delta);
+        copy_pose(reference, &output);
+        apply_additive_pose(&output, delta, 1.0f);
+        max_pose_error(output, poses[i], &round_trip_tra, &round_trip_rot);
+    }
+    report_result("animation/additive_round_trip", "max_translation_error", round_trip_tra);
+    report_result("animation/additive_round_trip", "max_rotation_error", round_trip_rot);
+
+    float masked_tra = 0, masked_rot = 0;
+    for(uint32 b = 0; b < data->bone_count; ++b)
+        bone_weights[b] = 0.0f;
+    copy_pose(reference, &output);
+    apply_additive_pose(&output, delta, 1.0f, bone_weights);
+    max_pose_error(output, reference, &masked_tra, &masked_rot);
+    report_result("animation/additive_masked_out", "max_translation_error", masked_tra);
+    report_result("animation/additive_masked_out", "max_rotation_error", masked_rot);
+
+    for(int i = 0; i < 3; ++i)
+        free_local_pose(&poses[i]);
+    free_local_pose(&reference);
+    free_local_pose(&delta);
+    free_local_pose(&output);
+    free(bone_weights);
+
+    // Rotations go through one or two normalisations (rsqrt + a Newton-Raphson step), translations are exact
+    // apart from the round trip's add/subtract
+    return (first_tra == 0) && (first_rot <= 1e-5f) &&
+           (round_trip_tra <= 1e-5f) && (round_trip_rot <= 1e-5f) &&
+           (masked_tra == 0) && (masked_rot <= 1e-5f);
+}
+
+static float max_mat4_error(const mat4* a, const mat4* b, uint32 count)
+{
+    float max_error = 0;
+    for(uint32 i = 0; i < count; ++i)
+        for(int j = 0; j < 16; ++j)
+            max_error = MAX(max_error, fabsf(a[i].m[j] - b[i].m[j]));
+    return max_error;
+}
+
+// animate_lod() with leaf bones culled at every rate: the first frame of a clip has no earlier sample for the leaf
+// bones to hold, so it must still match animate() exactly. Plays a few frames of each clip before switching to the next.
+// Returns false if any first frame is off by more than float rounding
+static bool check_lod(BenchRng* rng, uint32 bone_count, float clip_duration)
+{
+    const uint32 num_animations = 2;
+    BenchSkeletonFixture fixture;
+    init_bench_skeleton_fixture(&fixture, rng, bone_count, num_animations, 31, clip_duration);
+    const KmxSkeleton* skeleton = fixture.skeleton;
+    const mat4* inverse_bind_poses = fixture.inverse_bind_poses;
+    uint8* far_bone_mask = (uint8*)malloc(bone_count);
+    build_far_bone_mask(*skeleton, far_bone_mask);
+    mat4* reference = (mat4*)malloc(bone_count * sizeof(mat4));
+    mat4* output = (mat4*)malloc(bone_count * sizeof(mat4));
+
+    const AnimationLodLevel levels[] = {ANIMATION_LOD_FULL, ANIMATION_LOD_HALF, ANIMATION_LOD_QUARTER};
+    float max_error = 0;
+    for(uint32 l = 0; l < sizeof(levels) / sizeof(levels[0]); ++l){
+        AnimationLodState lod;
+        init_animation_lod(&lod, *skeleton, far_bone_mask);
+        for(uint32 anim = 0; anim < num_animations; ++anim){
+            float start_time = (anim + 1) * 0.25f * clip_duration;
+            for(uint32 frame = 0; frame < 8; ++frame){
+                // Set by hand instead of choose_animation_lod(), which needs a camera
+                lod.level = levels[l];
+                lod.cullLeafBones = true;
+                lod.dt = BENCH_DT;
+                float time = fmodf(start_time + frame * BENCH_DT, clip_duration);
+                animate_lod(&lod, *skeleton, anim, time, inverse_bind_poses, output);
+                if(frame == 0){
+                    animate(*skeleton, anim, time, inverse_bind_poses, &reference);
+                    max_error = MAX(max_error, max_mat4_error(reference, output, bone_count));
+                }
+            }
+        }
+        free_animation_lod(&lod);
+    }
+    report_result("animation/lod_first_frame_vs_animate", "max_error", max_error);
+
+    free_bench_skeleton_fixture(&fixture);
+    free(far_bone_mask);
+    free(reference);
+    free(output);
+    // Reduced rate blends towards the next sample, which renormalises rotations
+    return max_error <= 1e-4f;
+}
+
+// sample_baked_animation() (the CPU copy of Skinning_baked.vert's lookup) at every baked frame's time must give what
+// animate() gave when baking. Between frames it lerps matrices, that error is reported but depends on the clip.
+// Returns false if any frame is off by more than float rounding
+static bool check_baked_animation(BenchRng* rng, uint32 bone_count, float clip_duration)
+{
+    const uint32 num_animations = 2;
+    BenchSkeletonFixture fixture;
+    init_bench_skeleton_fixture(&fixture, rng, bone_count, num_animations, 31, clip_duration);
+    const KmxSkeleton* skeleton = fixture.skeleton;
+    const mat4* inverse_bind_poses = fixture.inverse_bind_poses;
+    mat4* reference = (mat4*)malloc(bone_count * sizeof(mat4));
+    mat3x4* baked_pose = (mat3x4*)malloc(bone_count * sizeof(mat3x4));
+
+    BakedAnimation baked;
+    bake_animations(&baked, *skeleton, inverse_bind_poses);
+
+    float max_frame_error = 0, max_mid_frame_error = 0;
+    for(uint32 clip_index = 0; clip_index < baked.num_clips; ++clip_index){
+        const BakedClip& clip = baked.clips[clip_index];
+        for(uint32 frame = 0; frame < clip.num_frames; ++frame){
+            for(int mid = 0; mid < 2; ++mid){
+                float time = (frame + 0.5f * mid) / clip.frames_per_second;
+                if(time >= clip.duration) break;
+                animate(*skeleton, (int32)clip_index, time, inverse_bind_poses, &reference);
+                sample_baked_animation(baked, clip_index, time, baked_pose);
+                float* max_error = mid ? &max_mid_frame_error : &max_frame_error;
+                for(uint32 b = 0; b < bone_count; ++b){
+                    mat3x4 expected = mat4_to_mat3x4(reference[b]);
+                    for(int i = 0; i < 12; ++i)
+                        *max_error = MAX(*max_error, fabsf(expected.m[i] - baked_pose[b].m[i]));
+                }
+            }
+        }
+    }
+    report_result("animation/baked_vs_animate", "max_error_at_frames", max_frame_error);
+    report_result("animation/baked_vs_animate", "max_error_between_frames", max_mid_frame_error);
+
+    free_baked_animation(&baked);
+    free_bench_skeleton_fixture(&fixture);
+    free(reference);
+    free(baked_pose);
+    // Frame times are recomputed from frames_per_second, so sampling can land a hair either side of a frame
+    return max_frame_error <= 1e-5f;
+}
+
+// Whether any of the samples instance keeps between evaluations are of animation_index
+static bool graph_sampled_clip(const AnimationGraphInstance& instance, int32 animation_index)
+{
+    for(uint32 i = 0; i < ANIMATION_GRAPH_MAX_SAMPLES; ++i)
+        if(instance.samples[i].animationIndex == animation_index) return true;
+    return false;
+}
+
+// A small idle/locomotion graph, checked through AnimationGraphStats:
+//  - a held idle pose is sampled once, later evaluations reuse the result
+//  - cross fading into locomotion, the idle pose both states play is sampled once and reused from before the fade,
+//    only the walk is sampled each frame
+//  - the run blend (a subtree of 3 nodes) has zero weight, so it's counted as skipped and clip 2 is never sampled
+// Returns false if any counter is off
+static bool check_animation_graph(BenchRng* rng, uint32 bone_count, float clip_duration)
+{
+    BenchSkeletonFixture fixture;
+    init_bench_skeleton_fixture(&fixture, rng, bone_count, 3, 31, clip_duration);
+    const KmxSkeleton* skeleton = fixture.skeleton;
+    const mat4* inverse_bind_poses = fixture.inverse_bind_poses;
+    mat4* pose_mats = (mat4*)malloc(bone_count * sizeof(mat4));
+
+    enum { PARAM_SPEED, PARAM_LEAN, NUM_PARAMS };
+    AnimationNode nodes[7] = {};
+    nodes[0] = {ANIMATION_NODE_CLIP, 0, 0.0f, true};  // idle, held on its first frame
+    nodes[1].type = ANIMATION_NODE_BLEND_1D;          // locomotion: idle -> walk -> run by speed
+    nodes[1].parameterIndex = PARAM_SPEED;
+    nodes[1].numChildren = 3;
+    nodes[1].children[0] = 2; nodes[1].thresholds[0] = 0.0f;
+    nodes[1].children[1] = 3; nodes[1].thresholds[1] = 1.0f;
+    nodes[1].children[2] = 4; nodes[1].thresholds[2] = 2.0f;
+    nodes[2] = {ANIMATION_NODE_CLIP, 0, 0.0f, true};  // the same held idle
+    nodes[3] = {ANIMATION_NODE_CLIP, 1, 1.0f, true};  // walk
+    nodes[4].type = ANIMATION_NODE_BLEND_1D;          // run, leaning by PARAM_LEAN
+    nodes[4].parameterIndex = PARAM_LEAN;
+    nodes[4].numChildren = 2;
+    nodes[4].children[0] = 5; nodes[4].thresholds[0] = 0.0f;
+    nodes[4].children[1] = 6; nodes[4].thresholds[1] = 1.0f;
+    nodes[5] = {ANIMATION_NODE_CLIP, 2, 1.0f, true};
+    nodes[6] = {ANIMATION_NODE_CLIP, 2, 1.5f, true};
+    const uint32 state_nodes[2] = {0, 1};
+    const AnimationTransition transitions[1] = {{0, 1, ANIMATION_CONDITION_GREATER, PARAM_SPEED, 0.5f, 0.25f}};
+    AnimationGraph graph = {nodes, 7, state_nodes, 2, transitions, 1, NUM_PARAMS, 0};
+
+    AnimationGraphInstance instance;
+    init_animation_graph_instance(&instance, &graph, *skeleton);
+    bool passed = true;
+
+    // Idle: one sample, then the same result again
+    for(int frame = 0; frame < 2; ++frame){
+        update_animation_graph(&instance, BENCH_DT);
+        evaluate_animation_graph(&instance, *skeleton, inverse_bind_poses, pose_mats);
+    }
+    AnimationGraphStats idle;
+    gather_animation_graph_stats(&instance, 1, &idle);
+    passed = passed && (idle.numEvaluations == 2) && (idle.numCachedEvaluations == 1) && (idle.numSamples == 1);
+
+    // Start the cross fade. Its first frame is all idle, so it's cached too
+    set_animation_parameter(&instance, PARAM_SPEED, 0.75f);
+    update_animation_graph(&instance, BENCH_DT);
+    passed = passed && !evaluate_animation_graph(&instance, *skeleton, inverse_bind_poses, pose_mats);
+    gather_animation_graph_stats(&instance, 1, &idle); // just to reset them
+
+    uint32 fade_frames = 0;
+    bool sampled_run = false;
+    while(instance.previousState >= 0){
+        update_animation_graph(&instance, BENCH_DT);
+        evaluate_animation_graph(&instance, *skeleton, inverse_bind_poses, pose_mats);
+        sampled_run = sampled_run || graph_sampled_clip(instance, 2);
+        fade_frames++;
+    }
+    AnimationGraphStats fade;
+    gather_animation_graph_stats(&instance, 1, &fade);
+    // The last frame is all locomotion, which still has idle at 0.25 weight
+    uint32 evaluated = fade.numEvaluations - fade.numCachedEvaluations;
+    passed = passed && (fade_frames > 1) && (evaluated == fade_frames) &&
+             (fade.numSamples == evaluated) && (fade.numReusedSamples == evaluated) &&
+             (fade.numSkippedNodes == 3 * fade.numEvaluations) && !sampled_run;
+
+    report_result("animation/graph_idle", "cached_evaluations", idle.numCachedEvaluations);
+    report_result("animation/graph_cross_fade", "evaluations", fade.numEvaluations);
+    report_result("animation/graph_cross_fade", "samples", fade.numSamples);
+    report_result("animation/graph_cross_fade", "reused_samples", fade.numReusedSamples);
+    report_result("animation/graph_cross_fade", "skipped_nodes", fade.numSkippedNodes);
+
+    free_animation_graph_instance(&instance);
+    free_bench_skeleton_fixture(&fixture);
+    free(pose_mats);
+    return passed;
+}
+
+int main(int argc, char** argv)
+{
+    uint32 bone_count = get_arg_u32(argc, argv, 1, 64);
+    uint32 keys_per_track = MAX(get_arg_u32(argc, argv, 2, 61), 1u);
+    uint32 clip_ms = MAX(get_arg_u32(argc, argv, 3, 2000), 1u);
+    uint32 instance_count = MAX(get_arg_u32(argc, argv, 4, 256), 1u);
+    uint32 frames = get_arg_u32(argc, argv, 5, 120);
+
+    AnimationTestData data;
+    data.bone_count = bone_count;
+    data.instance_count = instance_count;
+    data.clip_duration = clip_ms / 1000.0f;
+    data.skeletons = (KmxSkeleton**)malloc(instance_count * sizeof(KmxSkeleton*));
+    data.cursors = (KmxAnimationCursor*)malloc(instance_count * sizeof(KmxAnimationCursor));
+    data.time_offsets = (float*)malloc(instance_count * sizeof(float));
+    data.pose_mats = (mat4**)malloc(instance_count * sizeof(mat4*));
+    data.inverse_bind_poses = (mat4*)malloc(bone_count * sizeof(mat4));
+    for(uint32 b = 0; b < bone_count; ++b)
+        data.inverse_bind_poses[b] = identity_mat4();
+
+    BenchRng rng = {0x12345678};
+    for(uint32 i = 0; i < instance_count; ++i){
+        data.skeletons[i] = make_bench_skeleton(&rng, bone_count, 1, keys_per_track, data.clip_duration);
+        init_animation_cursor(&data.cursors[i], *data.skeletons[i]);
+        data.time_offsets[i] = rand_float(&rng, 0, data.clip_duration);
+        data.pose_mats[i] = (mat4*)malloc(bone_count * sizeof(mat4));
+    }
+    init_local_pose(&data.pose, bone_count);
+
+    uint32 skeleton_bytes = bone_count * (sizeof(KmxBone) + sizeof(KmxBoneKeyFrames) + keys_per_track * (2*sizeof(float) + sizeof(vec3) + sizeof(versor)));
+
+    report_result("animation/config", "bone_count", bone_count);
+    report_result("animation/config", "keys_per_track", keys_per_track);
+    report_result("animation/config", "clip_duration_s", data.clip_duration);
+    report_result("animation/config", "instance_count", instance_count);
+    report_result("animation/config", "frames", frames);
+    report_result("animation/config", "simd_level", GAMEMATHS_AVX ? 2 : (GAMEMATHS_SSE ? 1 : 0));
+    report_result("animation/config", "bytes_per_skeleton", skeleton_bytes);
+
+    //Warm up, and put every cursor on its clip
+    for(uint32 i = 0; i < instance_count; ++i)
+        animate(*data.skeletons[i], 0, data.time_offsets[i], data.inverse_bind_poses, &data.pose_mats[i], &data.cursors[i]);
+
+    bench_animate("animation/animate", &data, frames, false);
+    bench_animate("animation/animate_cursor", &data, frames, true);
+    bench_sample_local_pose("animation/sample_local_pose", &data, frames);
+
+    //Leaf bones culled, still reported per bone of the whole skeleton so it compares with the line above
+    uint8* far_bone_masks = (uint8*)malloc(instance_count * bone_count);
+    uint32 num_far_bones = 0;
+    for(uint32 i = 0; i < instance_count; ++i){
+        build_far_bone_mask(*data.skeletons[i], &far_bone_masks[i * bone_count]);
+        for(uint32 b = 0; b < bone_count; ++b)
+            num_far_bones += far_bone_masks[i * bone_count + b];
+    }
+    report_result("animation/sample_local_pose_far", "far_bone_fraction", (double)num_far_bones / (instance_count * bone_count));
+    bench_sample_local_pose("animation/sample_local_pose_far", &data, frames, far_bone_masks);
+    free(far_bone_masks);
+    bench_pose_mats("animation/local_pose_to_pose_mats", &data, frames);
+
+    uint32 micro_iterations = MAX(frames * instance_count * bone_count / BENCH_MICRO_COUNT, 1u);
+    bench_slerp(micro_iterations, &rng);
+    bench_quat_to_mat4(micro_iterations, &rng);
+
+    //Validate: sampling with a cursor must give exactly the poses sampling without one does
+    mat4* reference = (mat4*)malloc(bone_count * sizeof(mat4));
+    float max_cursor_error = 0;
+    for(uint32 i = 0; i < MIN(instance_count, 16u); ++i){
+        for(uint32 frame = 0; frame < frames; ++frame){
+            float time = fmodf(data.time_offsets[i] + frame * BENCH_DT, data.clip_duration);
+            animate(*data.skeletons[i], 0, time, data.inverse_bind_poses, &reference);
+            animate(*data.skeletons[i], 0, time, data.inverse_bind_poses, &data.pose_mats[i], &data.cursors[i]);
+            for(uint32 b = 0; b < bone_count; ++b)
+                for(int j = 0; j < 16; ++j)
+                    max_cursor_error = MAX(max_cursor_error, fabsf(reference[b].m[j] - data.pose_mats[i][b].m[j]));
+        }
+    }
+    report_result("animation/cursor_vs_search", "max_error", max_cursor_error);
+
+    bool compression_passed = bench_compression(&data, frames);
+    bool blending_passed = bench_blending(&data, frames);
+    bool lod_passed = check_lod(&rng, bone_count, data.clip_duration);
+    bool baked_passed = check_baked_animation(&rng, bone_count, data.clip_duration);
+    bool graph_passed = check_animation_graph(&rng, bone_count, data.clip_duration);
+
+    return ((max_cursor_error == 0) && compression_passed && blending_passed && lod_passed && baked_passed && graph_passed) ? 0 : 1;
+}
@@ -0,0 +1,134 @@
+// Headless animation sampling benchmark: KMX track layout (sample_local_pose) vs SoaAnimationClip (sample_soa_clip)
+// "hot" samples one clip over and over so it stays in cache.
+// "cold" samples a different clip each time from a set bigger than the caches, so the cost is mostly cache misses.
+// Usage: animation_layout_bench [bone_count] [clip_count] [samples]
+
+#include "benchmark.h"
+#include "bench_skeleton.h"
+
+#include "../GameMaths.h"
+#include "../Animation.h"
+#include "../AnimationSoa.h"
+
+#include "../Animation.cpp"
+#include "../AnimationBlending.cpp"
+#include "../AnimationSoa.cpp"
+
+#define BENCH_CLIP_DURATION 2.0f
+#define BENCH_KEYS_PER_SECOND 30
+
+enum SampleMethod {
+    SAMPLE_KMX,
+    SAMPLE_KMX_CURSOR,
+    SAMPLE_SOA,
+};
+
+struct LayoutTestData {
+    uint32 clip_count;
+    KmxSkeleton** skeletons;
+    SoaAnimationClip* soa_clips;
+    KmxAnimationCursor* cursors;
+    LocalPose pose;
+};
+
+static void sample(const LayoutTestData& data, SampleMethod method, uint32 clip_index, float time, LocalPose* pose)
+{
+    switch(method){
+        case SAMPLE_KMX:        sample_local_pose(*data.skeletons[clip_index], 0, time, pose); break;
+        case SAMPLE_KMX_CURSOR: sample_local_pose(*data.skeletons[clip_index], 0, time, pose, &data.cursors[clip_index]); break;
+        case SAMPLE_SOA:        sample_soa_clip(data.soa_clips[clip_index], time, pose); break;
+    }
+}
+
+// Every clip advances by dt each pass, like a crowd of characters playing forwards
+static void bench_layout(const char* name, SampleMethod method, LayoutTestData* data, uint32 clips_used, uint32 samples)
+{
+    float dt = 1.0f / 60.0f;
+    uint32 passes = MAX(samples / clips_used, 1u);
+    double start = get_time_seconds();
+    for(uint32 pass = 0; pass < passes; ++pass)
+    {
+        float time = fmodf(pass * dt, BENCH_CLIP_DURATION);
+        for(uint32 c = 0; c < clips_used; ++c){
+            sample(*data, method, c, time, &data->pose);
+            benchmark_sink = data->pose.qw[c % data->pose.numBones];
+        }
+    }
+    double elapsed = get_time_seconds() - start;
+
+    double bones_sampled = (double)passes * clips_used * data->pose.numBones;
+    report_result(name, "ns_per_bone", elapsed * 1e9 / bones_sampled);
+}
+
+int main(int argc, char** argv)
+{
+    uint32 bone_count = get_arg_u32(argc, argv, 1, 64);
+    uint32 clip_count = get_arg_u32(argc, argv, 2, 256);
+    uint32 samples = get_arg_u32(argc, argv, 3, 200000);
+
+    uint32 num_keys = (uint32)(BENCH_CLIP_DURATION * BENCH_KEYS_PER_SECOND) + 1;
+
+    LayoutTestData data;
+    data.clip_count = clip_count;
+    data.skeletons = (KmxSkeleton**)malloc(clip_count * sizeof(KmxSkeleton*));
+    data.soa_clips = (SoaAnimationClip*)malloc(clip_count * sizeof(SoaAnimationClip));
+    data.cursors = (KmxAnimationCursor*)malloc(clip_count * sizeof(KmxAnimationCursor));
+    BenchRng rng = {0x12345678};
+    for(uint32 i = 0; i < clip_count; ++i){
+        data.skeletons[i] = make_bench_skeleton(&rng, bone_count, 1, num_keys, BENCH_CLIP_DURATION);
+        build_soa_clip(&data.soa_clips[i], *data.skeletons[i], 0, (float)BENCH_KEYS_PER_SECOND);
+        init_animation_cursor(&data.cursors[i], *data.skeletons[i]);
+    }
+    init_local_pose(&data.pose, bone_count);
+
+    uint32 kmx_bytes = bone_count * (sizeof(KmxBoneKeyFrames) + num_keys * (2*sizeof(float) + sizeof(vec3) + sizeof(versor)));
+    uint32 soa_bytes = data.soa_clips[0].numFrames * LOCAL_POSE_NUM_CHANNELS * data.soa_clips[0].stride * sizeof(float);
+
+    report_result("animation_layout/config", "bone_count", bone_count);
+    report_result("animation_layout/config", "keys_per_track", num_keys);
+    report_result("animation_layout/config", "clip_count", clip_count);
+    report_result("animation_layout/config", "simd_level", GAMEMATHS_SSE ? 1 : 0);
+    report_result("animation_layout/kmx", "bytes_per_clip", kmx_bytes);
+    report_result("animation_layout/soa", "bytes_per_clip", soa_bytes);
+    // Lower bound on cache lines one sample reads: a line of key times and a line of keys per track, vs 2 whole frames
+    report_result("animation_layout/kmx", "min_lines_per_sample", (double)bone_count * 2 * 2);
+    report_result("animation_layout/soa", "min_lines_per_sample", ceil(2.0 * soa_bytes / data.soa_clips[0].numFrames / 64));
+
+    bench_layout("animation_layout/hot/kmx", SAMPLE_KMX, &data, 1, samples);
+    bench_layout("animation_layout/hot/kmx_cursor", SAMPLE_KMX_CURSOR, &data, 1, samples);
+    bench_layout("animation_layout/hot/soa", SAMPLE_SOA, &data, 1, samples);
+    bench_layout("animation_layout/cold/kmx", SAMPLE_KMX, &data, clip_count, samples);
+    bench_layout("animation_layout/cold/kmx_cursor", SAMPLE_KMX_CURSOR, &data, clip_count, samples);
+    bench_layout("animation_layout/cold/soa", SAMPLE_SOA, &data, clip_count, samples);
+
+    //Validate resampled clips against the source keys, halfway between frames where nlerp vs slerp differs most
+    LocalPose reference;
+    init_local_pose(&reference, bone_count);
+    float max_translation_error = 0, max_rotation_error = 0;
+    for(uint32 i = 0; i < 4 * num_keys; ++i)
+    {
+        float time = MIN((i + 0.5f) / (4 * BENCH_KEYS_PER_SECOND), BENCH_CLIP_DURATION);
+        sample_local_pose(*data.skeletons[0], 0, time, &reference);
+        sample_soa_clip(data.soa_clips[0], time, &data.pose);
+        for(uint32 b = 0; b < bone_count; ++b){
+            max_translation_error = MAX(max_translation_error, fabsf(reference.tx[b] - data.pose.tx[b]));
+            max_translation_error = MAX(max_translation_error, fabsf(reference.ty[b] - data.pose.ty[b]));
+            max_translation_error = MAX(max_translation_error, fabsf(reference.tz[b] - data.pose.tz[b]));
+            //slerp() output isn't exactly unit length, so compare directions (in double, acos is too coarse near 1 in float)
+            double ref_q[4] = {reference.qw[b], reference.qx[b], reference.qy[b], reference.qz[b]};
+            double soa_q[4] = {data.pose.qw[b], data.pose.qx[b], data.pose.qy[b], data.pose.qz[b]};
+            double dot = 0, ref_len2 = 0, soa_len2 = 0;
+            for(int c = 0; c < 4; ++c){
+                dot += ref_q[c] * soa_q[c];
+                ref_len2 += ref_q[c] * ref_q[c];
+                soa_len2 += soa_q[c] * soa_q[c];
+            }
+            double cos_half_angle = MIN(fabs(dot) / sqrt(ref_len2 * soa_len2), 1.0);
+            max_rotation_error = MAX(max_rotation_error, (float)(2.0 * acos(cos_half_angle)));
+        }
+    }
+    report_result("animation_layout/soa_vs_kmx", "max_translation_error", max_translation_error);
+    report_result("animation_layout/soa_vs_kmx", "max_rotation_error_rad", max_rotation_error);
+
+    return (max_translation_error < 1e-4f && max_rotation_error < 1e-2f) ? 0 : 1;
+}
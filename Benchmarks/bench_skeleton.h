@@ -0,0 +1,103 @@
+#pragma once
+// Builds synthetic KmxSkeleton blobs (same layout as the exported .kmx files) for the animation benchmarks
+// Bones get a random earlier bone as parent, tracks are smooth sine curves keyed at even intervals
+
+#include <stddef.h> //offsetof
+#include <string.h>
+
+#include "benchmark.h"
+#include "../GameMaths.h"
+#include "../Animation.h"
+
+// Release with free()
+inline KmxSkeleton* make_bench_skeleton(BenchRng* rng, uint32 num_bones, uint32 num_animations, uint32 num_keys, float duration)
+{
+    assert(num_keys > 0);
+    uint32 header_size = offsetof(KmxSkeleton, data);
+    uint32 track_size = num_keys * (sizeof(float) + sizeof(vec3)) + num_keys * (sizeof(float) + sizeof(versor));
+    uint32 data_size = num_bones * sizeof(KmxBone)
+                     + num_animations * sizeof(KmxAnimation)
+                     + num_animations * num_bones * (sizeof(KmxBoneKeyFrames) + track_size);
+
+    KmxSkeleton* skeleton = (KmxSkeleton*)malloc(header_size + data_size);
+    skeleton->magic = 0;
+    skeleton->version = 1;
+    skeleton->numBones = num_bones;
+    skeleton->numAnimations = num_animations;
+
+    uint32 offset = 0;
+    skeleton->bonesOffset = offset;
+    KmxBone* bones = (KmxBone*)(&skeleton->data + offset);
+    offset += num_bones * sizeof(KmxBone);
+    for(uint32 i = 0; i < num_bones; ++i){
+        snprintf(bones[i].name, sizeof(bones[i].name), "bone_%u", i);
+        bones[i].parentIndex = (i == 0) ? -1 : (int32)(rand_u32(rng) % i);
+    }
+
+    skeleton->animationsOffset = offset;
+    KmxAnimation* animations = (KmxAnimation*)(&skeleton->data + offset);
+    offset += num_animations * sizeof(KmxAnimation);
+
+    for(uint32 a = 0; a < num_animations; ++a)
+    {
+        snprintf(animations[a].name, sizeof(animations[a].name), "anim_%u", a);
+        animations[a].duration = duration;
+        animations[a].keyFramesOffset = offset;
+        KmxBoneKeyFrames* keys = (KmxBoneKeyFrames*)(&skeleton->data + offset);
+        offset += num_bones * sizeof(KmxBoneKeyFrames);
+
+        for(uint32 b = 0; b < num_bones; ++b)
+        {
+            KmxBoneKeyFrames* bone_keys = &keys[b];
+            bone_keys->numTraKeys = num_keys;
+            bone_keys->numRotKeys = num_keys;
+            bone_keys->traKeyTimesOffset = offset; offset += num_keys * sizeof(float);
+            bone_keys->traKeysOffset     = offset; offset += num_keys * sizeof(vec3);
+            bone_keys->rotKeyTimesOffset = offset; offset += num_keys * sizeof(float);
+            bone_keys->rotKeysOffset     = offset; offset += num_keys * sizeof(versor);
+
+            float* tra_times = (float*)(&skeleton->data + bone_keys->traKeyTimesOffset);
+            vec3* tra_keys = (vec3*)(&skeleton->data + bone_keys->traKeysOffset);
+            float* rot_times = (float*)(&skeleton->data + bone_keys->rotKeyTimesOffset);
+            versor* rot_keys = (versor*)(&skeleton->data + bone_keys->rotKeysOffset);
+
+            vec3 base = {rand_float(rng, -1, 1), rand_float(rng, -1, 1), rand_float(rng, -1, 1)};
+            vec3 axis = normalise(vec3{rand_float(rng, -1, 1), rand_float(rng, -1, 1), rand_float(rng, -1, 1)});
+            float frequency = rand_float(rng, 1, 6);
+            float phase = rand_float(rng, 0, 2*PI32);
+            float amplitude = rand_float(rng, 10, 90);
+            for(uint32 k = 0; k < num_keys; ++k)
+            {
+                float t = (num_keys > 1) ? duration * k / (num_keys - 1) : 0.0f;
+                float s = sinf(frequency * t + phase);
+                tra_times[k] = t;
+                rot_times[k] = t;
+                tra_keys[k] = base + vec3{0.1f * s, 0.05f * s, 0};
+                rot_keys[k] = quat_from_axis_deg(amplitude * s, axis);
+            }
+        }
+    }
+    assert(offset == data_size);
+    return skeleton;
+}
+
+// A bench skeleton with identity inverse bind poses, for the checks that compare one animation path against another
+struct BenchSkeletonFixture {
+    KmxSkeleton* skeleton;
+    mat4* inverse_bind_poses;
+};
+
+inline void init_bench_skeleton_fixture(BenchSkeletonFixture* fixture, BenchRng* rng, uint32 num_bones, uint32 num_animations, uint32 num_keys, float duration)
+{
+    fixture->skeleton = make_bench_skeleton(rng, num_bones, num_animations, num_keys, duration);
+    fixture->inverse_bind_poses = (mat4*)malloc(num_bones * sizeof(mat4));
+    for(uint32 b = 0; b < num_bones; ++b)
+        fixture->inverse_bind_poses[b] = identity_mat4();
+}
+
+inline void free_bench_skeleton_fixture(BenchSkeletonFixture* fixture)
+{
+    free(fixture->skeleton);
+    free(fixture->inverse_bind_poses);
+    *fixture = {};
+}
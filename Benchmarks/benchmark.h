@@ -0,0 +1,68 @@
+#pragma once
+// Helpers shared by the headless benchmark programs in this folder (see Bench_* targets in Makefile)
+// Results are printed one per line as: <benchmark> <metric> <value>
+// so runs can be diffed/parsed across commits
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "../utils.h"
+
+inline double get_time_seconds()
+{
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+// CPU timestamp counter, or 0 where there isn't one. On modern x86 it ticks at a fixed rate rather than the
+// current clock speed, so cycle counts from it are approximate when the CPU is boosting or throttling
+inline uint64 read_cycle_counter()
+{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+inline void report_result(const char* benchmark, const char* metric, double value)
+{
+    printf("%-48s %-24s %.6g\n", benchmark, metric, value);
+}
+
+// Reads argv[index] as an unsigned int, or returns default_value if it isn't there
+inline uint32 get_arg_u32(int argc, char** argv, int index, uint32 default_value)
+{
+    if(index < argc) return (uint32)strtoul(argv[index], NULL, 10);
+    return default_value;
+}
+
+// Fixed-seed xorshift so every run benchmarks the same data on every machine
+struct BenchRng {
+    uint32 state;
+};
+
+inline uint32 rand_u32(BenchRng* rng)
+{
+    uint32 x = rng->state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    rng->state = x;
+    return x;
+}
+
+inline float rand_float(BenchRng* rng, float lo, float hi)
+{
+    return lo + (hi - lo) * ((rand_u32(rng) >> 8) * (1.0f / 16777216.0f));
+}
+
+// Stops the compiler optimising away work whose results are never used
+global_variable volatile float benchmark_sink;
@@ -0,0 +1,681 @@
+// Headless GameMaths.h benchmark and accuracy checks.
+// Times each primitive over arrays of random inputs (cycles and ns per op, ops per second), then checks
+// properties that must hold whatever the implementation: inverse(m) * m = I, quat_to_mat4 gives a rotation,
+// SIMD paths agree with the *_reference ones, fast_* trig, fast_inv_sqrtf and slerp_fast stay within their documented error.
+// Frustum tests never cull anything in view, and the batch intersection kernels give the same answers as the single value ones.
+// Exits with 1 if any check fails.
+// Usage: gamemaths_bench [iterations]
+
+#include <math.h>
+
+#include "benchmark.h"
+
+#include "../GameMaths.h"
+
+#define BENCH_INPUT_COUNT 1024 // inputs per op, small enough to stay in L1
+#define BENCH_WORLD_SIZE 50.0f // spheres, boxes and ray origins are in [-BENCH_WORLD_SIZE, BENCH_WORLD_SIZE]
+
+struct MathsTestData {
+    mat4* mats_a;       // random rotation, scale and translation
+    mat4* mats_b;
+    vec4* vecs;
+    vec3* points;
+    versor* quats_a;    // unit length
+    versor* quats_b;
+    float* t;           // [0, 1]
+    float* angles;      // [-PI, PI]
+    float* cosines;     // [-1, 1]
+
+    // Bounds scattered around a camera at the origin, about a third of them in view
+    mat4 view_proj;
+    frustum view_frustum;
+    sphere* spheres;
+    aabb* boxes;
+    ray* rays;
+    sphere_soa spheres_soa;
+    aabb_soa boxes_soa;
+};
+
+static vec3 random_unit_vec3(BenchRng* rng)
+{
+    return normalise(vec3{rand_float(rng, -1, 1), rand_float(rng, -1, 1), rand_float(rng, -1, 1)});
+}
+
+static mat4 random_affine_mat4(BenchRng* rng)
+{
+    vec3 axis = random_unit_vec3(rng);
+    vec3 pos = {rand_float(rng, -10, 10), rand_float(rng, -10, 10), rand_float(rng, -10, 10)};
+    vec3 scale = {rand_float(rng, 0.5f, 2), rand_float(rng, 0.5f, 2), rand_float(rng, 0.5f, 2)};
+    return translate(rotate_axis_deg_mat4(axis, rand_float(rng, -180, 180)) * scale_mat4(scale), pos);
+}
+
+static void make_test_data(MathsTestData* data, BenchRng* rng)
+{
+    data->mats_a = (mat4*)malloc(BENCH_INPUT_COUNT * sizeof(mat4));
+    data->mats_b = (mat4*)malloc(BENCH_INPUT_COUNT * sizeof(mat4));
+    data->vecs = (vec4*)malloc(BENCH_INPUT_COUNT * sizeof(vec4));
+    data->points = (vec3*)malloc(BENCH_INPUT_COUNT * sizeof(vec3));
+    data->quats_a = (versor*)malloc(BENCH_INPUT_COUNT * sizeof(versor));
+    data->quats_b = (versor*)malloc(BENCH_INPUT_COUNT * sizeof(versor));
+    data->t = (float*)malloc(BENCH_INPUT_COUNT * sizeof(float));
+    data->angles = (float*)malloc(BENCH_INPUT_COUNT * sizeof(float));
+    data->cosines = (float*)malloc(BENCH_INPUT_COUNT * sizeof(float));
+
+    for(uint32 i = 0; i < BENCH_INPUT_COUNT; ++i){
+        data->mats_a[i] = random_affine_mat4(rng);
+        data->mats_b[i] = random_affine_mat4(rng);
+        data->vecs[i] = vec4{rand_float(rng, -10, 10), rand_float(rng, -10, 10), rand_float(rng, -10, 10), 1};
+        data->points[i] = vec3{rand_float(rng, -10, 10), rand_float(rng, -10, 10), rand_float(rng, -10, 10)};
+        data->quats_a[i] = quat_from_axis_deg(rand_float(rng, -180, 180), random_unit_vec3(rng));
+        //Mix of small and large angles between pairs so slerp takes both of its paths
+        float max_angle = (i % 2) ? 10.0f : 180.0f;
+        data->quats_b[i] = quat_from_axis_deg(rand_float(rng, -max_angle, max_angle), random_unit_vec3(rng)) * data->quats_a[i];
+        data->t[i] = rand_float(rng, 0, 1);
+        data->angles[i] = rand_float(rng, -PI32, PI32);
+        data->cosines[i] = rand_float(rng, -1, 1);
+    }
+
+    data->view_proj = perspective(90.0f, 16.0f / 9.0f, 0.1f, BENCH_WORLD_SIZE) * look_at(vec3{0, 0, 0}, vec3{0, 0, -1}, vec3{0, 1, 0});
+    data->view_frustum = frustum_from_matrix(data->view_proj);
+    data->spheres = (sphere*)malloc(BENCH_INPUT_COUNT * sizeof(sphere));
+    data->boxes = (aabb*)malloc(BENCH_INPUT_COUNT * sizeof(aabb));
+    data->rays = (ray*)malloc(BENCH_INPUT_COUNT * sizeof(ray));
+    float* soa = (float*)malloc(10 * BENCH_INPUT_COUNT * sizeof(float));
+    data->spheres_soa = {soa, soa + BENCH_INPUT_COUNT, soa + 2*BENCH_INPUT_COUNT, soa + 3*BENCH_INPUT_COUNT};
+    data->boxes_soa = {soa + 4*BENCH_INPUT_COUNT, soa + 5*BENCH_INPUT_COUNT, soa + 6*BENCH_INPUT_COUNT,
+                       soa + 7*BENCH_INPUT_COUNT, soa + 8*BENCH_INPUT_COUNT, soa + 9*BENCH_INPUT_COUNT};
+    for(uint32 i = 0; i < BENCH_INPUT_COUNT; ++i){
+        vec3 centre = {rand_float(rng, -BENCH_WORLD_SIZE, BENCH_WORLD_SIZE), rand_float(rng, -BENCH_WORLD_SIZE, BENCH_WORLD_SIZE),
+                       rand_float(rng, -BENCH_WORLD_SIZE, BENCH_WORLD_SIZE)};
+        vec3 extent = {rand_float(rng, 0.1f, 3), rand_float(rng, 0.1f, 3), rand_float(rng, 0.1f, 3)};
+        data->spheres[i] = sphere{centre, rand_float(rng, 0.1f, 3)};
+        data->boxes[i] = aabb{centre - extent, centre + extent};
+        //Half the rays aimed at a box so there are plenty of hits
+        vec3 origin = {rand_float(rng, -BENCH_WORLD_SIZE, BENCH_WORLD_SIZE), rand_float(rng, -BENCH_WORLD_SIZE, BENCH_WORLD_SIZE),
+                       rand_float(rng, -BENCH_WORLD_SIZE, BENCH_WORLD_SIZE)};
+        data->rays[i] = ray{origin, (i % 2) ? random_unit_vec3(rng) : centre - origin};
+
+        data->spheres_soa.x[i] = centre.x;
+        data->spheres_soa.y[i] = centre.y;
+        data->spheres_soa.z[i] = centre.z;
+        data->spheres_soa.radius[i] = data->spheres[i].radius;
+        data->boxes_soa.min_x[i] = data->boxes[i].min.x;
+        data->boxes_soa.min_y[i] = data->boxes[i].min.y;
+        data->boxes_soa.min_z[i] = data->boxes[i].min.z;
+        data->boxes_soa.max_x[i] = data->boxes[i].max.x;
+        data->boxes_soa.max_y[i] = data->boxes[i].max.y;
+        data->boxes_soa.max_z[i] = data->boxes[i].max.z;
+    }
+}
+
+//------------------------------------------------------------------------------
+// Timing
+//------------------------------------------------------------------------------
+static void report_ops(const char* name, double elapsed, uint64 cycles, double ops)
+{
+    if(cycles) report_result(name, "cycles_per_op", cycles / ops);
+    report_result(name, "ns_per_op", elapsed * 1e9 / ops);
+    report_result(name, "ops_per_sec", ops / elapsed);
+}
+
+// Runs body for every i in [0, BENCH_INPUT_COUNT), iterations times. body adds something from its
+// result to sum so the work can't be optimised away
+#define BENCH_OPS(name, body) \
+    do { \
+        double start = get_time_seconds(); \
+        uint64 start_cycles = read_cycle_counter(); \
+        for(uint32 iteration = 0; iteration < iterations; ++iteration){ \
+            float sum = 0; \
+            for(uint32 i = 0; i < BENCH_INPUT_COUNT; ++i){ body; } \
+            benchmark_sink = sum; \
+        } \
+        uint64 cycles = read_cycle_counter() - start_cycles; \
+        report_ops(name, get_time_seconds() - start, cycles, (double)iterations * BENCH_INPUT_COUNT); \
+    } while(0)
+
+static void bench_matrices(const MathsTestData& d, uint32 iterations)
+{
+    BENCH_OPS("gamemaths/mat4_mul", sum += (d.mats_a[i] * d.mats_b[i]).m[i & 15]);
+    BENCH_OPS("gamemaths/mat4_mul_reference", sum += mat4_mul_reference(d.mats_a[i], d.mats_b[i]).m[i & 15]);
+    BENCH_OPS("gamemaths/mat4_mul_vec4", sum += (d.mats_a[i] * d.vecs[i]).v[i & 3]);
+    BENCH_OPS("gamemaths/mat4_mul_vec4_reference", sum += mat4_mul_vec4_reference(d.mats_a[i], d.vecs[i]).v[i & 3]);
+    BENCH_OPS("gamemaths/inverse", sum += inverse(d.mats_a[i]).m[i & 15]);
+    BENCH_OPS("gamemaths/inverse_reference", sum += inverse_reference(d.mats_a[i]).m[i & 15]);
+    BENCH_OPS("gamemaths/affine_inverse", sum += affine_inverse(mat4_to_mat3x4(d.mats_a[i])).m[i % 12]);
+    BENCH_OPS("gamemaths/look_at", sum += look_at(d.points[i], d.points[(i + 1) % BENCH_INPUT_COUNT], vec3{0, 1, 0}).m[i & 15]);
+    BENCH_OPS("gamemaths/perspective", sum += perspective(60.0f + d.t[i], 16.0f / 9.0f, 0.1f, 300.0f).m[i & 15]);
+}
+
+static void bench_quaternions(const MathsTestData& d, uint32 iterations)
+{
+    BENCH_OPS("gamemaths/quat_to_mat4", sum += quat_to_mat4(d.quats_a[i]).m[i & 15]);
+    BENCH_OPS("gamemaths/mat4_to_quat", sum += mat4_to_quat(d.mats_a[i]).q[i & 3]);
+    BENCH_OPS("gamemaths/quat_mul", sum += (d.quats_a[i] * d.quats_b[i]).q[i & 3]);
+    BENCH_OPS("gamemaths/quat_rotate", sum += quat_rotate(d.quats_a[i], d.points[i]).v[i % 3]);
+    BENCH_OPS("gamemaths/slerp", versor q = d.quats_a[i]; sum += slerp(q, d.quats_b[i], d.t[i]).q[i & 3]);
+    BENCH_OPS("gamemaths/slerp_fast", sum += slerp_fast(d.quats_a[i], d.quats_b[i], d.t[i]).q[i & 3]);
+
+    //Batch version over the same pairs, per quaternion
+    float* soa = (float*)malloc(12 * BENCH_INPUT_COUNT * sizeof(float));
+    versor_soa a = {soa, soa + BENCH_INPUT_COUNT, soa + 2*BENCH_INPUT_COUNT, soa + 3*BENCH_INPUT_COUNT};
+    versor_soa b = {soa + 4*BENCH_INPUT_COUNT, soa + 5*BENCH_INPUT_COUNT, soa + 6*BENCH_INPUT_COUNT, soa + 7*BENCH_INPUT_COUNT};
+    versor_soa out = {soa + 8*BENCH_INPUT_COUNT, soa + 9*BENCH_INPUT_COUNT, soa + 10*BENCH_INPUT_COUNT, soa + 11*BENCH_INPUT_COUNT};
+    for(uint32 i = 0; i < BENCH_INPUT_COUNT; ++i){
+        a.w[i] = d.quats_a[i].q[0]; a.x[i] = d.quats_a[i].q[1]; a.y[i] = d.quats_a[i].q[2]; a.z[i] = d.quats_a[i].q[3];
+        b.w[i] = d.quats_b[i].q[0]; b.x[i] = d.quats_b[i].q[1]; b.y[i] = d.quats_b[i].q[2]; b.z[i] = d.quats_b[i].q[3];
+    }
+    double start = get_time_seconds();
+    uint64 start_cycles = read_cycle_counter();
+    for(uint32 iteration = 0; iteration < iterations; ++iteration){
+        slerp_batch(a, b, d.t, out, BENCH_INPUT_COUNT);
+        benchmark_sink = out.w[iteration % BENCH_INPUT_COUNT];
+    }
+    uint64 cycles = read_cycle_counter() - start_cycles;
+    report_ops("gamemaths/slerp_batch", get_time_seconds() - start, cycles, (double)iterations * BENCH_INPUT_COUNT);
+    free(soa);
+}
+
+static void bench_trig(const MathsTestData& d, uint32 iterations)
+{
+    BENCH_OPS("gamemaths/sinf", sum += sinf(d.angles[i]));
+    BENCH_OPS("gamemaths/fast_sinf", sum += fast_sinf(d.angles[i]));
+    BENCH_OPS("gamemaths/acosf", sum += acosf(d.cosines[i]));
+    BENCH_OPS("gamemaths/fast_acosf", sum += fast_acosf(d.cosines[i]));
+}
+
+static void bench_normalise(const MathsTestData& d, uint32 iterations)
+{
+    BENCH_OPS("gamemaths/inv_sqrt_libm", sum += 1.0f / sqrtf(length2(d.points[i])));
+    BENCH_OPS("gamemaths/fast_inv_sqrtf", sum += fast_inv_sqrtf(length2(d.points[i])));
+    BENCH_OPS("gamemaths/normalise_vec3", sum += normalise(d.points[i]).v[i % 3]);
+    BENCH_OPS("gamemaths/normalise_versor", sum += normalise(d.quats_a[i] * 1.001f).q[i & 3]);
+
+    float* soa = (float*)malloc(3 * BENCH_INPUT_COUNT * sizeof(float));
+    float* x = soa;
+    float* y = soa + BENCH_INPUT_COUNT;
+    float* z = soa + 2*BENCH_INPUT_COUNT;
+    for(uint32 i = 0; i < BENCH_INPUT_COUNT; ++i){
+        x[i] = d.points[i].x; y[i] = d.points[i].y; z[i] = d.points[i].z;
+    }
+    //In place, so after the first iteration it's normalising unit vectors. Costs the same
+    double start = get_time_seconds();
+    uint64 start_cycles = read_cycle_counter();
+    for(uint32 iteration = 0; iteration < iterations; ++iteration){
+        normalise_soa(x, y, z, x, y, z, BENCH_INPUT_COUNT);
+        benchmark_sink = x[iteration % BENCH_INPUT_COUNT];
+    }
+    uint64 cycles = read_cycle_counter() - start_cycles;
+    report_ops("gamemaths/normalise_soa", get_time_seconds() - start, cycles, (double)iterations * BENCH_INPUT_COUNT);
+    free(soa);
+}
+
+static void bench_batches(const MathsTestData& d, uint32 iterations)
+{
+    vec3* out = (vec3*)malloc(BENCH_INPUT_COUNT * sizeof(vec3));
+    double start = get_time_seconds();
+    uint64 start_cycles = read_cycle_counter();
+    for(uint32 iteration = 0; iteration < iterations; ++iteration){
+        transform_points(d.mats_a[iteration % BENCH_INPUT_COUNT], d.points, out, BENCH_INPUT_COUNT);
+        benchmark_sink = out[iteration % BENCH_INPUT_COUNT].x;
+    }
+    uint64 cycles = read_cycle_counter() - start_cycles;
+    report_ops("gamemaths/transform_points", get_time_seconds() - start, cycles, (double)iterations * BENCH_INPUT_COUNT);
+    free(out);
+
+    BENCH_OPS("gamemaths/transform_point_loop", sum += (d.mats_a[iteration % BENCH_INPUT_COUNT] * vec4{d.points[i].x, d.points[i].y, d.points[i].z, 1}).v[i % 3]);
+}
+
+// Batch kernels are timed over all BENCH_INPUT_COUNT objects per iteration, reported per object
+#define BENCH_BATCH(name, call, sink) \
+    do { \
+        double start = get_time_seconds(); \
+        uint64 start_cycles = read_cycle_counter(); \
+        for(uint32 iteration = 0; iteration < iterations; ++iteration){ \
+            call; \
+            benchmark_sink = (float)(sink); \
+        } \
+        uint64 cycles = read_cycle_counter() - start_cycles; \
+        report_ops(name, get_time_seconds() - start, cycles, (double)iterations * BENCH_INPUT_COUNT); \
+    } while(0)
+
+static void bench_geometry(const MathsTestData& d, uint32 iterations)
+{
+    bool* hits = (bool*)malloc(BENCH_INPUT_COUNT * sizeof(bool));
+    float* t = (float*)malloc(BENCH_INPUT_COUNT * sizeof(float));
+    const ray& r = d.rays[0];
+
+    BENCH_OPS("gamemaths/frustum_from_matrix", sum += frustum_from_matrix(d.mats_a[i]).planes[i % FRUSTUM_NUM_PLANES].d);
+    BENCH_OPS("gamemaths/sphere_in_frustum", sum += sphere_in_frustum(d.view_frustum, d.spheres[i]));
+    BENCH_BATCH("gamemaths/spheres_in_frustum", spheres_in_frustum(d.view_frustum, d.spheres_soa, hits, BENCH_INPUT_COUNT), hits[iteration % BENCH_INPUT_COUNT]);
+    BENCH_OPS("gamemaths/aabb_in_frustum", sum += aabb_in_frustum(d.view_frustum, d.boxes[i]));
+    BENCH_BATCH("gamemaths/aabbs_in_frustum", aabbs_in_frustum(d.view_frustum, d.boxes_soa, hits, BENCH_INPUT_COUNT), hits[iteration % BENCH_INPUT_COUNT]);
+    BENCH_OPS("gamemaths/aabbs_overlap", sum += aabbs_overlap(d.boxes[iteration % BENCH_INPUT_COUNT], d.boxes[i]));
+    BENCH_BATCH("gamemaths/aabbs_overlap_batch", aabbs_overlap_batch(d.boxes[iteration % BENCH_INPUT_COUNT], d.boxes_soa, hits, BENCH_INPUT_COUNT),
+                hits[iteration % BENCH_INPUT_COUNT]);
+    BENCH_OPS("gamemaths/ray_hits_aabb", sum += MIN(ray_hits_aabb(r, d.boxes[i]), 1.0f));
+    BENCH_BATCH("gamemaths/ray_hits_aabbs", ray_hits_aabbs(r, d.boxes_soa, t, BENCH_INPUT_COUNT), t[iteration % BENCH_INPUT_COUNT]);
+
+    free(t);
+    free(hits);
+}
+
+//------------------------------------------------------------------------------
+// Accuracy checks
+//------------------------------------------------------------------------------
+static bool check(const char* name, const char* metric, float error, float max_error)
+{
+    report_result(name, metric, error);
+    if(error <= max_error) return true;
+    fprintf(stderr, "ERROR: %s %s is %g, should be at most %g\n", name, metric, error, max_error);
+    return false;
+}
+
+static float max_abs_diff(const float* a, const float* b, int n)
+{
+    float result = 0;
+    for(int i = 0; i < n; ++i)
+        result = MAX(result, fabsf(a[i] - b[i]));
+    return result;
+}
+
+// Angle of the rotation between two unit quaternions, q and -q counting as the same.
+// From |a - b| = 2 sin(angle / 4) rather than acos(dot(a, b)), which loses most of its precision near 0
+static float rotation_error_rad(versor a, versor b)
+{
+    versor diff = {a.q[0] - b.q[0], a.q[1] - b.q[1], a.q[2] - b.q[2], a.q[3] - b.q[3]};
+    versor sum = {a.q[0] + b.q[0], a.q[1] + b.q[1], a.q[2] + b.q[2], a.q[3] + b.q[3]};
+    float chord = sqrtf(MIN(dot(diff, diff), dot(sum, sum)));
+    return 4.0f * asinf(MIN(0.5f * chord, 1.0f));
+}
+
+// slerp in double precision, as the reference for slerp_fast() and slerp_batch(). slerp() itself is float
+// all the way through, so near cos = 1 its sqrtf(1 - cos^2) and acos lose more precision than the
+// approximations being checked, by different amounts depending on whether the compiler fuses the multiply-adds
+static versor slerp_reference(versor q, versor r, float t)
+{
+    double cos_half_theta = 0;
+    for(int i = 0; i < 4; ++i)
+        cos_half_theta += (double)q.q[i] * r.q[i];
+    double sign = cos_half_theta < 0 ? -1.0 : 1.0;
+    cos_half_theta = MIN(fabs(cos_half_theta), 1.0);
+    double half_theta = acos(cos_half_theta);
+    double a = 1.0 - t, b = t;
+    if(half_theta > 1e-9) {
+        a = sin((1.0 - t) * half_theta) / sin(half_theta);
+        b = sin(t * half_theta) / sin(half_theta);
+    }
+    double result[4], length_sq = 0;
+    for(int i = 0; i < 4; ++i) {
+        result[i] = sign * q.q[i] * a + r.q[i] * b;
+        length_sq += result[i] * result[i];
+    }
+    double inv_length = 1.0 / sqrt(length_sq);
+    return versor{(float)(result[0] * inv_length), (float)(result[1] * inv_length), (float)(result[2] * inv_length), (float)(result[3] * inv_length)};
+}
+
+static bool check_matrices(const MathsTestData& d)
+{
+    mat4 identity = identity_mat4();
+    float mul_error = 0, mul_vec4_error = 0, inverse_error = 0, inverse_identity_error = 0, affine_inverse_error = 0;
+    for(uint32 i = 0; i < BENCH_INPUT_COUNT; ++i){
+        mul_error = MAX(mul_error, max_abs_diff((d.mats_a[i] * d.mats_b[i]).m, mat4_mul_reference(d.mats_a[i], d.mats_b[i]).m, 16));
+        mul_vec4_error = MAX(mul_vec4_error, max_abs_diff((d.mats_a[i] * d.vecs[i]).v, mat4_mul_vec4_reference(d.mats_a[i], d.vecs[i]).v, 4));
+        mat4 inv = inverse(d.mats_a[i]);
+        inverse_error = MAX(inverse_error, max_abs_diff(inv.m, inverse_reference(d.mats_a[i]).m, 16));
+        inverse_identity_error = MAX(inverse_identity_error, max_abs_diff((inv * d.mats_a[i]).m, identity.m, 16));
+        mat3x4 affine = mat4_to_mat3x4(d.mats_a[i]);
+        affine_inverse_error = MAX(affine_inverse_error, max_abs_diff((affine_inverse(affine) * affine).m, identity_mat3x4().m, 12));
+    }
+
+    //look_at: a rotation and translation that puts the camera at the origin looking down -z.
+    //The camera ending up at the origin is checked on its own, including one well away from it, since
+    //look_at() used to only be right for a camera at the origin
+    float look_at_error = 0, look_at_origin_error = 0;
+    for(uint32 i = 0; i <= BENCH_INPUT_COUNT; ++i){
+        vec3 eye = (i < BENCH_INPUT_COUNT) ? d.points[i] : vec3{40, 12, -75};
+        vec3 target = d.points[(i + 1) % BENCH_INPUT_COUNT];
+        mat4 V = look_at(eye, target, vec3{0, 1, 0});
+        vec4 eye_view = V * vec4{eye.x, eye.y, eye.z, 1};
+        vec4 target_view = V * vec4{target.x, target.y, target.z, 1};
+        float dist = length(target - eye);
+        look_at_origin_error = MAX(look_at_origin_error, length(vec3{eye_view.x, eye_view.y, eye_view.z}));
+        float errors[] = {target_view.x / dist, target_view.y / dist, target_view.z / dist + 1.0f, determinant(V) - 1.0f};
+        for(uint32 j = 0; j < ARRAY_COUNT(errors); ++j)
+            look_at_error = MAX(look_at_error, fabsf(errors[j]));
+    }
+
+    //perspective: the near and far planes go to -1 and 1 in NDC
+    float perspective_error = 0;
+    {
+        float near_z = 0.1f, far_z = 300.0f;
+        mat4 P = perspective(90.0f, 16.0f / 9.0f, near_z, far_z);
+        vec4 n = P * vec4{0, 0, -near_z, 1};
+        vec4 f = P * vec4{0, 0, -far_z, 1};
+        perspective_error = MAX(fabsf(n.z / n.w + 1.0f), fabsf(f.z / f.w - 1.0f));
+    }
+
+    bool passed = true;
+    passed &= check("gamemaths/mat4_mul_vs_reference", "max_error", mul_error, 1e-4f);
+    passed &= check("gamemaths/mat4_mul_vec4_vs_reference", "max_error", mul_vec4_error, 1e-4f);
+    passed &= check("gamemaths/inverse_vs_reference", "max_error", inverse_error, 1e-4f);
+    passed &= check("gamemaths/inverse_times_m", "max_identity_error", inverse_identity_error, 1e-4f);
+    passed &= check("gamemaths/affine_inverse_times_m", "max_identity_error", affine_inverse_error, 1e-4f);
+    passed &= check("gamemaths/look_at", "max_error", look_at_error, 1e-4f);
+    passed &= check("gamemaths/look_at", "max_camera_to_origin_error", look_at_origin_error, 1e-4f);
+    passed &= check("gamemaths/perspective", "max_ndc_depth_error", perspective_error, 1e-4f);
+    return passed;
+}
+
+static bool check_quaternions(const MathsTestData& d)
+{
+    //quat_to_mat4 of a unit quaternion is a rotation: orthonormal columns, determinant 1, no translation
+    float orthonormal_error = 0, determinant_error = 0, round_trip_error = 0;
+    for(uint32 i = 0; i < BENCH_INPUT_COUNT; ++i){
+        mat4 R = quat_to_mat4(d.quats_a[i]);
+        mat4 RtR = transpose(R) * R;
+        orthonormal_error = MAX(orthonormal_error, max_abs_diff(RtR.m, identity_mat4().m, 16));
+        determinant_error = MAX(determinant_error, fabsf(determinant(R) - 1.0f));
+        round_trip_error = MAX(round_trip_error, rotation_error_rad(mat4_to_quat(R), d.quats_a[i]));
+    }
+
+    //Interpolation: against a double precision slerp, and slerp()'s endpoints
+    float slerp_fast_error = 0, slerp_batch_error = 0, nlerp_batch_unit_error = 0, endpoint_error = 0;
+    float* soa = (float*)malloc(12 * BENCH_INPUT_COUNT * sizeof(float));
+    versor_soa a = {soa, soa + BENCH_INPUT_COUNT, soa + 2*BENCH_INPUT_COUNT, soa + 3*BENCH_INPUT_COUNT};
+    versor_soa b = {soa + 4*BENCH_INPUT_COUNT, soa + 5*BENCH_INPUT_COUNT, soa + 6*BENCH_INPUT_COUNT, soa + 7*BENCH_INPUT_COUNT};
+    versor_soa out = {soa + 8*BENCH_INPUT_COUNT, soa + 9*BENCH_INPUT_COUNT, soa + 10*BENCH_INPUT_COUNT, soa + 11*BENCH_INPUT_COUNT};
+    for(uint32 i = 0; i < BENCH_INPUT_COUNT; ++i){
+        a.w[i] = d.quats_a[i].q[0]; a.x[i] = d.quats_a[i].q[1]; a.y[i] = d.quats_a[i].q[2]; a.z[i] = d.quats_a[i].q[3];
+        b.w[i] = d.quats_b[i].q[0]; b.x[i] = d.quats_b[i].q[1]; b.y[i] = d.quats_b[i].q[2]; b.z[i] = d.quats_b[i].q[3];
+    }
+    slerp_batch(a, b, d.t, out, BENCH_INPUT_COUNT);
+    for(uint32 i = 0; i < BENCH_INPUT_COUNT; ++i){
+        versor q = d.quats_a[i], r = d.quats_b[i];
+        versor reference = slerp_reference(q, r, d.t[i]);
+        versor batch = {out.w[i], out.x[i], out.y[i], out.z[i]};
+        slerp_fast_error = MAX(slerp_fast_error, rotation_error_rad(slerp_fast(d.quats_a[i], d.quats_b[i], d.t[i]), reference));
+        slerp_batch_error = MAX(slerp_batch_error, rotation_error_rad(batch, reference));
+
+        q = d.quats_a[i];
+        endpoint_error = MAX(endpoint_error, rotation_error_rad(slerp(q, r, 0.0f), d.quats_a[i]));
+        q = d.quats_a[i];
+        endpoint_error = MAX(endpoint_error, rotation_error_rad(slerp(q, r, 1.0f), d.quats_b[i]));
+    }
+    nlerp_batch(a, b, d.t, out, BENCH_INPUT_COUNT);
+    for(uint32 i = 0; i < BENCH_INPUT_COUNT; ++i){
+        float length_sq = out.w[i]*out.w[i] + out.x[i]*out.x[i] + out.y[i]*out.y[i] + out.z[i]*out.z[i];
+        nlerp_batch_unit_error = MAX(nlerp_batch_unit_error, fabsf(length_sq - 1.0f));
+    }
+    //Fewer than 4 pairs all go through the scalar tail, which must give what the SIMD lanes gave
+    float tail_w[3], tail_x[3], tail_y[3], tail_z[3];
+    versor_soa tail = {tail_w, tail_x, tail_y, tail_z};
+    nlerp_batch(a, b, d.t, tail, 3);
+    float nlerp_tail_error = 0;
+    for(uint32 i = 0; i < 3; ++i){
+        versor lane = {out.w[i], out.x[i], out.y[i], out.z[i]};
+        versor scalar = {tail.w[i], tail.x[i], tail.y[i], tail.z[i]};
+        nlerp_tail_error = MAX(nlerp_tail_error, max_abs_diff(lane.q, scalar.q, 4));
+    }
+    free(soa);
+
+    bool passed = true;
+    passed &= check("gamemaths/quat_to_mat4", "max_orthonormal_error", orthonormal_error, 1e-5f);
+    passed &= check("gamemaths/quat_to_mat4", "max_determinant_error", determinant_error, 1e-5f);
+    passed &= check("gamemaths/mat4_to_quat_round_trip", "max_error_rad", round_trip_error, 1e-3f);
+    passed &= check("gamemaths/slerp", "max_endpoint_error_rad", endpoint_error, 1e-3f);
+    passed &= check("gamemaths/slerp_fast_vs_slerp", "max_error_rad", slerp_fast_error, 2e-4f);
+    passed &= check("gamemaths/slerp_batch_vs_slerp", "max_error_rad", slerp_batch_error, 2e-4f);
+    passed &= check("gamemaths/nlerp_batch", "max_unit_length_error", nlerp_batch_unit_error, 1e-5f);
+    passed &= check("gamemaths/nlerp_batch_tail_vs_lanes", "max_error", nlerp_tail_error, 1e-6f);
+    return passed;
+}
+
+static bool check_trig()
+{
+    //Against double precision libm over the ranges documented in GameMaths.h
+    const uint32 count = 1000000;
+    float sin_error = 0, cos_error = 0, acos_error = 0, array_error = 0;
+    for(uint32 i = 0; i <= count; ++i){
+        float x = -1000.0f + 2000.0f * i / count;
+        sin_error = MAX(sin_error, (float)fabs(fast_sinf(x) - sin((double)x)));
+        cos_error = MAX(cos_error, (float)fabs(fast_cosf(x) - cos((double)x)));
+        float c = -1.0f + 2.0f * i / count;
+        acos_error = MAX(acos_error, (float)fabs(fast_acosf(c) - acos((double)c)));
+    }
+
+    //SIMD array version must match the scalar one
+    float x[BENCH_INPUT_COUNT], s[BENCH_INPUT_COUNT], c[BENCH_INPUT_COUNT];
+    for(uint32 i = 0; i < BENCH_INPUT_COUNT; ++i)
+        x[i] = -100.0f + 200.0f * i / BENCH_INPUT_COUNT;
+    fast_sin_cos_array(x, s, c, BENCH_INPUT_COUNT);
+    for(uint32 i = 0; i < BENCH_INPUT_COUNT; ++i)
+        array_error = MAX(array_error, MAX(fabsf(s[i] - fast_sinf(x[i])), fabsf(c[i] - fast_cosf(x[i]))));
+
+    bool passed = true;
+    passed &= check("gamemaths/fast_sinf_vs_libm", "max_error", sin_error, 5e-7f);
+    passed &= check("gamemaths/fast_cosf_vs_libm", "max_error", cos_error, 5e-7f);
+    passed &= check("gamemaths/fast_acosf_vs_libm", "max_error", acos_error, 1e-6f);
+    passed &= check("gamemaths/fast_sin_cos_array_vs_scalar", "max_error", array_error, 1e-6f);
+    return passed;
+}
+
+static bool check_batches(const MathsTestData& d)
+{
+    vec3* out = (vec3*)malloc(BENCH_INPUT_COUNT * sizeof(vec3));
+    float* soa = (float*)malloc(6 * BENCH_INPUT_COUNT * sizeof(float));
+    float* x = soa;
+    float* y = soa + BENCH_INPUT_COUNT;
+    float* z = soa + 2*BENCH_INPUT_COUNT;
+    for(uint32 i = 0; i < BENCH_INPUT_COUNT; ++i){
+        x[i] = d.points[i].x; y[i] = d.points[i].y; z[i] = d.points[i].z;
+    }
+
+    const mat4& m = d.mats_a[0];
+    transform_points(m, d.points, out, BENCH_INPUT_COUNT);
+    transform_points_soa(m, x, y, z, soa + 3*BENCH_INPUT_COUNT, soa + 4*BENCH_INPUT_COUNT, soa + 5*BENCH_INPUT_COUNT, BENCH_INPUT_COUNT);
+    float points_error = 0, soa_error = 0;
+    for(uint32 i = 0; i < BENCH_INPUT_COUNT; ++i){
+        vec4 reference = mat4_mul_vec4_reference(m, vec4{d.points[i].x, d.points[i].y, d.points[i].z, 1});
+        vec3 soa_point = {soa[3*BENCH_INPUT_COUNT + i], soa[4*BENCH_INPUT_COUNT + i], soa[5*BENCH_INPUT_COUNT + i]};
+        points_error = MAX(points_error, max_abs_diff(out[i].v, reference.v, 3));
+        soa_error = MAX(soa_error, max_abs_diff(soa_point.v, reference.v, 3));
+    }
+    free(soa);
+    free(out);
+
+    bool passed = true;
+    passed &= check("gamemaths/transform_points_vs_reference", "max_error", points_error, 1e-4f);
+    passed &= check("gamemaths/transform_points_soa_vs_reference", "max_error", soa_error, 1e-4f);
+    return passed;
+}
+
+static vec3 batch_normalise_input(const MathsTestData& d, uint32 i)
+{
+    if(i == 0) return vec3{0, 0, 0};
+    if(i == 1) return vec3{1e-20f, 0, 0};
+    if(i == 2) return vec3{2e19f, 0, 0};
+    return d.points[i];
+}
+
+static versor batch_normalise_input_q(const MathsTestData& d, uint32 i)
+{
+    if(i == 0) return versor{0, 0, 0, 0};
+    if(i == 1) return versor{1e-20f, 0, 0, 0};
+    if(i == 2) return versor{2e19f, 0, 0, 0};
+    return d.quats_a[i] * (0.5f + d.t[i]);
+}
+
+static bool check_normalise(const MathsTestData& d)
+{
+    //Relative error against double precision over a wide range of magnitudes
+    float inv_sqrt_error = 0;
+    for(float x = 1e-6f; x < 1e6f; x *= 1.0001f)
+        inv_sqrt_error = MAX(inv_sqrt_error, (float)fabs(fast_inv_sqrtf(x) * sqrt((double)x) - 1.0));
+
+    //Quaternions well away from unit length must come back unit length, zero must stay zero
+    float versor_unit_error = 0;
+    for(uint32 i = 0; i < BENCH_INPUT_COUNT; ++i){
+        versor q = normalise(d.quats_a[i] * d.t[i] * 4.0f + versor{1e-3f, 0, 0, 0});
+        versor_unit_error = MAX(versor_unit_error, fabsf(sqrtf(dot(q, q)) - 1.0f));
+    }
+    versor zero_versor = normalise(versor{0, 0, 0, 0});
+    float zero_error = fabsf(zero_versor.q[0]) + fabsf(zero_versor.q[1]) + fabsf(zero_versor.q[2]) + fabsf(zero_versor.q[3]);
+    zero_error += length(normalise(vec3{0, 0, 0}));
+
+    //Lengths fast_inv_sqrtf() can't take: a denormal length2 must still come out unit length, and one that
+    //overflows to inf must give zero, not NaN. Summed rather than MAX'd so a NaN shows up. The tiny ones are
+    //only good to about 8e-6: length2 = 1e-40 is a denormal with 17 bits of precision left
+    vec2 tiny_2 = normalise(vec2{1e-20f, 0}), huge_2 = normalise(vec2{2e19f, 0});
+    vec3 tiny_3 = normalise(vec3{1e-20f, 0, 0}), huge_3 = normalise(vec3{2e19f, 0, 0});
+    versor tiny_q = normalise(versor{1e-20f, 0, 0, 0}), huge_q = normalise(versor{2e19f, 0, 0, 0});
+    float extreme_error = fabsf(tiny_2.x - 1.0f) + fabsf(tiny_2.y) + fabsf(huge_2.x) + fabsf(huge_2.y);
+    extreme_error += fabsf(tiny_3.x - 1.0f) + fabsf(tiny_3.y) + fabsf(tiny_3.z);
+    extreme_error += fabsf(huge_3.x) + fabsf(huge_3.y) + fabsf(huge_3.z);
+    extreme_error += fabsf(tiny_q.q[0] - 1.0f) + fabsf(tiny_q.q[1]) + fabsf(tiny_q.q[2]) + fabsf(tiny_q.q[3]);
+    extreme_error += fabsf(huge_q.q[0]) + fabsf(huge_q.q[1]) + fabsf(huge_q.q[2]) + fabsf(huge_q.q[3]);
+
+    //Batch versions must match normalise(), the first vector is zero to check the masking
+    //and the next two are tiny and huge to check the slow path for lanes out of fast_inv_sqrt_ps()'s range
+    float* soa = (float*)malloc(7 * BENCH_INPUT_COUNT * sizeof(float));
+    float* x = soa;
+    float* y = soa + BENCH_INPUT_COUNT;
+    float* z = soa + 2*BENCH_INPUT_COUNT;
+    versor_soa q = {soa + 3*BENCH_INPUT_COUNT, soa + 4*BENCH_INPUT_COUNT, soa + 5*BENCH_INPUT_COUNT, soa + 6*BENCH_INPUT_COUNT};
+    for(uint32 i = 0; i < BENCH_INPUT_COUNT; ++i){
+        vec3 p = batch_normalise_input(d, i);
+        x[i] = p.x; y[i] = p.y; z[i] = p.z;
+        versor r = batch_normalise_input_q(d, i);
+        q.w[i] = r.q[0]; q.x[i] = r.q[1]; q.y[i] = r.q[2]; q.z[i] = r.q[3];
+    }
+    normalise_soa(x, y, z, x, y, z, BENCH_INPUT_COUNT);
+    normalise_batch(q, q, BENCH_INPUT_COUNT);
+    float soa_error = 0, batch_error = 0;
+    for(uint32 i = 0; i < BENCH_INPUT_COUNT; ++i){
+        vec3 reference = normalise(batch_normalise_input(d, i));
+        vec3 batch = {x[i], y[i], z[i]};
+        soa_error = MAX(soa_error, max_abs_diff(batch.v, reference.v, 3));
+        versor reference_q = normalise(batch_normalise_input_q(d, i));
+        versor batch_q = {q.w[i], q.x[i], q.y[i], q.z[i]};
+        batch_error = MAX(batch_error, max_abs_diff(batch_q.q, reference_q.q, 4));
+        if(!(batch.x == batch.x && batch_q.q[0] == batch_q.q[0])) batch_error = INFINITY; //NaN
+    }
+    free(soa);
+
+    bool passed = true;
+    passed &= check("gamemaths/fast_inv_sqrtf_vs_libm", "max_relative_error", inv_sqrt_error, 5e-7f);
+    passed &= check("gamemaths/normalise_versor", "max_unit_length_error", versor_unit_error, 1e-6f);
+    passed &= check("gamemaths/normalise_zero", "error", zero_error, 0.0f);
+    passed &= check("gamemaths/normalise_tiny_and_huge", "error", extreme_error, 1e-5f);
+    passed &= check("gamemaths/normalise_soa_vs_normalise", "max_error", soa_error, 1e-6f);
+    passed &= check("gamemaths/normalise_batch_vs_normalise", "max_error", batch_error, 1e-6f);
+    return passed;
+}
+
+// Is p inside the clip space box -w <= x, y, z <= w, and by how much (negative if outside)?
+static float clip_space_margin(const mat4& view_proj, vec3 p)
+{
+    vec4 clip = view_proj * vec4{p.x, p.y, p.z, 1};
+    float margin = clip.w - fabsf(clip.x);
+    margin = MIN(margin, clip.w - fabsf(clip.y));
+    margin = MIN(margin, clip.w - fabsf(clip.z));
+    return margin;
+}
+
+static bool check_geometry(const MathsTestData& d)
+{
+    const frustum& f = d.view_frustum;
+
+    //A sphere of radius 0 is a point, which must agree with clipping it (away from the edges, where rounding decides)
+    uint32 point_mismatches = 0, box_false_culls = 0, missed_rays = 0;
+    for(uint32 i = 0; i < BENCH_INPUT_COUNT; ++i){
+        float margin = clip_space_margin(d.view_proj, d.spheres[i].centre);
+        if(fabsf(margin) > 1e-3f && (margin > 0) != sphere_in_frustum(f, sphere{d.spheres[i].centre, 0}))
+            point_mismatches++;
+
+        //Conservative: a box with any corner in view can't be culled
+        const aabb& box = d.boxes[i];
+        bool corner_in_view = false;
+        for(int corner = 0; corner < 8; ++corner){
+            vec3 p = {(corner & 1) ? box.max.x : box.min.x, (corner & 2) ? box.max.y : box.min.y, (corner & 4) ? box.max.z : box.min.z};
+            corner_in_view |= (clip_space_margin(d.view_proj, p) > 0);
+        }
+        if(corner_in_view && !aabb_in_frustum(f, box)) box_false_culls++;
+
+        //A ray from outside aimed at a box's centre has to hit it, at a point on its surface
+        const ray& r = d.rays[i];
+        if(i % 2 == 0 && !aabbs_overlap(aabb{r.origin, r.origin}, box)){
+            float t = ray_hits_aabb(r, box);
+            vec3 hit = r.origin + r.dir * t;
+            vec3 outside = {MAX(MAX(box.min.x - hit.x, hit.x - box.max.x), 0.0f), MAX(MAX(box.min.y - hit.y, hit.y - box.max.y), 0.0f),
+                            MAX(MAX(box.min.z - hit.z, hit.z - box.max.z), 0.0f)};
+            if(t > 1.0f || length(outside) > 1e-3f) missed_rays++;
+        }
+    }
+
+    //Batch versions must match the single value ones exactly
+    bool* batch = (bool*)malloc(BENCH_INPUT_COUNT * sizeof(bool));
+    float* t = (float*)malloc(BENCH_INPUT_COUNT * sizeof(float));
+    uint32 sphere_mismatches = 0, box_mismatches = 0, overlap_mismatches = 0, ray_mismatches = 0;
+    spheres_in_frustum(f, d.spheres_soa, batch, BENCH_INPUT_COUNT);
+    for(uint32 i = 0; i < BENCH_INPUT_COUNT; ++i)
+        sphere_mismatches += (batch[i] != sphere_in_frustum(f, d.spheres[i]));
+    aabbs_in_frustum(f, d.boxes_soa, batch, BENCH_INPUT_COUNT);
+    for(uint32 i = 0; i < BENCH_INPUT_COUNT; ++i)
+        box_mismatches += (batch[i] != aabb_in_frustum(f, d.boxes[i]));
+    for(uint32 j = 0; j < 16; ++j){
+        aabbs_overlap_batch(d.boxes[j], d.boxes_soa, batch, BENCH_INPUT_COUNT);
+        for(uint32 i = 0; i < BENCH_INPUT_COUNT; ++i)
+            overlap_mismatches += (batch[i] != aabbs_overlap(d.boxes[j], d.boxes[i]));
+
+        //Axis aligned rays too, their 1/0 directions are the awkward case
+        ray r = d.rays[j];
+        if(j % 4 == 3) r.dir = vec3{0, (j % 8 == 3) ? 1.0f : 0.0f, (j % 8 == 3) ? 0.0f : -1.0f};
+        ray_hits_aabbs(r, d.boxes_soa, t, BENCH_INPUT_COUNT);
+        for(uint32 i = 0; i < BENCH_INPUT_COUNT; ++i)
+            ray_mismatches += (t[i] != ray_hits_aabb(r, d.boxes[i]));
+    }
+    free(t);
+    free(batch);
+
+    bool passed = true;
+    passed &= check("gamemaths/sphere_in_frustum_vs_clip_space", "mismatches", (float)point_mismatches, 0);
+    passed &= check("gamemaths/aabb_in_frustum", "visible_boxes_culled", (float)box_false_culls, 0);
+    passed &= check("gamemaths/ray_hits_aabb", "missed_rays", (float)missed_rays, 0);
+    passed &= check("gamemaths/spheres_in_frustum_vs_scalar", "mismatches", (float)sphere_mismatches, 0);
+    passed &= check("gamemaths/aabbs_in_frustum_vs_scalar", "mismatches", (float)box_mismatches, 0);
+    passed &= check("gamemaths/aabbs_overlap_batch_vs_scalar", "mismatches", (float)overlap_mismatches, 0);
+    passed &= check("gamemaths/ray_hits_aabbs_vs_scalar", "mismatches", (float)ray_mismatches, 0);
+    return passed;
+}
+
+int main(int argc, char** argv)
+{
+    uint32 iterations = MAX(get_arg_u32(argc, argv, 1, 2000), 1u);
+
+    BenchRng rng = {0x12345678};
+    MathsTestData data;
+    make_test_data(&data, &rng);
+
+    report_result("gamemaths/config", "iterations", iterations);
+    report_result("gamemaths/config", "input_count", BENCH_INPUT_COUNT);
+    report_result("gamemaths/config", "simd_level", GAMEMATHS_AVX ? 2 : (GAMEMATHS_SSE ? 1 : 0));
+    report_result("gamemaths/config", "fma", GAMEMATHS_FMA);
+    report_result("gamemaths/config", "fast_trig", GAMEMATHS_FAST_TRIG);
+
+    bench_matrices(data, iterations);
+    bench_quaternions(data, iterations);
+    bench_trig(data, iterations);
+    bench_normalise(data, iterations);
+    bench_geometry(data, iterations);
+    bench_batches(data, iterations);
+
+    bool passed = true;
+    passed &= check_matrices(data);
+    passed &= check_quaternions(data);
+    passed &= check_trig();
+    passed &= check_normalise(data);
+    passed &= check_geometry(data);
+    passed &= check_batches(data);
+
+    return passed ? 0 : 1;
+}
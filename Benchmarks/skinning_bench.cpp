@@ -0,0 +1,106 @@
+// Headless CPU skinning benchmark: skin_vertices (SIMD) vs skin_vertices_reference
+// Usage: skinning_bench [vert_count] [bone_count] [iterations]
+
+#include "benchmark.h"
+
+#include "../GameMaths.h"
+#include "../Animation.h"
+#include "../Skinning.h"
+
+#include "../Skinning.cpp"
+
+struct SkinningTestData {
+    uint32 vert_count;
+    uint32 bone_count;
+    mat4* pose_mats;
+    float* vp;
+    float* vn;
+    uint32* bone_ids;
+    float* bone_weights;
+};
+
+static void make_test_data(SkinningTestData* data, uint32 vert_count, uint32 bone_count)
+{
+    BenchRng rng = {0x12345678};
+    data->vert_count = vert_count;
+    data->bone_count = bone_count;
+    data->pose_mats = (mat4*)malloc(bone_count * sizeof(mat4));
+    data->vp = (float*)malloc(vert_count * 3 * sizeof(float));
+    data->vn = (float*)malloc(vert_count * 3 * sizeof(float));
+    data->bone_ids = (uint32*)malloc(vert_count * 4 * sizeof(uint32));
+    data->bone_weights = (float*)malloc(vert_count * 4 * sizeof(float));
+
+    for(uint32 i = 0; i < bone_count; ++i)
+    {
+        vec3 axis = normalise(vec3{rand_float(&rng, -1, 1), rand_float(&rng, -1, 1), rand_float(&rng, -1, 1)});
+        vec3 pos = {rand_float(&rng, -1, 1), rand_float(&rng, -1, 1), rand_float(&rng, -1, 1)};
+        data->pose_mats[i] = translate(rotate_axis_deg_mat4(axis, rand_float(&rng, -180, 180)), pos);
+    }
+
+    for(uint32 i = 0; i < vert_count; ++i)
+    {
+        vec3 n = normalise(vec3{rand_float(&rng, -1, 1), rand_float(&rng, -1, 1), rand_float(&rng, -1, 1)});
+        float weight_sum = 0;
+        for(int j = 0; j < 3; ++j){
+            data->vp[3*i + j] = rand_float(&rng, -1, 1);
+            data->vn[3*i + j] = n.v[j];
+        }
+        for(int j = 0; j < 4; ++j){
+            data->bone_ids[4*i + j] = rand_u32(&rng) % bone_count;
+            data->bone_weights[4*i + j] = rand_float(&rng, 0, 1);
+            weight_sum += data->bone_weights[4*i + j];
+        }
+        for(int j = 0; j < 4; ++j)
+            data->bone_weights[4*i + j] /= weight_sum;
+    }
+}
+
+typedef void SkinFunc(const mat4*, const float*, const float*, const uint32*, const float*, uint32, float*, float*);
+
+static void bench_skinning(const char* name, SkinFunc* skin, const SkinningTestData& data, uint32 iterations, float* out_vp, float* out_vn)
+{
+    skin(data.pose_mats, data.vp, data.vn, data.bone_ids, data.bone_weights, data.vert_count, out_vp, out_vn); //warm up
+
+    double start = get_time_seconds();
+    for(uint32 i = 0; i < iterations; ++i){
+        skin(data.pose_mats, data.vp, data.vn, data.bone_ids, data.bone_weights, data.vert_count, out_vp, out_vn);
+        benchmark_sink = out_vp[i % (3*data.vert_count)];
+    }
+    double elapsed = get_time_seconds() - start;
+
+    report_result(name, "verts_per_sec", (double)data.vert_count * iterations / elapsed);
+    report_result(name, "ns_per_vert", elapsed * 1e9 / ((double)data.vert_count * iterations));
+}
+
+int main(int argc, char** argv)
+{
+    uint32 vert_count = get_arg_u32(argc, argv, 1, 10000);
+    uint32 bone_count = get_arg_u32(argc, argv, 2, 64);
+    uint32 iterations = get_arg_u32(argc, argv, 3, 500);
+
+    SkinningTestData data;
+    make_test_data(&data, vert_count, bone_count);
+
+    float* ref_vp = (float*)malloc(vert_count * 3 * sizeof(float));
+    float* ref_vn = (float*)malloc(vert_count * 3 * sizeof(float));
+    float* simd_vp = (float*)malloc(vert_count * 3 * sizeof(float));
+    float* simd_vn = (float*)malloc(vert_count * 3 * sizeof(float));
+
+    report_result("skinning/config", "vert_count", vert_count);
+    report_result("skinning/config", "bone_count", bone_count);
+    report_result("skinning/config", "simd_level", GAMEMATHS_AVX ? 2 : (GAMEMATHS_SSE ? 1 : 0));
+
+    bench_skinning("skinning/reference", skin_vertices_reference, data, iterations, ref_vp, ref_vn);
+    bench_skinning("skinning/simd", skin_vertices, data, iterations, simd_vp, simd_vn);
+
+    //Validate SIMD path against the reference
+    float max_pos_error = 0, max_normal_error = 0;
+    for(uint32 i = 0; i < 3*vert_count; ++i){
+        max_pos_error = MAX(max_pos_error, fabsf(simd_vp[i] - ref_vp[i]));
+        max_normal_error = MAX(max_normal_error, fabsf(simd_vn[i] - ref_vn[i]));
+    }
+    report_result("skinning/simd_vs_reference", "max_pos_error", max_pos_error);
+    report_result("skinning/simd_vs_reference", "max_normal_error", max_normal_error);
+
+    return (max_pos_error < 1e-4f && max_normal_error < 1e-4f) ? 0 : 1;
+}
@@ -0,0 +1,97 @@
+#include "BonePalette.h"
+
+#include <stdlib.h> //malloc, free
+
+#include "GameMaths.h"
+#include "Shader.h"
+
+const char* skinning_vert_shader(SkinningMode mode)
+{
+    switch(mode){
+        case SKINNING_MODE_MAT4:      return "Skinning.vert";
+        case SKINNING_MODE_MAT3X4:    return "Skinning_mat3x4.vert";
+        case SKINNING_MODE_DUAL_QUAT: return "Skinning_dual_quat.vert";
+        default: assert(false);       return "Skinning.vert";
+    }
+}
+
+void init_bone_palette(BonePalette* palette, uint32 num_bones, uint32 max_instances, SkinningMode mode)
+{
+    palette->mode = mode;
+    palette->num_bones = num_bones;
+    palette->max_instances = max_instances;
+
+    // One RGBA32F texel per column (mat4), row (mat3x4) or quaternion (dual_quat)
+    const uint32 texel_size = 4*sizeof(float);
+    switch(mode){
+        case SKINNING_MODE_MAT4:      palette->num_texels_per_bone = sizeof(mat4) / texel_size; break;
+        case SKINNING_MODE_MAT3X4:    palette->num_texels_per_bone = sizeof(mat3x4) / texel_size; break;
+        case SKINNING_MODE_DUAL_QUAT: palette->num_texels_per_bone = sizeof(dual_quat) / texel_size; break;
+        default: assert(false);
+    }
+    size_t buffer_size = max_instances * num_bones * palette->num_texels_per_bone * texel_size;
+
+    palette->packed_bones = NULL;
+    if(mode != SKINNING_MODE_MAT4)
+        palette->packed_bones = (float*)malloc(buffer_size);
+
+    glGenBuffers(1, &palette->tbo);
+    glBindBuffer(GL_TEXTURE_BUFFER, palette->tbo);
+    glBufferData(GL_TEXTURE_BUFFER, buffer_size, NULL, GL_STREAM_DRAW);
+
+    glGenTextures(1, &palette->texture);
+    glBindTexture(GL_TEXTURE_BUFFER, palette->texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, palette->tbo);
+
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    check_gl_error();
+}
+
+void upload_bone_palette(BonePalette* palette, const mat4* pose_mats, uint32 num_instances)
+{
+    assert(num_instances <= palette->max_instances);
+
+    const uint32 texel_size = 4*sizeof(float);
+    const uint32 num_bones = num_instances * palette->num_bones;
+    const void* data = pose_mats;
+
+    if(palette->mode == SKINNING_MODE_MAT3X4)
+    {
+        mat3x4* packed = (mat3x4*)palette->packed_bones;
+        for(uint32 i = 0; i < num_bones; ++i)
+            packed[i] = mat4_to_mat3x4(pose_mats[i]);
+        data = packed;
+    }
+    else if(palette->mode == SKINNING_MODE_DUAL_QUAT)
+    {
+        dual_quat* packed = (dual_quat*)palette->packed_bones;
+        for(uint32 i = 0; i < num_bones; ++i)
+            packed[i] = mat4_to_dual_quat(pose_mats[i]);
+        data = packed;
+    }
+
+    // Orphan the old storage so we don't stall on draws still reading last frame's matrices
+    glBindBuffer(GL_TEXTURE_BUFFER, palette->tbo);
+    glBufferData(GL_TEXTURE_BUFFER, palette->max_instances * palette->num_bones * palette->num_texels_per_bone * texel_size, NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, num_bones * palette->num_texels_per_bone * texel_size, data);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void bind_bone_palette(const BonePalette* palette, const Shader& shader, uint32 instance_index, uint32 texture_unit)
+{
+    assert(instance_index < palette->max_instances);
+
+    glActiveTexture(GL_TEXTURE0 + texture_unit);
+    glBindTexture(GL_TEXTURE_BUFFER, palette->texture);
+    glUniform1i(shader.pose_mats_loc, texture_unit);
+    glUniform1i(shader.pose_mats_offset_loc, instance_index * palette->num_bones * palette->num_texels_per_bone);
+}
+
+void delete_bone_palette(BonePalette* palette)
+{
+    glDeleteTextures(1, &palette->texture);
+    glDeleteBuffers(1, &palette->tbo);
+    free(palette->packed_bones);
+    *palette = {};
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "gl_lite.h"
+#include "utils.h"
+
+struct mat4;
+struct Shader;
+
+// How bone transforms are packed into the palette and blended by the skinning shader
+enum SkinningMode {
+    SKINNING_MODE_MAT4,      // 4 texels/bone, linear blend skinning. Shaders/Skinning.vert
+    SKINNING_MODE_MAT3X4,    // 3 texels/bone, linear blend skinning of affine rows. Shaders/Skinning_mat3x4.vert
+    SKINNING_MODE_DUAL_QUAT, // 2 texels/bone, dual quaternion blend skinning (no scaling bones!). Shaders/Skinning_dual_quat.vert
+    NUM_SKINNING_MODES
+};
+
+// Vertex shader filename to use for mode
+const char* skinning_vert_shader(SkinningMode mode);
+
+// Skinning pose matrices for one or more characters, stored in a texture buffer.
+// All instances' palettes are uploaded together in one transfer per frame.
+// Skinning shaders read them with texelFetch on `poseMats`, starting at texel `poseMatsOffset`
+struct BonePalette {
+    GLuint tbo;
+    GLuint texture;
+    SkinningMode mode;
+    uint32 num_bones;     // per instance
+    uint32 max_instances;
+    uint32 num_texels_per_bone;
+    float* packed_bones;  // staging memory for packed modes, NULL for SKINNING_MODE_MAT4
+};
+
+void init_bone_palette(BonePalette* palette, uint32 num_bones, uint32 max_instances = 1, SkinningMode mode = SKINNING_MODE_MAT4);
+// pose_mats holds num_instances consecutive palettes of palette->num_bones matrices
+// They are packed according to palette->mode before uploading
+void upload_bone_palette(BonePalette* palette, const mat4* pose_mats, uint32 num_instances = 1);
+// Binds palette to texture_unit and points shader's skinning uniforms at instance_index's matrices
+void bind_bone_palette(const BonePalette* palette, const Shader& shader, uint32 instance_index = 0, uint32 texture_unit = 0);
+void delete_bone_palette(BonePalette* palette);
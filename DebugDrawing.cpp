@@ -26,7 +26,6 @@ void init_debug_draw(DebugDraw* draw_data)
 	glVertexAttribPointer(VP_ATTRIB_LOC, 3, GL_FLOAT, GL_FALSE, 0, NULL);
 
     draw_data->shader = init_shader("MVP_depth_bias.vert", "uniform_colour.frag");
-    draw_data->colour_uniform_loc = glGetUniformLocation(draw_data->shader.id, "colour");
 
     draw_data->num_queued_points = 0;
     draw_data->num_queued_lines = 0;
@@ -84,7 +83,8 @@ void debug_draw_flush(DebugDraw* draw_data, Camera3D &cam)
     {
         DebugDrawLine* line = &draw_data->lines_queue[line_index];
 
-        mat4 M = translate(identity_mat4(), vec3{0, 0.5f, 0}); // move base of quad to origin
+        static constexpr mat4 quad_base_to_origin = translate(identity_mat4(), vec3{0, 0.5f, 0}); // move base of quad to origin
+        mat4 M = quad_base_to_origin;
         float dist = length(line->dir);
         M = scale(M, vec3{0.05f, dist, 0.05f});
 
@@ -125,7 +125,7 @@ void debug_draw_flush(DebugDraw* draw_data, Camera3D &cam)
 
     for(uint32_t drawable_index = 0; drawable_index < drawables_count; ++drawable_index)
     {
-        glUniform4fv(draw_data->colour_uniform_loc, 1, colour_uniforms[drawable_index].v);
+        glUniform4fv(draw_data->shader.colour_loc, 1, colour_uniforms[drawable_index].v);
         glUniformMatrix4fv(draw_data->shader.M_loc, 1, GL_FALSE, model_mats[drawable_index].m);
 
         glDrawArrays(GL_TRIANGLES, 0, 6);
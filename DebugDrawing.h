@@ -20,7 +20,6 @@ struct DebugDraw {
     GLuint quad_vao;
     GLuint quad_vbo;
     Shader shader;
-    GLuint colour_uniform_loc;
     uint32_t num_queued_points;
     uint32_t num_queued_lines;
     DebugDrawPoint points_queue[MAX_NUM_DEBUG_DRAW_ELEMENTS/2];
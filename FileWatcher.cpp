@@ -0,0 +1,161 @@
+#include "FileWatcher.h"
+
+#include <stdio.h>
+#include <chrono>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+#include "string_functions.h"
+
+//How often the watcher thread wakes up to check for changes/quit requests
+#define FILE_WATCHER_POLL_INTERVAL_MS 100
+
+static void _queue_changed_file(FileWatcher* watcher, const char* filename)
+{
+    std::lock_guard<std::mutex> lock(watcher->mutex);
+
+    //Editors often write a file several times when saving, only queue it once
+    for(uint32 i = 0; i < watcher->num_changed_files; ++i){
+        if(strings_are_equal(watcher->changed_files[i], filename)) return;
+    }
+    if(watcher->num_changed_files == FILE_WATCHER_MAX_CHANGED_FILES){
+        fprintf(stderr, "WARNING: FileWatcher queue full, dropping change to %s%s\n", watcher->folder, filename);
+        return;
+    }
+    copy_string(filename, watcher->changed_files[watcher->num_changed_files++], FILE_WATCHER_FILENAME_LENGTH);
+}
+
+#if defined(__linux__)
+static void _watch_folder(FileWatcher* watcher)
+{
+    // Buffer must be aligned for inotify_event and big enough for at least one event with a max length name
+    alignas(inotify_event) char buffer[4096];
+
+    while(!watcher->should_quit)
+    {
+        pollfd pfd = {watcher->inotify_fd, POLLIN, 0};
+        if(poll(&pfd, 1, FILE_WATCHER_POLL_INTERVAL_MS) <= 0) continue;
+
+        ssize_t length = read(watcher->inotify_fd, buffer, sizeof(buffer));
+        for(char* p = buffer; p < buffer + length; )
+        {
+            const inotify_event* event = (const inotify_event*)p;
+            if(event->len > 0) _queue_changed_file(watcher, event->name);
+            p += sizeof(inotify_event) + event->len;
+        }
+    }
+}
+
+#else //No inotify, poll modification times instead
+static void _poll_folder(FileWatcher* watcher, bool queue_changes)
+{
+    DIR* dir = opendir(watcher->folder);
+    if(!dir) return;
+
+    while(dirent* entry = readdir(dir))
+    {
+        char full_path[2*FILE_WATCHER_FILENAME_LENGTH];
+        concat_strings_safe(watcher->folder, entry->d_name, full_path, sizeof(full_path));
+
+        struct stat file_stat;
+        if(stat(full_path, &file_stat) != 0 || !S_ISREG(file_stat.st_mode)) continue;
+        int64 mtime = (int64)file_stat.st_mtime;
+
+        uint32 file_index = 0;
+        while(file_index < watcher->num_polled_files && !strings_are_equal(watcher->polled_files[file_index], entry->d_name))
+            ++file_index;
+
+        if(file_index == watcher->num_polled_files)
+        {
+            if(file_index == FILE_WATCHER_MAX_POLLED_FILES) continue;
+            copy_string(entry->d_name, watcher->polled_files[file_index], FILE_WATCHER_FILENAME_LENGTH);
+            watcher->polled_mtimes[file_index] = mtime;
+            ++watcher->num_polled_files;
+            if(queue_changes) _queue_changed_file(watcher, entry->d_name);
+        }
+        else if(watcher->polled_mtimes[file_index] != mtime)
+        {
+            watcher->polled_mtimes[file_index] = mtime;
+            if(queue_changes) _queue_changed_file(watcher, entry->d_name);
+        }
+    }
+    closedir(dir);
+}
+
+static void _watch_folder(FileWatcher* watcher)
+{
+    while(!watcher->should_quit)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(FILE_WATCHER_POLL_INTERVAL_MS));
+        _poll_folder(watcher, true);
+    }
+}
+#endif
+
+bool init_file_watcher(FileWatcher* watcher, const char* folder)
+{
+    copy_string(folder, watcher->folder, FILE_WATCHER_FILENAME_LENGTH);
+    watcher->should_quit = false;
+    watcher->is_running = false;
+    watcher->num_changed_files = 0;
+
+#if defined(__linux__)
+    watcher->inotify_fd = inotify_init1(IN_NONBLOCK);
+    if(watcher->inotify_fd < 0){
+        fprintf(stderr, "ERROR: inotify_init failed, not watching %s\n", folder);
+        return false;
+    }
+    //Catch editors that write in place (IN_CLOSE_WRITE) and ones that save to a temp file and rename it (IN_MOVED_TO)
+    if(inotify_add_watch(watcher->inotify_fd, folder, IN_CLOSE_WRITE | IN_MOVED_TO) < 0){
+        fprintf(stderr, "ERROR: inotify_add_watch failed, not watching %s\n", folder);
+        close(watcher->inotify_fd);
+        return false;
+    }
+#else
+    //Record current modification times so we only report files that change from now on
+    watcher->num_polled_files = 0;
+    _poll_folder(watcher, false);
+#endif
+
+    watcher->thread = std::thread(_watch_folder, watcher);
+    watcher->is_running = true;
+    return true;
+}
+
+uint32 pop_changed_files(FileWatcher* watcher, char (*out_files)[FILE_WATCHER_FILENAME_LENGTH], uint32 max_files)
+{
+    if(!watcher->is_running) return 0;
+
+    std::lock_guard<std::mutex> lock(watcher->mutex);
+
+    uint32 count = (watcher->num_changed_files < max_files) ? watcher->num_changed_files : max_files;
+    for(uint32 i = 0; i < count; ++i){
+        copy_string(watcher->changed_files[i], out_files[i], FILE_WATCHER_FILENAME_LENGTH);
+    }
+    //Keep anything that didn't fit for next time
+    for(uint32 i = count; i < watcher->num_changed_files; ++i){
+        copy_string(watcher->changed_files[i], watcher->changed_files[i - count], FILE_WATCHER_FILENAME_LENGTH);
+    }
+    watcher->num_changed_files -= count;
+    return count;
+}
+
+void shutdown_file_watcher(FileWatcher* watcher)
+{
+    if(!watcher->is_running) return;
+
+    watcher->should_quit = true;
+    watcher->thread.join();
+    watcher->is_running = false;
+
+#if defined(__linux__)
+    close(watcher->inotify_fd);
+#endif
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+#include "utils.h"
+
+#define FILE_WATCHER_MAX_CHANGED_FILES 32
+#define FILE_WATCHER_FILENAME_LENGTH 64
+#define FILE_WATCHER_MAX_POLLED_FILES 64
+
+// Watches a folder on a background thread and queues the names of files in it that change.
+// Linux uses inotify, other platforms poll file modification times.
+// The main thread collects the queue with pop_changed_files() whenever it likes (e.g. between frames).
+struct FileWatcher {
+    char folder[FILE_WATCHER_FILENAME_LENGTH];
+    std::thread thread;
+    std::mutex mutex;
+    std::atomic<bool> should_quit;
+    bool is_running;
+
+    // Guarded by mutex
+    uint32 num_changed_files;
+    char changed_files[FILE_WATCHER_MAX_CHANGED_FILES][FILE_WATCHER_FILENAME_LENGTH];
+
+#if defined(__linux__)
+    int inotify_fd;
+#else
+    // Only touched by the watcher thread
+    uint32 num_polled_files;
+    char polled_files[FILE_WATCHER_MAX_POLLED_FILES][FILE_WATCHER_FILENAME_LENGTH];
+    int64 polled_mtimes[FILE_WATCHER_MAX_POLLED_FILES];
+#endif
+};
+
+bool init_file_watcher(FileWatcher* watcher, const char* folder);
+// Copies the names (relative to the watched folder) of files changed since the last call into out_files and clears the queue
+// Returns number of names written
+uint32 pop_changed_files(FileWatcher* watcher, char (*out_files)[FILE_WATCHER_FILENAME_LENGTH], uint32 max_files);
+void shutdown_file_watcher(FileWatcher* watcher);
@@ -3,7 +3,6 @@
 // Based off simple maths library included with online source for 'Anton's OpenGL Tutorials' book by Anton Gerdelan
 // License: https://github.com/capnramses/antons_opengl_tutorials_book/blob/master/LICENCE.md
 // Modified and added to by me over the years
-// TODO: Maybe SIMD if it'll help, never needed it so far
 
 //Original header:
 /******************************************************************************\
@@ -21,7 +20,50 @@
 \******************************************************************************/
 
 #include <stdio.h>
+#include <stddef.h> //size_t
 #include <math.h>
+#include <float.h> //FLT_MIN, FLT_MAX
+
+//------------------------------------------------------------------------------
+// SIMD support
+//------------------------------------------------------------------------------
+// Picked up from compiler flags: SSE2 is always on for x86-64, pass -mavx -mfma for AVX/FMA.
+// Define GAMEMATHS_NO_SIMD to force the scalar code paths
+#ifndef GAMEMATHS_NO_SIMD
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define GAMEMATHS_SSE 1
+#include <emmintrin.h>
+#endif
+#if defined(__AVX__)
+#define GAMEMATHS_AVX 1
+#include <immintrin.h>
+#endif
+#if defined(__FMA__)
+#define GAMEMATHS_FMA 1
+#endif
+#endif //GAMEMATHS_NO_SIMD
+#ifndef GAMEMATHS_SSE
+#define GAMEMATHS_SSE 0
+#endif
+#ifndef GAMEMATHS_AVX
+#define GAMEMATHS_AVX 0
+#endif
+#ifndef GAMEMATHS_FMA
+#define GAMEMATHS_FMA 0
+#endif
+
+#if GAMEMATHS_SSE
+// a * b + c. Without FMA the SIMD paths add up in the same order as the reference versions and match them exactly
+#if GAMEMATHS_FMA
+#define _gm_madd_ps(a, b, c) _mm_fmadd_ps((a), (b), (c))
+#define _gm_madd256_ps(a, b, c) _mm256_fmadd_ps((a), (b), (c))
+#else
+#define _gm_madd_ps(a, b, c) _mm_add_ps(_mm_mul_ps((a), (b)), (c))
+#define _gm_madd256_ps(a, b, c) _mm256_add_ps(_mm256_mul_ps((a), (b)), (c))
+#endif
+// Lane i of v in all 4 lanes
+#define _gm_splat_ps(v, i) _mm_shuffle_ps((v), (v), _MM_SHUFFLE(i, i, i, i))
+#endif
 
 #define PI32 3.14159265359f
 #define PI64 3.1415926535897931
@@ -38,13 +80,241 @@ inline bool almost_equal(float a, float b, float eps = 0.000001f) {
 	return (fabs(a-b) < eps);
 }
 
-inline float DEG2RAD(float degs) {
+constexpr float DEG2RAD(float degs) {
 	return degs * (PI32 / 180.0f);
 }
-inline float RAD2DEG(float rads) {
+constexpr float RAD2DEG(float rads) {
 	return rads * (180.0f / PI32);
 }
 
+//------------------------------------------------------------------------------
+// Fast trigonometry
+//------------------------------------------------------------------------------
+// Polynomial approximations, no libm calls, branch free (so they vectorise: see the _ps versions).
+// Max absolute error measured against double precision libm:
+//  fast_sinf, fast_cosf: 2.5e-7 for |x| <= 1000 (range reduction loses accuracy far beyond that, and needs |x| < 1e9)
+//  fast_acosf:           5e-7 over [-1, 1]
+// sin/cos reduce x to [-PI, PI] then use a degree 9 minimax polynomial for sin on [-PI/2, PI/2].
+// acos is Abramowitz & Stegun 4.4.46.
+
+// Define GAMEMATHS_FAST_TRIG 1 to make the hot_* functions below (used by slerp, the rotate_* matrices,
+// quat_from_axis_rad and player turning) use the approximations instead of libm
+#ifndef GAMEMATHS_FAST_TRIG
+#define GAMEMATHS_FAST_TRIG 0
+#endif
+
+#define _GM_SIN_C3 -0.166666572f
+#define _GM_SIN_C5 0.00833302004f
+#define _GM_SIN_C7 -0.000198067898f
+#define _GM_SIN_C9 2.60039521e-06f
+#define _GM_2PI_HI 6.28125f //2*PI split in two so x - k*2*PI stays accurate for larger k
+#define _GM_2PI_LO 1.9353071795864769e-3f
+
+inline float _gm_sin_poly(float r) {
+	float r2 = r * r;
+	return r + r * r2 * (_GM_SIN_C3 + r2 * (_GM_SIN_C5 + r2 * (_GM_SIN_C7 + r2 * _GM_SIN_C9)));
+}
+inline float _gm_reduce_pi(float x) {
+	// Round to nearest by truncating, floorf() is a function call without SSE4.1
+	float k = (float)(int)(x * (1.0f / (2.0f * PI32)) + ((x < 0.0f) ? -0.5f : 0.5f));
+	return (x - k * _GM_2PI_HI) - k * _GM_2PI_LO;
+}
+
+inline float fast_sinf(float x) {
+	float r = _gm_reduce_pi(x);
+	// sin(r) = sin(PI - r), folds [PI/2, PI] onto [0, PI/2]
+	float a = fabsf(r);
+	a = MIN(a, PI32 - a);
+	return _gm_sin_poly((r < 0.0f) ? -a : a);
+}
+
+inline float fast_cosf(float x) {
+	// cos(r) = sin(PI/2 - |r|)
+	return _gm_sin_poly(0.5f * PI32 - fabsf(_gm_reduce_pi(x)));
+}
+
+#define _GM_ACOS_C0 1.5707963050f
+#define _GM_ACOS_C1 -0.2145988016f
+#define _GM_ACOS_C2 0.0889789874f
+#define _GM_ACOS_C3 -0.0501743046f
+#define _GM_ACOS_C4 0.0308918810f
+#define _GM_ACOS_C5 -0.0170881256f
+#define _GM_ACOS_C6 0.0066700901f
+#define _GM_ACOS_C7 -0.0012624911f
+
+// x is clamped to [-1, 1]
+inline float fast_acosf(float x) {
+	float a = MIN(fabsf(x), 1.0f);
+	float p = _GM_ACOS_C0 + a * (_GM_ACOS_C1 + a * (_GM_ACOS_C2 + a * (_GM_ACOS_C3 +
+	          a * (_GM_ACOS_C4 + a * (_GM_ACOS_C5 + a * (_GM_ACOS_C6 + a * _GM_ACOS_C7))))));
+	p *= sqrtf(1.0f - a);
+	return (x < 0.0f) ? PI32 - p : p;
+}
+
+inline float hot_sinf(float x) {
+#if GAMEMATHS_FAST_TRIG
+	return fast_sinf(x);
+#else
+	return sinf(x);
+#endif
+}
+inline float hot_cosf(float x) {
+#if GAMEMATHS_FAST_TRIG
+	return fast_cosf(x);
+#else
+	return cosf(x);
+#endif
+}
+inline float hot_acosf(float x) {
+#if GAMEMATHS_FAST_TRIG
+	return fast_acosf(x);
+#else
+	return acosf(x);
+#endif
+}
+
+#if GAMEMATHS_SSE
+// 4 lanes at a time, same maths and error as fast_sinf and fast_cosf
+inline __m128 _gm_sin_poly_ps(__m128 r) {
+	__m128 r2 = _mm_mul_ps(r, r);
+	__m128 p = _gm_madd_ps(r2, _mm_set1_ps(_GM_SIN_C9), _mm_set1_ps(_GM_SIN_C7));
+	p = _gm_madd_ps(r2, p, _mm_set1_ps(_GM_SIN_C5));
+	p = _gm_madd_ps(r2, p, _mm_set1_ps(_GM_SIN_C3));
+	return _gm_madd_ps(_mm_mul_ps(r, r2), p, r);
+}
+inline __m128 _gm_reduce_pi_ps(__m128 x) {
+	__m128 k = _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(1.0f / (2.0f * PI32))))); // round to nearest
+	__m128 r = _mm_sub_ps(x, _mm_mul_ps(k, _mm_set1_ps(_GM_2PI_HI)));
+	return _mm_sub_ps(r, _mm_mul_ps(k, _mm_set1_ps(_GM_2PI_LO)));
+}
+inline __m128 fast_sin_ps(__m128 x) {
+	__m128 r = _gm_reduce_pi_ps(x);
+	__m128 sign = _mm_and_ps(r, _mm_set1_ps(-0.0f));
+	__m128 a = _mm_xor_ps(r, sign);
+	a = _mm_min_ps(a, _mm_sub_ps(_mm_set1_ps(PI32), a));
+	return _mm_xor_ps(_gm_sin_poly_ps(a), sign);
+}
+inline __m128 fast_cos_ps(__m128 x) {
+	__m128 a = _mm_andnot_ps(_mm_set1_ps(-0.0f), _gm_reduce_pi_ps(x));
+	return _gm_sin_poly_ps(_mm_sub_ps(_mm_set1_ps(0.5f * PI32), a));
+}
+inline __m128 fast_acos_ps(__m128 x) {
+	__m128 a = _mm_min_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), x), _mm_set1_ps(1.0f));
+	__m128 p = _gm_madd_ps(a, _mm_set1_ps(_GM_ACOS_C7), _mm_set1_ps(_GM_ACOS_C6));
+	p = _gm_madd_ps(a, p, _mm_set1_ps(_GM_ACOS_C5));
+	p = _gm_madd_ps(a, p, _mm_set1_ps(_GM_ACOS_C4));
+	p = _gm_madd_ps(a, p, _mm_set1_ps(_GM_ACOS_C3));
+	p = _gm_madd_ps(a, p, _mm_set1_ps(_GM_ACOS_C2));
+	p = _gm_madd_ps(a, p, _mm_set1_ps(_GM_ACOS_C1));
+	p = _gm_madd_ps(a, p, _mm_set1_ps(_GM_ACOS_C0));
+	p = _mm_mul_ps(p, _mm_sqrt_ps(_mm_sub_ps(_mm_set1_ps(1.0f), a)));
+	// PI - p where x < 0
+	__m128 negative = _mm_cmplt_ps(x, _mm_setzero_ps());
+	return _mm_add_ps(_mm_xor_ps(p, _mm_and_ps(negative, _mm_set1_ps(-0.0f))), _mm_and_ps(negative, _mm_set1_ps(PI32)));
+}
+#endif
+
+#if GAMEMATHS_AVX
+// 8 lanes at a time
+inline __m256 _gm_sin_poly256_ps(__m256 r) {
+	__m256 r2 = _mm256_mul_ps(r, r);
+	__m256 p = _gm_madd256_ps(r2, _mm256_set1_ps(_GM_SIN_C9), _mm256_set1_ps(_GM_SIN_C7));
+	p = _gm_madd256_ps(r2, p, _mm256_set1_ps(_GM_SIN_C5));
+	p = _gm_madd256_ps(r2, p, _mm256_set1_ps(_GM_SIN_C3));
+	return _gm_madd256_ps(_mm256_mul_ps(r, r2), p, r);
+}
+inline __m256 _gm_reduce_pi256_ps(__m256 x) {
+	__m256 k = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(1.0f / (2.0f * PI32))), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m256 r = _mm256_sub_ps(x, _mm256_mul_ps(k, _mm256_set1_ps(_GM_2PI_HI)));
+	return _mm256_sub_ps(r, _mm256_mul_ps(k, _mm256_set1_ps(_GM_2PI_LO)));
+}
+inline __m256 fast_sin256_ps(__m256 x) {
+	__m256 r = _gm_reduce_pi256_ps(x);
+	__m256 sign = _mm256_and_ps(r, _mm256_set1_ps(-0.0f));
+	__m256 a = _mm256_xor_ps(r, sign);
+	a = _mm256_min_ps(a, _mm256_sub_ps(_mm256_set1_ps(PI32), a));
+	return _mm256_xor_ps(_gm_sin_poly256_ps(a), sign);
+}
+inline __m256 fast_cos256_ps(__m256 x) {
+	__m256 a = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), _gm_reduce_pi256_ps(x));
+	return _gm_sin_poly256_ps(_mm256_sub_ps(_mm256_set1_ps(0.5f * PI32), a));
+}
+inline __m256 fast_acos256_ps(__m256 x) {
+	__m256 a = _mm256_min_ps(_mm256_andnot_ps(_mm256_set1_ps(-0.0f), x), _mm256_set1_ps(1.0f));
+	__m256 p = _gm_madd256_ps(a, _mm256_set1_ps(_GM_ACOS_C7), _mm256_set1_ps(_GM_ACOS_C6));
+	p = _gm_madd256_ps(a, p, _mm256_set1_ps(_GM_ACOS_C5));
+	p = _gm_madd256_ps(a, p, _mm256_set1_ps(_GM_ACOS_C4));
+	p = _gm_madd256_ps(a, p, _mm256_set1_ps(_GM_ACOS_C3));
+	p = _gm_madd256_ps(a, p, _mm256_set1_ps(_GM_ACOS_C2));
+	p = _gm_madd256_ps(a, p, _mm256_set1_ps(_GM_ACOS_C1));
+	p = _gm_madd256_ps(a, p, _mm256_set1_ps(_GM_ACOS_C0));
+	p = _mm256_mul_ps(p, _mm256_sqrt_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), a)));
+	return _mm256_blendv_ps(p, _mm256_sub_ps(_mm256_set1_ps(PI32), p), _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LT_OQ));
+}
+#endif
+
+// out_sin[i] = fast_sinf(x[i]), out_cos[i] = fast_cosf(x[i]). Either output may be NULL
+inline void fast_sin_cos_array(const float* x, float* out_sin, float* out_cos, size_t n) {
+	size_t i = 0;
+#if GAMEMATHS_AVX
+	for(; i < (n & ~(size_t)7); i += 8) {
+		__m256 v = _mm256_loadu_ps(&x[i]);
+		if(out_sin) _mm256_storeu_ps(&out_sin[i], fast_sin256_ps(v));
+		if(out_cos) _mm256_storeu_ps(&out_cos[i], fast_cos256_ps(v));
+	}
+#endif
+#if GAMEMATHS_SSE
+	for(; i < (n & ~(size_t)3); i += 4) {
+		__m128 v = _mm_loadu_ps(&x[i]);
+		if(out_sin) _mm_storeu_ps(&out_sin[i], fast_sin_ps(v));
+		if(out_cos) _mm_storeu_ps(&out_cos[i], fast_cos_ps(v));
+	}
+#endif
+	for(; i < n; ++i) {
+		if(out_sin) out_sin[i] = fast_sinf(x[i]);
+		if(out_cos) out_cos[i] = fast_cosf(x[i]);
+	}
+}
+
+//------------------------------------------------------------------------------
+// Fast reciprocal square root
+//------------------------------------------------------------------------------
+// The rsqrtps estimate (12 bits) refined with one Newton-Raphson step, y * (1.5 - 0.5 * x * y * y),
+// which gets within 2 ulp of 1.0f / sqrtf(x) without the slow sqrt and divide. Used by all the normalise functions.
+// x must be in [FLT_MIN, FLT_MAX]: rsqrtps gives inf for denormals and 0 for inf, which the Newton step turns
+// into NaN. Use inv_sqrtf_any() where x can be outside that. Falls back to 1.0f / sqrtf(x) without SSE
+#if GAMEMATHS_SSE
+inline __m128 fast_inv_sqrt_ps(__m128 x) {
+	__m128 y = _mm_rsqrt_ps(x);
+	__m128 half_x_y2 = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), x), _mm_mul_ps(y, y));
+	return _mm_mul_ps(y, _mm_sub_ps(_mm_set1_ps(1.5f), half_x_y2));
+}
+#endif
+
+#if GAMEMATHS_AVX
+inline __m256 fast_inv_sqrt256_ps(__m256 x) {
+	__m256 y = _mm256_rsqrt_ps(x);
+	__m256 half_x_y2 = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), x), _mm256_mul_ps(y, y));
+	return _mm256_mul_ps(y, _mm256_sub_ps(_mm256_set1_ps(1.5f), half_x_y2));
+}
+#endif
+
+inline float fast_inv_sqrtf(float x) {
+#if GAMEMATHS_SSE
+	return _mm_cvtss_f32(fast_inv_sqrt_ps(_mm_set_ss(x)));
+#else
+	return 1.0f / sqrtf(x);
+#endif
+}
+
+// fast_inv_sqrtf() for any x > 0, taking the slow 1.0f / sqrtf(x) for the denormals and inf it can't do
+inline float inv_sqrtf_any(float x) {
+	if(x >= FLT_MIN && x <= FLT_MAX) {
+		return fast_inv_sqrtf(x);
+	}
+	return 1.0f / sqrtf(x);
+}
+
 //------------------------------------------------------------------------------
 // Library contents / forward declarations
 //------------------------------------------------------------------------------
@@ -54,29 +324,51 @@ struct vec3;
 struct vec4;
 struct mat3;
 struct mat4;
+struct mat3x4;
 struct versor;
+struct dual_quat;
+struct transform;
+struct aabb;
+struct sphere;
+struct plane;
+struct frustum;
+struct ray;
+struct versor_soa;
+struct sphere_soa;
+struct aabb_soa;
 
 // vector functions
 inline float length(vec2 v);
-inline float length2(vec2 v);
+constexpr float length2(vec2 v);
 inline vec2 normalise(vec2 v);
-inline float dot(vec2 a, vec2 b);
+constexpr float dot(vec2 a, vec2 b);
 
 inline float length(vec3 v);
-inline float length2(vec3 v);
+constexpr float length2(vec3 v);
 inline vec3 normalise(vec3 v);
-inline float dot(vec3 a, vec3 b);
-inline vec3 cross(vec3 a, vec3 b);
+constexpr float dot(vec3 a, vec3 b);
+constexpr vec3 cross(vec3 a, vec3 b);
 
 // matrix functions
 // inline mat3 identity_mat3();
-inline mat4 identity_mat4();
-inline float determinant(mat4 mm);
+constexpr mat4 identity_mat4();
+constexpr float determinant(mat4 mm);
 inline mat4 inverse(mat4 mm);
-inline mat4 transpose(mat4 mm);
+inline mat4 inverse_reference(mat4 mm);
+constexpr mat4 transpose(mat4 mm);
+constexpr mat3x4 mat4_to_mat3x4(mat4 mm);
+
+// affine 3x4 functions
+constexpr mat3x4 identity_mat3x4();
+constexpr mat4 mat3x4_to_mat4(mat3x4 a);
+constexpr mat3x4 trs_mat3x4(vec3 translation, versor rotation, vec3 scale);
+constexpr vec3 transform_point(mat3x4 a, vec3 p);
+constexpr vec3 transform_vector(mat3x4 a, vec3 v);
+inline mat3x4 affine_inverse(mat3x4 a);
+constexpr mat3x4 rigid_inverse(mat3x4 a);
 
 // affine functions
-inline mat4 translate(mat4 m, vec3 v);
+constexpr mat4 translate(mat4 m, vec3 v);
 inline mat4 rotate_x_deg(mat4 m, float deg);
 inline mat4 rotate_x_deg_mat4(float deg);
 inline mat4 rotate_y_deg(mat4 m, float deg);
@@ -86,24 +378,61 @@ inline mat4 rotate_z_deg_mat4(float deg);
 inline mat4 rotate_axis_deg_mat4(vec3 u, float deg);
 inline mat4 rotate_align_mat4(vec3 u1, vec3 u2);
 inline mat4 scale(mat4 m, vec3 v);
-inline mat4 scale_mat4(vec3 v);
+constexpr mat4 scale_mat4(vec3 v);
 inline mat4 scale(mat4 m, float s);
 
 // camera functions
 inline mat4 look_at(vec3 cam_pos, vec3 target_pos, vec3 up);
-inline mat4 orthographic(float left, float right, float bottom, float top, float near_z, float far_z);
+constexpr mat4 orthographic(float left, float right, float bottom, float top, float near_z, float far_z);
 inline mat4 perspective(float fov, float aspect_ratio, float near_z, float far_z);
 
 // quaternion functions
 inline versor quat_from_axis_rad(float radians, float x, float y, float z);
 inline versor quat_from_axis_deg(float degrees, float x, float y, float z);
 inline versor quat_from_axis_deg(float degrees, vec3 a);
-inline mat4 quat_to_mat4(versor q);
-inline float dot(versor q, versor r);
+constexpr mat4 quat_to_mat4(versor q);
+inline versor mat4_to_quat(mat4 m);
+inline dual_quat mat4_to_dual_quat(mat4 m);
+constexpr float dot(versor q, versor r);
 inline versor slerp(versor q, versor r);
 inline versor normalise(versor q);
-inline float dot(versor q, versor r);
+constexpr float dot(versor q, versor r);
 inline versor slerp(versor& q, versor& r, float t);
+inline versor slerp_fast(versor q, versor r, float t);
+constexpr versor conjugate(versor q);
+constexpr vec3 quat_rotate(versor q, vec3 v);
+
+// transform functions
+constexpr transform identity_transform();
+constexpr mat3x4 transform_to_mat3x4(transform t);
+constexpr vec3 transform_point(transform t, vec3 p);
+inline transform inverse(transform t);
+
+// geometry functions
+inline plane normalise(plane p);
+constexpr float signed_distance(plane p, vec3 point);
+inline frustum frustum_from_matrix(const mat4& view_proj);
+constexpr bool sphere_in_frustum(const frustum& f, sphere s);
+constexpr bool aabb_in_frustum(const frustum& f, const aabb& box);
+constexpr bool aabbs_overlap(const aabb& a, const aabb& b);
+inline float ray_hits_aabb(ray r, const aabb& box);
+
+// batch functions
+inline void transform_points(const mat4& m, const vec3* in, vec3* out, size_t n);
+inline void transform_normals(const mat4& m, const vec3* in, vec3* out, size_t n);
+inline void transform_points_soa(const mat4& m, const float* in_x, const float* in_y, const float* in_z,
+                                 float* out_x, float* out_y, float* out_z, size_t n);
+inline void mul_mat4_array(const mat4* a, const mat4* b, mat4* out, size_t n);
+inline void aabb_transform_array(const mat4& m, const aabb* in, aabb* out, size_t n);
+inline void nlerp_batch(const versor_soa& a, const versor_soa& b, const float* t, const versor_soa& out, size_t n);
+inline void slerp_batch(const versor_soa& a, const versor_soa& b, const float* t, const versor_soa& out, size_t n);
+inline void normalise_soa(const float* in_x, const float* in_y, const float* in_z,
+                          float* out_x, float* out_y, float* out_z, size_t n);
+inline void normalise_batch(const versor_soa& q, const versor_soa& out, size_t n);
+inline void spheres_in_frustum(const frustum& f, const sphere_soa& spheres, bool* out_visible, size_t n);
+inline void aabbs_in_frustum(const frustum& f, const aabb_soa& boxes, bool* out_visible, size_t n);
+inline void aabbs_overlap_batch(const aabb& box, const aabb_soa& boxes, bool* out_overlap, size_t n);
+inline void ray_hits_aabbs(ray r, const aabb_soa& boxes, float* out_t, size_t n);
 
 // print functions
 inline void print(vec2 v);
@@ -190,10 +519,96 @@ struct mat4 {
 	*/
 };
 
+// Top three rows of an affine mat4 (bottom row is implicitly 0 0 0 1)
+struct mat3x4 {
+	float m[12];
+	/* note: stored in ROWS, so each row is one vec4 (handy for packing into GPU buffers):
+		0  1  2  3
+		4  5  6  7
+		8  9 10 11
+	*/
+};
+
 struct versor {
 	float q[4];
 };
 
+// Rigid transform (rotation + translation) as a dual quaternion: real + epsilon*dual
+struct dual_quat {
+	versor real;
+	versor dual;
+};
+
+// Position, rotation and scale, applied scale first then rotation then translation
+struct transform {
+	vec3 pos;
+	versor rot;
+	vec3 scale;
+};
+
+// Axis-aligned bounding box
+struct aabb {
+	vec3 min;
+	vec3 max;
+};
+
+struct sphere {
+	vec3 centre;
+	float radius;
+};
+
+// Points p where dot(normal, p) + d = 0. With a unit length normal, dot(normal, p) + d is p's distance
+// in front of the plane (negative behind it)
+struct plane {
+	vec3 normal;
+	float d;
+};
+
+// Planes facing inwards, so a point is inside if it's in front of all six
+enum {
+	FRUSTUM_LEFT,
+	FRUSTUM_RIGHT,
+	FRUSTUM_BOTTOM,
+	FRUSTUM_TOP,
+	FRUSTUM_NEAR,
+	FRUSTUM_FAR,
+	FRUSTUM_NUM_PLANES
+};
+struct frustum {
+	plane planes[FRUSTUM_NUM_PLANES];
+};
+
+// Points origin + t * dir for t >= 0. dir needn't be unit length, t is then in multiples of it
+struct ray {
+	vec3 origin;
+	vec3 dir;
+};
+
+// Quaternions stored as four separate arrays (one per component), for the batch functions
+struct versor_soa {
+	float* w;
+	float* x;
+	float* y;
+	float* z;
+};
+
+// Spheres and boxes stored one array per component, for the batch intersection functions
+struct sphere_soa {
+	float* x;
+	float* y;
+	float* z;
+	float* radius;
+};
+
+struct aabb_soa {
+	float* min_x;
+	float* min_y;
+	float* min_z;
+	float* max_x;
+	float* max_y;
+	float* max_z;
+};
+
 //------------------------------------------------------------------------------
 #ifdef __GNUC__
 #pragma GCC diagnostic pop
@@ -212,53 +627,53 @@ struct versor {
 //------------------------------------------------------------------------------
 
 // vec2
-inline vec2 operator+ (vec2 lhs, vec2 rhs) {
-	vec2 result;
+constexpr vec2 operator+ (vec2 lhs, vec2 rhs) {
+	vec2 result = {};
 	result.x = lhs.x + rhs.x;
 	result.y = lhs.y + rhs.y;
 	return result;
 }
-inline vec2 operator- (vec2 lhs, vec2 rhs) {
-	vec2 result;
+constexpr vec2 operator- (vec2 lhs, vec2 rhs) {
+	vec2 result = {};
 	result.x = lhs.x - rhs.x;
 	result.y = lhs.y - rhs.y;
 	return result;
 }
-inline vec2 operator* (vec2 lhs, float rhs) {
-	vec2 result;
+constexpr vec2 operator* (vec2 lhs, float rhs) {
+	vec2 result = {};
 	result.x = lhs.x * rhs;
 	result.y = lhs.y * rhs;
 	return result;
 }
-inline vec2 operator* (float lhs, vec2 rhs) {
-	vec2 result;
+constexpr vec2 operator* (float lhs, vec2 rhs) {
+	vec2 result = {};
 	result.x = rhs.x * lhs;
 	result.y = rhs.y * lhs;
 	return result;
 }
-inline vec2 operator/ (vec2 lhs, float rhs) {
-	vec2 result;
+constexpr vec2 operator/ (vec2 lhs, float rhs) {
+	vec2 result = {};
 	result.x = lhs.x / rhs;
 	result.y = lhs.y / rhs;
 	return result;
 }
-inline vec2 operator+= (vec2& lhs, vec2 rhs) {
+constexpr vec2 operator+= (vec2& lhs, vec2 rhs) {
 	lhs.x += rhs.x;
 	lhs.y += rhs.y;
 	return lhs;
 }
-inline vec2 operator-= (vec2& lhs, vec2 rhs) {
+constexpr vec2 operator-= (vec2& lhs, vec2 rhs) {
 	lhs.x -= rhs.x;
 	lhs.y -= rhs.y;
 	return lhs;
 }
-inline vec2 operator*= (vec2& lhs, float rhs) {
+constexpr vec2 operator*= (vec2& lhs, float rhs) {
 	lhs.x *= rhs;
 	lhs.y *= rhs;
 	return lhs;
 }
-inline vec2 operator- (vec2 rhs) {
-	vec2 result;
+constexpr vec2 operator- (vec2 rhs) {
+	vec2 result = {};
 	result.x = -rhs.x;
 	result.y = -rhs.y;
 	return result;
@@ -269,61 +684,61 @@ inline bool operator== (vec2 lhs, vec2 rhs) {
 }
 
 // vec3
-inline vec3 operator+ (vec3 lhs, vec3 rhs) {
-	vec3 result;
+constexpr vec3 operator+ (vec3 lhs, vec3 rhs) {
+	vec3 result = {};
 	result.x = lhs.x + rhs.x;
 	result.y = lhs.y + rhs.y;
 	result.z = lhs.z + rhs.z;
 	return result;
 }
-inline vec3 operator- (vec3 lhs, vec3 rhs) {
-	vec3 result;
+constexpr vec3 operator- (vec3 lhs, vec3 rhs) {
+	vec3 result = {};
 	result.x = lhs.x - rhs.x;
 	result.y = lhs.y - rhs.y;
 	result.z = lhs.z - rhs.z;
 	return result;
 }
-inline vec3 operator* (vec3 lhs, float rhs) {
-	vec3 result;
+constexpr vec3 operator* (vec3 lhs, float rhs) {
+	vec3 result = {};
 	result.x = lhs.x * rhs;
 	result.y = lhs.y * rhs;
 	result.z = lhs.z * rhs;
 	return result;
 }
-inline vec3 operator* (float lhs, vec3 rhs) {
-	vec3 result;
+constexpr vec3 operator* (float lhs, vec3 rhs) {
+	vec3 result = {};
 	result.x = rhs.x * lhs;
 	result.y = rhs.y * lhs;
 	result.z = rhs.z * lhs;
 	return result;
 }
-inline vec3 operator/ (vec3 lhs, float rhs) {
-	vec3 result;
+constexpr vec3 operator/ (vec3 lhs, float rhs) {
+	vec3 result = {};
 	result.x = lhs.x / rhs;
 	result.y = lhs.y / rhs;
 	result.z = lhs.z / rhs;
 	return result;
 }
-inline vec3 operator+= (vec3& lhs, vec3 rhs) {
+constexpr vec3 operator+= (vec3& lhs, vec3 rhs) {
 	lhs.x += rhs.x;
 	lhs.y += rhs.y;
 	lhs.z += rhs.z;
 	return lhs;
 }
-inline vec3 operator-= (vec3& lhs, vec3 rhs) {
+constexpr vec3 operator-= (vec3& lhs, vec3 rhs) {
 	lhs.x -= rhs.x;
 	lhs.y -= rhs.y;
 	lhs.z -= rhs.z;
 	return lhs;
 }
-inline vec3 operator*= (vec3& lhs, float rhs) {
+constexpr vec3 operator*= (vec3& lhs, float rhs) {
 	lhs.x *= rhs;
 	lhs.y *= rhs;
 	lhs.z *= rhs;
 	return lhs;
 }
-inline vec3 operator- (vec3 rhs) {
-	vec3 result;
+constexpr vec3 operator- (vec3 rhs) {
+	vec3 result = {};
 	result.x = -rhs.x;
 	result.y = -rhs.y;
 	result.z = -rhs.z;
@@ -335,32 +750,32 @@ inline bool operator== (vec3 lhs, vec3 rhs) {
 }
 
 //vec4
-inline vec4 operator+ (vec4 lhs, vec4 rhs) {
-	vec4 result;
+constexpr vec4 operator+ (vec4 lhs, vec4 rhs) {
+	vec4 result = {};
 	result.x = lhs.x + rhs.x;
 	result.y = lhs.y + rhs.y;
 	result.z = lhs.z + rhs.z;
 	result.w = lhs.w + rhs.w;
 	return result;
 }
-inline vec4 operator- (vec4 lhs, vec4 rhs) {
-	vec4 result;
+constexpr vec4 operator- (vec4 lhs, vec4 rhs) {
+	vec4 result = {};
 	result.x = lhs.x - rhs.x;
 	result.y = lhs.y - rhs.y;
 	result.z = lhs.z - rhs.z;
 	result.w = lhs.w - rhs.w;
 	return result;
 }
-inline vec4 operator* (vec4 lhs, float rhs) {
-	vec4 result;
+constexpr vec4 operator* (vec4 lhs, float rhs) {
+	vec4 result = {};
 	result.x = lhs.x * rhs;
 	result.y = lhs.y * rhs;
 	result.z = lhs.z * rhs;
 	result.w = lhs.w * rhs;
 	return result;
 }
-inline vec4 operator* (float lhs, vec4 rhs) {
-	vec4 result;
+constexpr vec4 operator* (float lhs, vec4 rhs) {
+	vec4 result = {};
 	result.x = rhs.x * lhs;
 	result.y = rhs.y * lhs;
 	result.z = rhs.z * lhs;
@@ -369,8 +784,8 @@ inline vec4 operator* (float lhs, vec4 rhs) {
 }
 
 // mat3
-inline vec3 operator* (mat3 lhs, vec3 rhs) {
-	vec3 result;
+constexpr vec3 operator* (mat3 lhs, vec3 rhs) {
+	vec3 result = {};
 	// 0x + 3y + 6z
 	result.x =
 		lhs.m[0] * rhs.x +
@@ -390,8 +805,9 @@ inline vec3 operator* (mat3 lhs, vec3 rhs) {
 }
 
 //mat4
-inline vec4 operator* (mat4 lhs, vec4 rhs) {
-	vec4 result;
+// Scalar versions of the SIMD operators below, used when there's no SIMD and for checking the SIMD paths
+constexpr vec4 mat4_mul_vec4_reference(mat4 lhs, vec4 rhs) {
+	vec4 result = {};
 	// 0x + 4y + 8z + 12w
 	result.x =
 		lhs.m[0] * rhs.x +
@@ -418,7 +834,7 @@ inline vec4 operator* (mat4 lhs, vec4 rhs) {
 		lhs.m[15] * rhs.w;
 	return result;
 }
-inline mat4 operator* (mat4 lhs, mat4 rhs) {
+constexpr mat4 mat4_mul_reference(mat4 lhs, mat4 rhs) {
 	mat4 result = {};
 	int r_index = 0;
 	for(int col = 0; col < 4; ++col) {
@@ -432,21 +848,102 @@ inline mat4 operator* (mat4 lhs, mat4 rhs) {
 	}
 	return result;
 }
-inline mat4 operator* (mat4 lhs, float rhs) {
+
+// Each column of the result is the columns of lhs weighted by a column of rhs
+inline vec4 operator* (mat4 lhs, vec4 rhs) {
+#if GAMEMATHS_SSE
+	__m128 v = _mm_loadu_ps(rhs.v);
+	__m128 result = _mm_mul_ps(_mm_loadu_ps(&lhs.m[0]), _gm_splat_ps(v, 0));
+	result = _gm_madd_ps(_mm_loadu_ps(&lhs.m[4]), _gm_splat_ps(v, 1), result);
+	result = _gm_madd_ps(_mm_loadu_ps(&lhs.m[8]), _gm_splat_ps(v, 2), result);
+	result = _gm_madd_ps(_mm_loadu_ps(&lhs.m[12]), _gm_splat_ps(v, 3), result);
+	vec4 out;
+	_mm_storeu_ps(out.v, result);
+	return out;
+#else
+	return mat4_mul_vec4_reference(lhs, rhs);
+#endif
+}
+inline mat4 operator* (mat4 lhs, mat4 rhs) {
+#if GAMEMATHS_AVX
+	// Two columns of the result at a time: each 128-bit half of a 256-bit register is one column
+	__m256 l0 = _mm256_broadcast_ps((const __m128*)&lhs.m[0]);
+	__m256 l1 = _mm256_broadcast_ps((const __m128*)&lhs.m[4]);
+	__m256 l2 = _mm256_broadcast_ps((const __m128*)&lhs.m[8]);
+	__m256 l3 = _mm256_broadcast_ps((const __m128*)&lhs.m[12]);
+	mat4 result;
+	for(int col = 0; col < 4; col += 2) {
+		__m256 r = _mm256_loadu_ps(&rhs.m[4 * col]);
+		__m256 sum = _mm256_mul_ps(l0, _mm256_permute_ps(r, _MM_SHUFFLE(0, 0, 0, 0)));
+		sum = _gm_madd256_ps(l1, _mm256_permute_ps(r, _MM_SHUFFLE(1, 1, 1, 1)), sum);
+		sum = _gm_madd256_ps(l2, _mm256_permute_ps(r, _MM_SHUFFLE(2, 2, 2, 2)), sum);
+		sum = _gm_madd256_ps(l3, _mm256_permute_ps(r, _MM_SHUFFLE(3, 3, 3, 3)), sum);
+		_mm256_storeu_ps(&result.m[4 * col], sum);
+	}
+	return result;
+#elif GAMEMATHS_SSE
+	__m128 l0 = _mm_loadu_ps(&lhs.m[0]);
+	__m128 l1 = _mm_loadu_ps(&lhs.m[4]);
+	__m128 l2 = _mm_loadu_ps(&lhs.m[8]);
+	__m128 l3 = _mm_loadu_ps(&lhs.m[12]);
+	mat4 result;
+	for(int col = 0; col < 4; ++col) {
+		__m128 r = _mm_loadu_ps(&rhs.m[4 * col]);
+		__m128 sum = _mm_mul_ps(l0, _gm_splat_ps(r, 0));
+		sum = _gm_madd_ps(l1, _gm_splat_ps(r, 1), sum);
+		sum = _gm_madd_ps(l2, _gm_splat_ps(r, 2), sum);
+		sum = _gm_madd_ps(l3, _gm_splat_ps(r, 3), sum);
+		_mm_storeu_ps(&result.m[4 * col], sum);
+	}
+	return result;
+#else
+	return mat4_mul_reference(lhs, rhs);
+#endif
+}
+// mat3x4: composes like the mat4s they stand for, lhs applied last. Rows are
+// (r0 r1 r2 t), so each row of the result is the rows of rhs weighted by a row of lhs, plus lhs's translation
+inline mat3x4 operator* (mat3x4 lhs, mat3x4 rhs) {
+	mat3x4 result;
+#if GAMEMATHS_SSE
+	__m128 r0 = _mm_loadu_ps(&rhs.m[0]);
+	__m128 r1 = _mm_loadu_ps(&rhs.m[4]);
+	__m128 r2 = _mm_loadu_ps(&rhs.m[8]);
+	__m128 w_mask = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1));
+	for(int row = 0; row < 3; ++row) {
+		__m128 l = _mm_loadu_ps(&lhs.m[4 * row]);
+		__m128 sum = _mm_and_ps(_gm_splat_ps(l, 3), w_mask);
+		sum = _gm_madd_ps(_gm_splat_ps(l, 0), r0, sum);
+		sum = _gm_madd_ps(_gm_splat_ps(l, 1), r1, sum);
+		sum = _gm_madd_ps(_gm_splat_ps(l, 2), r2, sum);
+		_mm_storeu_ps(&result.m[4 * row], sum);
+	}
+#else
+	for(int row = 0; row < 3; ++row) {
+		const float* l = &lhs.m[4 * row];
+		for(int col = 0; col < 4; ++col) {
+			result.m[4 * row + col] = l[0] * rhs.m[col] + l[1] * rhs.m[4 + col] + l[2] * rhs.m[8 + col];
+		}
+		result.m[4 * row + 3] += l[3];
+	}
+#endif
+	return result;
+}
+
+constexpr mat4 operator* (mat4 lhs, float rhs) {
 	mat4 result = lhs;
 	for(int i = 0; i < 16; ++i) {
 		result.m[i] *= rhs;
 	}
 	return result;
 }
-inline mat4 operator+ (mat4 lhs, mat4 rhs) {
+constexpr mat4 operator+ (mat4 lhs, mat4 rhs) {
 	mat4 result = lhs;
 	for(int i = 0; i < 16; ++i) {
 		result.m[i] += rhs.m[i];
 	}
 	return result;
 }
-inline bool operator== (mat4 lhs, mat4 rhs) {
+constexpr bool operator== (mat4 lhs, mat4 rhs) {
 	for(int i = 0; i < 16; ++i) {
 		if(lhs.m[i] != rhs.m[i])
 			return false;
@@ -455,16 +952,16 @@ inline bool operator== (mat4 lhs, mat4 rhs) {
 }
 
 // versor
-inline versor operator* (versor lhs, float rhs) {
-	versor result;
+constexpr versor operator* (versor lhs, float rhs) {
+	versor result = {};
 	result.q[0] = lhs.q[0] * rhs;
 	result.q[1] = lhs.q[1] * rhs;
 	result.q[2] = lhs.q[2] * rhs;
 	result.q[3] = lhs.q[3] * rhs;
 	return result;
 }
-inline versor operator* (float lhs, versor rhs) {
-	versor result;
+constexpr versor operator* (float lhs, versor rhs) {
+	versor result = {};
 	result.q[0] = rhs.q[0] * lhs;
 	result.q[1] = rhs.q[1] * lhs;
 	result.q[2] = rhs.q[2] * lhs;
@@ -484,8 +981,8 @@ inline versor operator* (versor lhs, versor rhs) {
 	// re-normalise in case of mangling
 	return normalise(result);
 }
-inline versor operator/ (versor lhs, float rhs) {
-	versor result;
+constexpr versor operator/ (versor lhs, float rhs) {
+	versor result = {};
 	result.q[0] = lhs.q[0] / rhs;
 	result.q[1] = lhs.q[1] / rhs;
 	result.q[2] = lhs.q[2] / rhs;
@@ -522,7 +1019,7 @@ inline versor operator*= (versor& lhs, versor rhs) {
 	lhs = lhs * rhs;
 	return lhs;
 }
-inline versor operator- (versor rhs) {
+constexpr versor operator- (versor rhs) {
 	versor result = rhs*(-1);
 	return result;
 }
@@ -532,18 +1029,18 @@ inline versor operator- (versor rhs) {
 inline float length(vec2 v) {
 	return sqrtf((v.x * v.x) + (v.y * v.y));
 }
-inline float length2(vec2 v) {
+constexpr float length2(vec2 v) {
 	return ((v.x * v.x) + (v.y * v.y));
 }
 inline vec2 normalise(vec2 v) {
 	vec2 result = {};
 	float len_squared = length2(v);
-	if(len_squared != 0.0f) {
-		result = v / sqrtf(len_squared);
+	if(len_squared > 0.0f) {
+		result = v * inv_sqrtf_any(len_squared);
 	}
 	return result;
 }
-inline float dot(vec2 a, vec2 b) {
+constexpr float dot(vec2 a, vec2 b) {
 	return ((a.x * b.x) + (a.y * b.y));
 }
 
@@ -551,22 +1048,22 @@ inline float dot(vec2 a, vec2 b) {
 inline float length(vec3 v) {
 	return sqrtf((v.x * v.x) + (v.y * v.y) + (v.z * v.z));
 }
-inline float length2(vec3 v) {
+constexpr float length2(vec3 v) {
 	return ((v.x * v.x) + (v.y * v.y) + (v.z * v.z));
 }
 inline vec3 normalise(vec3 v) {
 	vec3 result = {};
 	float len_squared = length2(v);
-	if(len_squared != 0.0f) {
-		result = v / sqrtf(len_squared);
+	if(len_squared > 0.0f) {
+		result = v * inv_sqrtf_any(len_squared);
 	}
 	return result;
 }
-inline float dot(vec3 a, vec3 b) {
+constexpr float dot(vec3 a, vec3 b) {
 	return ((a.x * b.x) + (a.y * b.y) + (a.z * b.z));
 }
-inline vec3 cross(vec3 a, vec3 b) {
-	vec3 result;
+constexpr vec3 cross(vec3 a, vec3 b) {
+	vec3 result = {};
 	result.x = ((a.y * b.z) - (a.z * b.y));
 	result.y = ((a.z * b.x) - (a.x * b.z));
 	result.z = ((a.x * b.y) - (a.y * b.x));
@@ -584,7 +1081,7 @@ inline mat3 identity_mat3() {
 }
 */
 
-inline mat4 identity_mat4() {
+constexpr mat4 identity_mat4() {
 	return mat4 {
 		1.0f, 0.0f, 0.0f, 0.0f, 
 		0.0f, 1.0f, 0.0f, 0.0f, 
@@ -593,7 +1090,7 @@ inline mat4 identity_mat4() {
 	};
 }
 
-inline mat3 mat4_to_mat3(mat4 RTS){
+constexpr mat3 mat4_to_mat3(mat4 RTS){
 	//Grab R and S from RTS matrix
 	mat3 result = {
 		RTS.m[0], RTS.m[1], RTS.m[2],
@@ -605,7 +1102,7 @@ inline mat3 mat4_to_mat3(mat4 RTS){
 
 // returns a scalar value with the determinant for a 4x4 matrix
 // see http://www.euclideanspace.com/maths/algebra/matrix/functions/determinant/fourD/index.htm
-inline float determinant(mat4 mm) {
+constexpr float determinant(mat4 mm) {
 	return
 		mm.m[12] * mm.m[9] * mm.m[6] * mm.m[3] -
 		mm.m[8] * mm.m[13] * mm.m[6] * mm.m[3] -
@@ -635,7 +1132,7 @@ inline float determinant(mat4 mm) {
 
 /* returns a 16-element array that is the inverse of a 16-element array (4x4
 matrix). see http://www.euclideanspace.com/maths/algebra/matrix/functions/inverse/fourD/index.htm */
-inline mat4 inverse(mat4 mm) {
+inline mat4 inverse_reference(mat4 mm) {
 	float det = determinant(mm);
 	
 	if(det == 0.0f) {
@@ -728,8 +1225,90 @@ inline mat4 inverse(mat4 mm) {
 	};
 }
 
+#if GAMEMATHS_SSE
+// 2x2 matrices packed into one register as (a b c d) = | a b |
+//                                                     | c d |
+// a * b
+inline __m128 _gm_mat2_mul(__m128 a, __m128 b) {
+	return _mm_add_ps(_mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 3, 0))),
+	                  _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 2, 1, 2))));
+}
+// adjugate(a) * b
+inline __m128 _gm_mat2_adj_mul(__m128 a, __m128 b) {
+	return _mm_sub_ps(_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 3, 3)), b),
+	                  _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 1, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 0, 3, 2))));
+}
+// a * adjugate(b)
+inline __m128 _gm_mat2_mul_adj(__m128 a, __m128 b) {
+	return _mm_sub_ps(_mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 3, 0, 3))),
+	                  _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 2, 1, 2))));
+}
+#endif
+
+// General 4x4 inverse, same results as inverse_reference() to within rounding.
+// Works on the matrix as 4 2x2 blocks | A B |, see https://lxjk.github.io/2017/09/03/Fast-4x4-Matrix-Inverse-with-SSE-SIMD-Explained.html
+//                                     | C D |
+// Inverting the transpose gives the transpose of the inverse, so it doesn't matter that mat4 is stored in columns
+inline mat4 inverse(mat4 mm) {
+#if GAMEMATHS_SSE
+	__m128 c0 = _mm_loadu_ps(&mm.m[0]);
+	__m128 c1 = _mm_loadu_ps(&mm.m[4]);
+	__m128 c2 = _mm_loadu_ps(&mm.m[8]);
+	__m128 c3 = _mm_loadu_ps(&mm.m[12]);
+	__m128 a = _mm_movelh_ps(c0, c1);
+	__m128 b = _mm_movehl_ps(c1, c0);
+	__m128 c = _mm_movelh_ps(c2, c3);
+	__m128 d = _mm_movehl_ps(c3, c2);
+
+	// Determinants of the blocks as (|A| |B| |C| |D|)
+	__m128 block_dets = _mm_sub_ps(
+		_mm_mul_ps(_mm_shuffle_ps(c0, c2, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(c1, c3, _MM_SHUFFLE(3, 1, 3, 1))),
+		_mm_mul_ps(_mm_shuffle_ps(c0, c2, _MM_SHUFFLE(3, 1, 3, 1)), _mm_shuffle_ps(c1, c3, _MM_SHUFFLE(2, 0, 2, 0))));
+	__m128 det_a = _gm_splat_ps(block_dets, 0);
+	__m128 det_b = _gm_splat_ps(block_dets, 1);
+	__m128 det_c = _gm_splat_ps(block_dets, 2);
+	__m128 det_d = _gm_splat_ps(block_dets, 3);
+
+	// inverse = 1/|M| * | X Y |, each block worked out as its adjugate
+	//                   | Z W |
+	__m128 d_c = _gm_mat2_adj_mul(d, c);
+	__m128 a_b = _gm_mat2_adj_mul(a, b);
+	__m128 x = _mm_sub_ps(_mm_mul_ps(det_d, a), _gm_mat2_mul(b, d_c));
+	__m128 w = _mm_sub_ps(_mm_mul_ps(det_a, d), _gm_mat2_mul(c, a_b));
+	__m128 y = _mm_sub_ps(_mm_mul_ps(det_b, c), _gm_mat2_mul_adj(d, a_b));
+	__m128 z = _mm_sub_ps(_mm_mul_ps(det_c, b), _gm_mat2_mul_adj(a, d_c));
+
+	// |M| = |A||D| + |B||C| - trace((A#B)(D#C))
+	__m128 trace = _mm_mul_ps(a_b, _mm_shuffle_ps(d_c, d_c, _MM_SHUFFLE(3, 1, 2, 0)));
+	trace = _mm_add_ps(trace, _mm_shuffle_ps(trace, trace, _MM_SHUFFLE(1, 0, 3, 2)));
+	trace = _mm_add_ps(trace, _mm_shuffle_ps(trace, trace, _MM_SHUFFLE(2, 3, 0, 1)));
+	__m128 det = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(det_a, det_d), _mm_mul_ps(det_b, det_c)), trace);
+
+	if(_mm_cvtss_f32(det) == 0.0f) {
+		fprintf(stderr, "WARNING. matrix has no determinant. can not invert\n");
+		return mm;
+	}
+	// Signs of the adjugate of each 2x2 block
+	__m128 inv_det = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), det);
+	x = _mm_mul_ps(x, inv_det);
+	y = _mm_mul_ps(y, inv_det);
+	z = _mm_mul_ps(z, inv_det);
+	w = _mm_mul_ps(w, inv_det);
+
+	// Take the adjugates and put the blocks back in place
+	mat4 result;
+	_mm_storeu_ps(&result.m[0], _mm_shuffle_ps(x, y, _MM_SHUFFLE(1, 3, 1, 3)));
+	_mm_storeu_ps(&result.m[4], _mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 2, 0, 2)));
+	_mm_storeu_ps(&result.m[8], _mm_shuffle_ps(z, w, _MM_SHUFFLE(1, 3, 1, 3)));
+	_mm_storeu_ps(&result.m[12], _mm_shuffle_ps(z, w, _MM_SHUFFLE(0, 2, 0, 2)));
+	return result;
+#else
+	return inverse_reference(mm);
+#endif
+}
+
 // returns a 16-element array flipped on the main diagonal
-inline mat4 transpose(mat4 mm) {
+constexpr mat4 transpose(mat4 mm) {
 	return mat4 {
 		mm.m[0], mm.m[4], mm.m[8], mm.m[12],
 		mm.m[1], mm.m[5], mm.m[9], mm.m[13],
@@ -738,9 +1317,18 @@ inline mat4 transpose(mat4 mm) {
 	};
 }
 
+// Drops the bottom row of an affine matrix and transposes the rest into rows
+constexpr mat3x4 mat4_to_mat3x4(mat4 mm) {
+	return mat3x4 {
+		mm.m[0], mm.m[4], mm.m[8], mm.m[12],
+		mm.m[1], mm.m[5], mm.m[9], mm.m[13],
+		mm.m[2], mm.m[6], mm.m[10], mm.m[14]
+	};
+}
+
 /*--------------------------AFFINE MATRIX FUNCTIONS---------------------------*/
 // Returns matrix m translated by [x, y, z]
-inline mat4 translate(mat4 m, vec3 v) {
+constexpr mat4 translate(mat4 m, vec3 v) {
 	mat4 result = m;
 	result.m[12] += v.x;
 	result.m[13] += v.y;
@@ -752,8 +1340,8 @@ inline mat4 translate(mat4 m, vec3 v) {
 inline mat4 rotate_x_deg(mat4 m, float deg) {
 	float rad = DEG2RAD(deg);
 	mat4 m_r = identity_mat4();
-	float sin_theta = sinf(rad);
-	float cos_theta = cosf(rad);
+	float sin_theta = hot_sinf(rad);
+	float cos_theta = hot_cosf(rad);
 	m_r.m[5] = cos_theta;
 	m_r.m[9] = -sin_theta;
 	m_r.m[6] = sin_theta;
@@ -765,8 +1353,8 @@ inline mat4 rotate_x_deg(mat4 m, float deg) {
 inline mat4 rotate_x_deg_mat4(float deg) {
 	float rad = DEG2RAD(deg);
 	mat4 result = identity_mat4();
-	float sin_theta = sinf(rad);
-	float cos_theta = cosf(rad);
+	float sin_theta = hot_sinf(rad);
+	float cos_theta = hot_cosf(rad);
 	result.m[5] = cos_theta;
 	result.m[9] = -sin_theta;
 	result.m[6] = sin_theta;
@@ -789,8 +1377,8 @@ inline mat4 rotate_y_rad(mat4 m, float rad)
 	d h l p
 	*/
 	mat4 result = m;
-	float sin_theta = sinf(rad);
-	float cos_theta = cosf(rad);
+	float sin_theta = hot_sinf(rad);
+	float cos_theta = hot_cosf(rad);
 
 	vec4 row0 = {result.m[0], result.m[4], result.m[8], result.m[12]}; // a e i m
 	vec4 row2 = {result.m[2], result.m[6], result.m[10], result.m[14]}; // c g k o
@@ -828,8 +1416,8 @@ inline mat4 rotate_y_deg(mat4 m, float deg)
 inline mat4 rotate_y_deg_mat4(float deg) {
 	float rad = DEG2RAD(deg);
 	mat4 result = identity_mat4();
-	float sin_theta = sinf(rad);
-	float cos_theta = cosf(rad);
+	float sin_theta = hot_sinf(rad);
+	float cos_theta = hot_cosf(rad);
 	result.m[0] = cos_theta;
 	result.m[8] = sin_theta;
 	result.m[2] = -sin_theta;
@@ -841,8 +1429,8 @@ inline mat4 rotate_y_deg_mat4(float deg) {
 inline mat4 rotate_z_deg(mat4 m, float deg) {
 	float rad = DEG2RAD(deg);
 	mat4 m_r = identity_mat4();
-	float sin_theta = sinf(rad);
-	float cos_theta = cosf(rad);
+	float sin_theta = hot_sinf(rad);
+	float cos_theta = hot_cosf(rad);
 	m_r.m[0] = cos_theta;
 	m_r.m[4] = -sin_theta;
 	m_r.m[1] = sin_theta;
@@ -854,8 +1442,8 @@ inline mat4 rotate_z_deg(mat4 m, float deg) {
 inline mat4 rotate_z_deg_mat4(float deg) {
 	float rad = DEG2RAD(deg);
 	mat4 result = identity_mat4();
-	float sin_theta = sinf(rad);
-	float cos_theta = cosf(rad);
+	float sin_theta = hot_sinf(rad);
+	float cos_theta = hot_cosf(rad);
 	result.m[0] = cos_theta;
 	result.m[4] = -sin_theta;
 	result.m[1] = sin_theta;
@@ -868,8 +1456,8 @@ inline mat4 rotate_z_deg_mat4(float deg) {
 inline mat4 rotate_axis_deg_mat4(vec3 u, float deg){
 	float rad = DEG2RAD(deg);
 
-	float sin_a = sinf(rad);
-	float cos_a = cosf(rad);
+	float sin_a = hot_sinf(rad);
+	float cos_a = hot_cosf(rad);
 	float inv_cos_a = 1.0f - cos_a;
 
 	return mat4 {
@@ -917,7 +1505,7 @@ inline mat4 rotate_align_mat4(vec3 u1, vec3 u2){
 }
 
 // Returns matrix to scale by [x, y, z]
-inline mat4 scale_mat4(vec3 v) {
+constexpr mat4 scale_mat4(vec3 v) {
 	mat4 result = {};
 	result.m[0] = v.x;
 	result.m[5] = v.y;
@@ -955,20 +1543,21 @@ inline mat4 look_at(vec3 cam_pos, vec3 target_pos, vec3 up) {
 	result.m[2] = -fwd.x;
 	result.m[6] = -fwd.y;
 	result.m[10] = -fwd.z;
-	result.m[12] = -cam_pos.x;
-	result.m[13] = -cam_pos.y;
-	result.m[14] = -cam_pos.z;
+	// Rotate the translation too, so cam_pos ends up at the origin
+	result.m[12] = -dot(rgt, cam_pos);
+	result.m[13] = -dot(up_act, cam_pos);
+	result.m[14] = dot(fwd, cam_pos);
 	/* result = {
-		Rx  Ry  Rz -Px
-		Uy  Uy  Uz -Py
-	   -Fx -Fy -Fz -Pz
+		Rx  Ry  Rz -R.P
+		Ux  Uy  Uz -U.P
+	   -Fx -Fy -Fz  F.P
 		0   0   0   1
 	} */
 	return result;
 }
 
 // Returns an orthographic projection matrix
-inline mat4 orthographic(float left, float right, float bottom, float top, float near_z, float far_z) {
+constexpr mat4 orthographic(float left, float right, float bottom, float top, float near_z, float far_z) {
 	mat4 result = identity_mat4(); 
 	result.m[0] = 2/(right-left);
 	result.m[5] = 2/(top-bottom);
@@ -999,8 +1588,8 @@ inline mat4 perspective(float fov, float aspect_ratio, float near_z, float far_z
 /*----------------------------HAMILTON IN DA HOUSE!---------------------------*/
 inline versor quat_from_axis_rad(float radians, float x, float y, float z) {
 	versor result;
-	float sin_half_theta = sinf(0.5f*radians);
-	result.q[0] = cosf(0.5f*radians);
+	float sin_half_theta = hot_sinf(0.5f*radians);
+	result.q[0] = hot_cosf(0.5f*radians);
 	result.q[1] = sin_half_theta * x;
 	result.q[2] = sin_half_theta * y;
 	result.q[3] = sin_half_theta * z;
@@ -1015,7 +1604,7 @@ inline versor quat_from_axis_deg(float degrees, vec3 xyz) {
 	return quat_from_axis_rad(DEG2RAD(degrees), xyz.x, xyz.y, xyz.z);
 }
 
-inline mat4 quat_to_mat4(versor q) {
+constexpr mat4 quat_to_mat4(versor q) {
 	float w = q.q[0];
 	float x = q.q[1];
 	float y = q.q[2];
@@ -1040,19 +1629,69 @@ inline mat4 quat_to_mat4(versor q) {
 	};
 }
 
+// Returns rotation part of m (which must not contain scale) as a quaternion
+// see http://www.euclideanspace.com/maths/geometry/rotations/conversions/matrixToQuaternion/index.htm
+inline versor mat4_to_quat(mat4 m) {
+	versor result;
+	float trace = m.m[0] + m.m[5] + m.m[10];
+	if(trace > 0.0f) {
+		float s = 2.0f * sqrtf(trace + 1.0f);
+		result.q[0] = 0.25f * s;
+		result.q[1] = (m.m[6] - m.m[9]) / s;
+		result.q[2] = (m.m[8] - m.m[2]) / s;
+		result.q[3] = (m.m[1] - m.m[4]) / s;
+	}
+	else if((m.m[0] > m.m[5]) && (m.m[0] > m.m[10])) {
+		float s = 2.0f * sqrtf(1.0f + m.m[0] - m.m[5] - m.m[10]);
+		result.q[0] = (m.m[6] - m.m[9]) / s;
+		result.q[1] = 0.25f * s;
+		result.q[2] = (m.m[4] + m.m[1]) / s;
+		result.q[3] = (m.m[8] + m.m[2]) / s;
+	}
+	else if(m.m[5] > m.m[10]) {
+		float s = 2.0f * sqrtf(1.0f + m.m[5] - m.m[0] - m.m[10]);
+		result.q[0] = (m.m[8] - m.m[2]) / s;
+		result.q[1] = (m.m[4] + m.m[1]) / s;
+		result.q[2] = 0.25f * s;
+		result.q[3] = (m.m[9] + m.m[6]) / s;
+	}
+	else {
+		float s = 2.0f * sqrtf(1.0f + m.m[10] - m.m[0] - m.m[5]);
+		result.q[0] = (m.m[1] - m.m[4]) / s;
+		result.q[1] = (m.m[8] + m.m[2]) / s;
+		result.q[2] = (m.m[9] + m.m[6]) / s;
+		result.q[3] = 0.25f * s;
+	}
+	return result;
+}
+
+// Returns rigid transform m (rotation and translation only!) as a dual quaternion
+inline dual_quat mat4_to_dual_quat(mat4 m) {
+	dual_quat result;
+	result.real = mat4_to_quat(m);
+	// dual = 0.5 * (0, t) * real
+	// Note: not using versor operator* because it re-normalises
+	float tx = m.m[12], ty = m.m[13], tz = m.m[14];
+	float w = result.real.q[0], x = result.real.q[1], y = result.real.q[2], z = result.real.q[3];
+	result.dual.q[0] = -0.5f * (tx * x + ty * y + tz * z);
+	result.dual.q[1] =  0.5f * (tx * w + ty * z - tz * y);
+	result.dual.q[2] =  0.5f * (ty * w + tz * x - tx * z);
+	result.dual.q[3] =  0.5f * (tz * w + tx * y - ty * x);
+	return result;
+}
+
+// Zero is left as zero, there's no rotation to scale back up
 inline versor normalise(versor q) {
 	versor result = q;
 	float mag_sq = (q.q[0] * q.q[0]) + (q.q[1] * q.q[1]) +
 				   (q.q[2] * q.q[2]) + (q.q[3] * q.q[3]);
-	
-	const float thresh = 0.0001f;
-	if(almost_equal(mag_sq, 1.0f, thresh)) {
-		result = result / sqrtf(mag_sq);
+	if(mag_sq > 0.0f) {
+		result = result * inv_sqrtf_any(mag_sq);
 	}
 	return result;
 }
 
-inline float dot(versor q, versor r) {
+constexpr float dot(versor q, versor r) {
 	return ((q.q[0] * r.q[0]) + (q.q[1] * r.q[1]) + (q.q[2] * r.q[2]) + (q.q[3] * r.q[3]));
 }
 
@@ -1082,15 +1721,827 @@ inline versor slerp(versor& q, versor& r, float t) {
 		}
 		return result;
 	}
-	float half_theta = acosf(cos_half_theta);
-	float a = sinf((1.0f - t) * half_theta) / sin_half_theta;
-	float b = sinf(t * half_theta) / sin_half_theta;
+	float half_theta = hot_acosf(cos_half_theta);
+	float a = hot_sinf((1.0f - t) * half_theta) / sin_half_theta;
+	float b = hot_sinf(t * half_theta) / sin_half_theta;
+	for(int i = 0; i < 4; ++i) {
+		result.q[i] = q.q[i] * a + r.q[i] * b;
+	}
+	return result;
+}
+
+// Approximate slerp: nlerp when q and r are close enough that it's within 1e-4 radians of slerp
+// (9.1e-5 at the threshold, before float rounding which slerp() suffers from just as much),
+// otherwise slerp with the fast_* trig functions. Doesn't modify q or r, result is unit length
+#define SLERP_FAST_NLERP_COS 0.99f // cos of the half angle between q and r below which it slerps
+
+inline versor slerp_fast(versor q, versor r, float t) {
+	float cos_half_theta = dot(q, r);
+	if(cos_half_theta < 0.0f) {
+		q = -q;
+		cos_half_theta = -cos_half_theta;
+	}
+	versor result;
+	if(cos_half_theta > SLERP_FAST_NLERP_COS) {
+		for(int i = 0; i < 4; ++i) {
+			result.q[i] = q.q[i] + t * (r.q[i] - q.q[i]);
+		}
+		return result * fast_inv_sqrtf(dot(result, result));
+	}
+	float half_theta = fast_acosf(cos_half_theta);
+	float inv_sin_half_theta = fast_inv_sqrtf(1.0f - cos_half_theta * cos_half_theta);
+	float a = fast_sinf((1.0f - t) * half_theta) * inv_sin_half_theta;
+	float b = fast_sinf(t * half_theta) * inv_sin_half_theta;
 	for(int i = 0; i < 4; ++i) {
 		result.q[i] = q.q[i] * a + r.q[i] * b;
 	}
 	return result;
 }
 
+// Inverse of a unit quaternion
+constexpr versor conjugate(versor q) {
+	return versor {q.q[0], -q.q[1], -q.q[2], -q.q[3]};
+}
+
+// Same as (quat_to_mat4(q) * vec4{v, 0}).xyz without building the matrix, q must be unit length
+constexpr vec3 quat_rotate(versor q, vec3 v) {
+	vec3 u = {q.q[1], q.q[2], q.q[3]};
+	vec3 uv = cross(u, v);
+	return v + 2.0f * (q.q[0] * uv + cross(u, uv));
+}
+
+/*-----------------------------TRANSFORM FUNCTIONS-----------------------------*/
+// transform is 40 bytes to mat4's 64 and is cheap to edit (move, turn, resize) without drifting
+// away from a rotation. Build a matrix from it only when one's needed, e.g. once per frame to draw.
+// Composing and inverting are exact for uniform scale, with non-uniform scale the result's
+// scale is per-axis and can't represent the shear a real matrix product would have.
+
+constexpr transform identity_transform() {
+	return transform {vec3{0, 0, 0}, versor{1, 0, 0, 0}, vec3{1, 1, 1}};
+}
+
+constexpr mat3x4 transform_to_mat3x4(transform t) {
+	return trs_mat3x4(t.pos, t.rot, t.scale);
+}
+
+constexpr vec3 transform_point(transform t, vec3 p) {
+	return t.pos + quat_rotate(t.rot, vec3{p.x * t.scale.x, p.y * t.scale.y, p.z * t.scale.z});
+}
+
+// lhs applied last, like multiplying the matrices
+inline transform operator* (transform lhs, transform rhs) {
+	transform result;
+	result.pos = transform_point(lhs, rhs.pos);
+	result.rot = lhs.rot * rhs.rot;
+	result.scale = vec3{lhs.scale.x * rhs.scale.x, lhs.scale.y * rhs.scale.y, lhs.scale.z * rhs.scale.z};
+	return result;
+}
+
+inline transform inverse(transform t) {
+	transform result;
+	result.rot = conjugate(t.rot);
+	result.scale = vec3{1.0f / t.scale.x, 1.0f / t.scale.y, 1.0f / t.scale.z};
+	vec3 p = quat_rotate(result.rot, -t.pos);
+	result.pos = vec3{p.x * result.scale.x, p.y * result.scale.y, p.z * result.scale.z};
+	return result;
+}
+
+/*---------------------------AFFINE 3X4 FUNCTIONS-----------------------------*/
+// mat3x4 as a transform in its own right: 12 floats instead of 16 and no work spent on the bottom row.
+// Build and combine transforms as mat3x4s and only turn them into mat4s to hand to GL
+
+constexpr mat3x4 identity_mat3x4() {
+	return mat3x4 {
+		1.0f, 0.0f, 0.0f, 0.0f,
+		0.0f, 1.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f
+	};
+}
+
+constexpr mat4 mat3x4_to_mat4(mat3x4 a) {
+	return mat4 {
+		a.m[0], a.m[4], a.m[8], 0.0f,
+		a.m[1], a.m[5], a.m[9], 0.0f,
+		a.m[2], a.m[6], a.m[10], 0.0f,
+		a.m[3], a.m[7], a.m[11], 1.0f
+	};
+}
+
+// Same as translate(quat_to_mat4(rotation) * scale_mat4(scale), translation), rotation must be unit length
+constexpr mat3x4 trs_mat3x4(vec3 translation, versor rotation, vec3 scale) {
+	float w = rotation.q[0];
+	float x = rotation.q[1];
+	float y = rotation.q[2];
+	float z = rotation.q[3];
+	return mat3x4 {
+		(1.0f - (2.0f * y * y) - (2.0f * z * z)) * scale.x,
+		((2.0f * x * y) - (2.0f * w * z)) * scale.y,
+		((2.0f * x * z) + (2.0f * w * y)) * scale.z,
+		translation.x,
+		((2.0f * x * y) + (2.0f * w * z)) * scale.x,
+		(1.0f - (2.0f * x * x) - (2.0f * z * z)) * scale.y,
+		((2.0f * y * z) - (2.0f * w * x)) * scale.z,
+		translation.y,
+		((2.0f * x * z) - (2.0f * w * y)) * scale.x,
+		((2.0f * y * z) + (2.0f * w * x)) * scale.y,
+		(1.0f - (2.0f * x * x) - (2.0f * y * y)) * scale.z,
+		translation.z
+	};
+}
+
+constexpr vec3 transform_point(mat3x4 a, vec3 p) {
+	return vec3 {
+		a.m[0] * p.x + a.m[1] * p.y + a.m[2] * p.z + a.m[3],
+		a.m[4] * p.x + a.m[5] * p.y + a.m[6] * p.z + a.m[7],
+		a.m[8] * p.x + a.m[9] * p.y + a.m[10] * p.z + a.m[11]
+	};
+}
+
+// Ignores translation
+constexpr vec3 transform_vector(mat3x4 a, vec3 v) {
+	return vec3 {
+		a.m[0] * v.x + a.m[1] * v.y + a.m[2] * v.z,
+		a.m[4] * v.x + a.m[5] * v.y + a.m[6] * v.z,
+		a.m[8] * v.x + a.m[9] * v.y + a.m[10] * v.z
+	};
+}
+
+// Inverse of any invertible affine transform (rotation, scale, shear and translation):
+// 3x3 inverse from cross products of the rows, then the translation undone with it
+inline mat3x4 affine_inverse(mat3x4 a) {
+	vec3 r0 = {a.m[0], a.m[1], a.m[2]};
+	vec3 r1 = {a.m[4], a.m[5], a.m[6]};
+	vec3 r2 = {a.m[8], a.m[9], a.m[10]};
+	vec3 c0 = cross(r1, r2); // columns of the inverse, times the determinant
+	vec3 c1 = cross(r2, r0);
+	vec3 c2 = cross(r0, r1);
+	float det = dot(r0, c0);
+	if(det == 0.0f) {
+		fprintf(stderr, "WARNING. matrix has no determinant. can not invert\n");
+		return a;
+	}
+	float inv_det = 1.0f / det;
+	c0 = c0 * inv_det;
+	c1 = c1 * inv_det;
+	c2 = c2 * inv_det;
+	vec3 t = {a.m[3], a.m[7], a.m[11]};
+	return mat3x4 {
+		c0.x, c1.x, c2.x, -(c0.x * t.x + c1.x * t.y + c2.x * t.z),
+		c0.y, c1.y, c2.y, -(c0.y * t.x + c1.y * t.y + c2.y * t.z),
+		c0.z, c1.z, c2.z, -(c0.z * t.x + c1.z * t.y + c2.z * t.z)
+	};
+}
+
+// Inverse of a rotation and translation only (no scale): transpose the rotation, rotate the translation back
+constexpr mat3x4 rigid_inverse(mat3x4 a) {
+	vec3 t = {a.m[3], a.m[7], a.m[11]};
+	return mat3x4 {
+		a.m[0], a.m[4], a.m[8], -(a.m[0] * t.x + a.m[4] * t.y + a.m[8] * t.z),
+		a.m[1], a.m[5], a.m[9], -(a.m[1] * t.x + a.m[5] * t.y + a.m[9] * t.z),
+		a.m[2], a.m[6], a.m[10], -(a.m[2] * t.x + a.m[6] * t.y + a.m[10] * t.z)
+	};
+}
+
+/*-----------------------------GEOMETRY FUNCTIONS-----------------------------*/
+// Scales the normal to unit length (and d with it) so signed_distance() is in world units
+inline plane normalise(plane p) {
+	plane result = p;
+	float len_squared = length2(p.normal);
+	if(len_squared > 0.0f) {
+		float inv_length = inv_sqrtf_any(len_squared);
+		result.normal = p.normal * inv_length;
+		result.d = p.d * inv_length;
+	}
+	return result;
+}
+
+// Positive in front of the plane (the side its normal points to)
+constexpr float signed_distance(plane p, vec3 point) {
+	return dot(p.normal, point) + p.d;
+}
+
+// Gribb/Hartmann: the clip space planes -w <= x, y, z <= w are sums/differences of view_proj's rows.
+// Pass P * V for world space planes, or P * V * M for planes in a model's space
+inline frustum frustum_from_matrix(const mat4& view_proj) {
+	const float* m = view_proj.m; // column major, row r of column c is m[4*c + r]
+	frustum result;
+	for(int axis = 0; axis < 3; ++axis) {
+		for(int side = 0; side < 2; ++side) {
+			float sign = side ? -1.0f : 1.0f; // -w <= x is w + x >= 0, x <= w is w - x >= 0
+			plane p;
+			p.normal = vec3{m[3] + sign * m[axis], m[7] + sign * m[4 + axis], m[11] + sign * m[8 + axis]};
+			p.d = m[15] + sign * m[12 + axis];
+			result.planes[2 * axis + side] = normalise(p);
+		}
+	}
+	return result;
+}
+
+// Conservative, like all the frustum tests: something just outside a corner of the frustum can
+// still count as inside, but something inside never counts as outside
+constexpr bool sphere_in_frustum(const frustum& f, sphere s) {
+	for(int i = 0; i < FRUSTUM_NUM_PLANES; ++i) {
+		if(signed_distance(f.planes[i], s.centre) < -s.radius) return false;
+	}
+	return true;
+}
+
+// Only the corner furthest along each plane's normal needs testing: if that's behind the plane, they all are
+constexpr bool aabb_in_frustum(const frustum& f, const aabb& box) {
+	for(int i = 0; i < FRUSTUM_NUM_PLANES; ++i) {
+		vec3 n = f.planes[i].normal;
+		vec3 corner = {(n.x > 0.0f) ? box.max.x : box.min.x,
+					   (n.y > 0.0f) ? box.max.y : box.min.y,
+					   (n.z > 0.0f) ? box.max.z : box.min.z};
+		if(signed_distance(f.planes[i], corner) < 0.0f) return false;
+	}
+	return true;
+}
+
+// Touching counts as overlapping
+constexpr bool aabbs_overlap(const aabb& a, const aabb& b) {
+	return (a.min.x <= b.max.x) && (b.min.x <= a.max.x) &&
+		   (a.min.y <= b.max.y) && (b.min.y <= a.max.y) &&
+		   (a.min.z <= b.max.z) && (b.min.z <= a.max.z);
+}
+
+// Slab test: t where r enters box (0 if it starts inside), INFINITY if it misses.
+// A 0 component in dir makes 1/dir infinite, so that axis' slab doesn't limit t unless the origin is outside it.
+// NaNs (origin exactly on a face that dir runs along) drop out of MIN/MAX, so grazing rays may count either way
+inline float ray_hits_aabb(ray r, const aabb& box) {
+	float t_min = 0.0f, t_max = INFINITY;
+	for(int axis = 0; axis < 3; ++axis) {
+		float inv_dir = 1.0f / r.dir.v[axis];
+		float t0 = (box.min.v[axis] - r.origin.v[axis]) * inv_dir;
+		float t1 = (box.max.v[axis] - r.origin.v[axis]) * inv_dir;
+		t_min = MAX(MIN(t0, t1), t_min);
+		t_max = MIN(MAX(t0, t1), t_max);
+	}
+	return (t_min <= t_max) ? t_min : INFINITY;
+}
+
+/*------------------------------BATCH FUNCTIONS-------------------------------*/
+// Same maths as looping over the single value operators, without the by-value copies of the matrix
+// per call and with the matrix kept in registers for the whole array.
+// m is treated as affine (bottom row 0 0 0 1), out may be the same array as in.
+
+#if GAMEMATHS_SSE
+inline void _gm_store_vec3(vec3* out, __m128 v) {
+	// Two stores so we never write past the end of out
+	_mm_storel_pi((__m64*)out->v, v);
+	_mm_store_ss(&out->z, _mm_movehl_ps(v, v));
+}
+#endif
+
+// out[i] = m * vec4(in[i], 1)
+inline void transform_points(const mat4& m, const vec3* in, vec3* out, size_t n) {
+#if GAMEMATHS_SSE
+	__m128 c0 = _mm_loadu_ps(&m.m[0]);
+	__m128 c1 = _mm_loadu_ps(&m.m[4]);
+	__m128 c2 = _mm_loadu_ps(&m.m[8]);
+	__m128 c3 = _mm_loadu_ps(&m.m[12]);
+	for(size_t i = 0; i < n; ++i) {
+		__m128 p = _gm_madd_ps(c0, _mm_set1_ps(in[i].x), c3);
+		p = _gm_madd_ps(c1, _mm_set1_ps(in[i].y), p);
+		p = _gm_madd_ps(c2, _mm_set1_ps(in[i].z), p);
+		_gm_store_vec3(&out[i], p);
+	}
+#else
+	for(size_t i = 0; i < n; ++i) {
+		vec3 p = in[i];
+		out[i].x = m.m[0] * p.x + m.m[4] * p.y + m.m[8] * p.z + m.m[12];
+		out[i].y = m.m[1] * p.x + m.m[5] * p.y + m.m[9] * p.z + m.m[13];
+		out[i].z = m.m[2] * p.x + m.m[6] * p.y + m.m[10] * p.z + m.m[14];
+	}
+#endif
+}
+
+// out[i] = m * vec4(in[i], 0). Not renormalised, pass the inverse transpose of a matrix with non-uniform scale
+inline void transform_normals(const mat4& m, const vec3* in, vec3* out, size_t n) {
+#if GAMEMATHS_SSE
+	__m128 c0 = _mm_loadu_ps(&m.m[0]);
+	__m128 c1 = _mm_loadu_ps(&m.m[4]);
+	__m128 c2 = _mm_loadu_ps(&m.m[8]);
+	for(size_t i = 0; i < n; ++i) {
+		__m128 v = _mm_mul_ps(c0, _mm_set1_ps(in[i].x));
+		v = _gm_madd_ps(c1, _mm_set1_ps(in[i].y), v);
+		v = _gm_madd_ps(c2, _mm_set1_ps(in[i].z), v);
+		_gm_store_vec3(&out[i], v);
+	}
+#else
+	for(size_t i = 0; i < n; ++i) {
+		vec3 v = in[i];
+		out[i].x = m.m[0] * v.x + m.m[4] * v.y + m.m[8] * v.z;
+		out[i].y = m.m[1] * v.x + m.m[5] * v.y + m.m[9] * v.z;
+		out[i].z = m.m[2] * v.x + m.m[6] * v.y + m.m[10] * v.z;
+	}
+#endif
+}
+
+// transform_points() for points stored as separate x, y and z arrays: 4 (SSE) or 8 (AVX) points at a time
+inline void transform_points_soa(const mat4& m, const float* in_x, const float* in_y, const float* in_z,
+                                 float* out_x, float* out_y, float* out_z, size_t n) {
+	size_t i = 0;
+#if GAMEMATHS_AVX
+	for(; i < (n & ~(size_t)7); i += 8) {
+		__m256 x = _mm256_loadu_ps(&in_x[i]);
+		__m256 y = _mm256_loadu_ps(&in_y[i]);
+		__m256 z = _mm256_loadu_ps(&in_z[i]);
+		for(int row = 0; row < 3; ++row) {
+			__m256 r = _gm_madd256_ps(_mm256_set1_ps(m.m[row]), x, _mm256_set1_ps(m.m[12 + row]));
+			r = _gm_madd256_ps(_mm256_set1_ps(m.m[4 + row]), y, r);
+			r = _gm_madd256_ps(_mm256_set1_ps(m.m[8 + row]), z, r);
+			_mm256_storeu_ps(&((row == 0) ? out_x : (row == 1) ? out_y : out_z)[i], r);
+		}
+	}
+#endif
+#if GAMEMATHS_SSE
+	for(; i < (n & ~(size_t)3); i += 4) {
+		__m128 x = _mm_loadu_ps(&in_x[i]);
+		__m128 y = _mm_loadu_ps(&in_y[i]);
+		__m128 z = _mm_loadu_ps(&in_z[i]);
+		for(int row = 0; row < 3; ++row) {
+			__m128 r = _gm_madd_ps(_mm_set1_ps(m.m[row]), x, _mm_set1_ps(m.m[12 + row]));
+			r = _gm_madd_ps(_mm_set1_ps(m.m[4 + row]), y, r);
+			r = _gm_madd_ps(_mm_set1_ps(m.m[8 + row]), z, r);
+			_mm_storeu_ps(&((row == 0) ? out_x : (row == 1) ? out_y : out_z)[i], r);
+		}
+	}
+#endif
+	for(; i < n; ++i) {
+		float x = in_x[i], y = in_y[i], z = in_z[i];
+		out_x[i] = m.m[0] * x + m.m[4] * y + m.m[8] * z + m.m[12];
+		out_y[i] = m.m[1] * x + m.m[5] * y + m.m[9] * z + m.m[13];
+		out_z[i] = m.m[2] * x + m.m[6] * y + m.m[10] * z + m.m[14];
+	}
+}
+
+// out[i] = a[i] * b[i], any of the arrays may be the same. Full 4x4 multiply, m isn't assumed affine here
+inline void mul_mat4_array(const mat4* a, const mat4* b, mat4* out, size_t n) {
+	for(size_t i = 0; i < n; ++i) {
+		out[i] = a[i] * b[i];
+	}
+}
+
+// Bounds of each box after transforming it by m (Arvo's method: the centre moves like a point,
+// the half extents by the absolute value of m's rotation/scale part). Exact for the box's 8 corners
+inline void aabb_transform_array(const mat4& m, const aabb* in, aabb* out, size_t n) {
+#if GAMEMATHS_SSE
+	__m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	__m128 c0 = _mm_loadu_ps(&m.m[0]);
+	__m128 c1 = _mm_loadu_ps(&m.m[4]);
+	__m128 c2 = _mm_loadu_ps(&m.m[8]);
+	__m128 c3 = _mm_loadu_ps(&m.m[12]);
+	__m128 abs_c0 = _mm_and_ps(c0, abs_mask);
+	__m128 abs_c1 = _mm_and_ps(c1, abs_mask);
+	__m128 abs_c2 = _mm_and_ps(c2, abs_mask);
+	for(size_t i = 0; i < n; ++i) {
+		// in may be out, so read everything first
+		vec3 lo = in[i].min, hi = in[i].max;
+		float cx = (lo.x + hi.x) * 0.5f, cy = (lo.y + hi.y) * 0.5f, cz = (lo.z + hi.z) * 0.5f;
+		__m128 centre = _gm_madd_ps(c0, _mm_set1_ps(cx), c3);
+		centre = _gm_madd_ps(c1, _mm_set1_ps(cy), centre);
+		centre = _gm_madd_ps(c2, _mm_set1_ps(cz), centre);
+		__m128 extent = _mm_mul_ps(abs_c0, _mm_set1_ps(hi.x - cx));
+		extent = _gm_madd_ps(abs_c1, _mm_set1_ps(hi.y - cy), extent);
+		extent = _gm_madd_ps(abs_c2, _mm_set1_ps(hi.z - cz), extent);
+		_gm_store_vec3(&out[i].min, _mm_sub_ps(centre, extent));
+		_gm_store_vec3(&out[i].max, _mm_add_ps(centre, extent));
+	}
+#else
+	for(size_t i = 0; i < n; ++i) {
+		vec3 centre = (in[i].min + in[i].max) * 0.5f;
+		vec3 extent = in[i].max - centre;
+		vec3 new_centre, new_extent;
+		for(int row = 0; row < 3; ++row) {
+			new_centre.v[row] = m.m[row] * centre.x + m.m[4 + row] * centre.y + m.m[8 + row] * centre.z + m.m[12 + row];
+			new_extent.v[row] = fabsf(m.m[row]) * extent.x + fabsf(m.m[4 + row]) * extent.y + fabsf(m.m[8 + row]) * extent.z;
+		}
+		out[i].min = new_centre - new_extent;
+		out[i].max = new_centre + new_extent;
+	}
+#endif
+}
+
+// Quaternion interpolation for many pairs at once, out[i] = lerp of a[i] towards b[i] by t[i].
+// Branch free, so it vectorises: like slerp(), a[i] is negated where it's on the far side of b[i] (by
+// xoring in the sign of the dot product) so every pair goes the short way, and slerp_batch() picks nlerp over slerp
+// per lane with a mask rather than an if. Results are unit length. a and b aren't written to, out may be either.
+#if GAMEMATHS_SSE
+// 4 lanes of nlerp_batch(), or slerp_batch() if use_slerp
+inline void _gm_quat_lerp_ps(const versor_soa& a, const versor_soa& b, const float* t, const versor_soa& out, size_t i, bool use_slerp) {
+	__m128 aw = _mm_loadu_ps(&a.w[i]), ax = _mm_loadu_ps(&a.x[i]), ay = _mm_loadu_ps(&a.y[i]), az = _mm_loadu_ps(&a.z[i]);
+	__m128 bw = _mm_loadu_ps(&b.w[i]), bx = _mm_loadu_ps(&b.x[i]), by = _mm_loadu_ps(&b.y[i]), bz = _mm_loadu_ps(&b.z[i]);
+	__m128 tb = _mm_loadu_ps(&t[i]);
+	__m128 cos_half_theta = _mm_add_ps(_mm_add_ps(_mm_mul_ps(aw, bw), _mm_mul_ps(ax, bx)), _mm_add_ps(_mm_mul_ps(ay, by), _mm_mul_ps(az, bz)));
+	__m128 sign = _mm_and_ps(cos_half_theta, _mm_set1_ps(-0.0f));
+	aw = _mm_xor_ps(aw, sign);
+	ax = _mm_xor_ps(ax, sign);
+	ay = _mm_xor_ps(ay, sign);
+	az = _mm_xor_ps(az, sign);
+	cos_half_theta = _mm_xor_ps(cos_half_theta, sign);
+
+	__m128 ta = _mm_sub_ps(_mm_set1_ps(1.0f), tb);
+	if(use_slerp) {
+		// Lanes too close together for the slerp weights to be accurate keep the nlerp ones (see slerp_fast())
+		__m128 half_theta = fast_acos_ps(cos_half_theta);
+		__m128 inv_sin_half_theta = fast_inv_sqrt_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(cos_half_theta, cos_half_theta)));
+		__m128 slerp_ta = _mm_mul_ps(fast_sin_ps(_mm_mul_ps(ta, half_theta)), inv_sin_half_theta);
+		__m128 slerp_tb = _mm_mul_ps(fast_sin_ps(_mm_mul_ps(tb, half_theta)), inv_sin_half_theta);
+		__m128 use_nlerp = _mm_cmpgt_ps(cos_half_theta, _mm_set1_ps(SLERP_FAST_NLERP_COS));
+		ta = _mm_or_ps(_mm_and_ps(use_nlerp, ta), _mm_andnot_ps(use_nlerp, slerp_ta));
+		tb = _mm_or_ps(_mm_and_ps(use_nlerp, tb), _mm_andnot_ps(use_nlerp, slerp_tb));
+	}
+
+	__m128 rw = _gm_madd_ps(bw, tb, _mm_mul_ps(aw, ta));
+	__m128 rx = _gm_madd_ps(bx, tb, _mm_mul_ps(ax, ta));
+	__m128 ry = _gm_madd_ps(by, tb, _mm_mul_ps(ay, ta));
+	__m128 rz = _gm_madd_ps(bz, tb, _mm_mul_ps(az, ta));
+	__m128 length_sq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rw, rw), _mm_mul_ps(rx, rx)), _mm_add_ps(_mm_mul_ps(ry, ry), _mm_mul_ps(rz, rz)));
+	__m128 inv_length = fast_inv_sqrt_ps(length_sq);
+	_mm_storeu_ps(&out.w[i], _mm_mul_ps(rw, inv_length));
+	_mm_storeu_ps(&out.x[i], _mm_mul_ps(rx, inv_length));
+	_mm_storeu_ps(&out.y[i], _mm_mul_ps(ry, inv_length));
+	_mm_storeu_ps(&out.z[i], _mm_mul_ps(rz, inv_length));
+}
+#endif
+
+#if GAMEMATHS_AVX
+// 8 lanes
+inline void _gm_quat_lerp256_ps(const versor_soa& a, const versor_soa& b, const float* t, const versor_soa& out, size_t i, bool use_slerp) {
+	__m256 aw = _mm256_loadu_ps(&a.w[i]), ax = _mm256_loadu_ps(&a.x[i]), ay = _mm256_loadu_ps(&a.y[i]), az = _mm256_loadu_ps(&a.z[i]);
+	__m256 bw = _mm256_loadu_ps(&b.w[i]), bx = _mm256_loadu_ps(&b.x[i]), by = _mm256_loadu_ps(&b.y[i]), bz = _mm256_loadu_ps(&b.z[i]);
+	__m256 tb = _mm256_loadu_ps(&t[i]);
+	__m256 cos_half_theta = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(aw, bw), _mm256_mul_ps(ax, bx)), _mm256_add_ps(_mm256_mul_ps(ay, by), _mm256_mul_ps(az, bz)));
+	__m256 sign = _mm256_and_ps(cos_half_theta, _mm256_set1_ps(-0.0f));
+	aw = _mm256_xor_ps(aw, sign);
+	ax = _mm256_xor_ps(ax, sign);
+	ay = _mm256_xor_ps(ay, sign);
+	az = _mm256_xor_ps(az, sign);
+	cos_half_theta = _mm256_xor_ps(cos_half_theta, sign);
+
+	__m256 ta = _mm256_sub_ps(_mm256_set1_ps(1.0f), tb);
+	if(use_slerp) {
+		__m256 half_theta = fast_acos256_ps(cos_half_theta);
+		__m256 inv_sin_half_theta = fast_inv_sqrt256_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(cos_half_theta, cos_half_theta)));
+		__m256 slerp_ta = _mm256_mul_ps(fast_sin256_ps(_mm256_mul_ps(ta, half_theta)), inv_sin_half_theta);
+		__m256 slerp_tb = _mm256_mul_ps(fast_sin256_ps(_mm256_mul_ps(tb, half_theta)), inv_sin_half_theta);
+		__m256 use_nlerp = _mm256_cmp_ps(cos_half_theta, _mm256_set1_ps(SLERP_FAST_NLERP_COS), _CMP_GT_OQ);
+		ta = _mm256_blendv_ps(slerp_ta, ta, use_nlerp);
+		tb = _mm256_blendv_ps(slerp_tb, tb, use_nlerp);
+	}
+
+	__m256 rw = _gm_madd256_ps(bw, tb, _mm256_mul_ps(aw, ta));
+	__m256 rx = _gm_madd256_ps(bx, tb, _mm256_mul_ps(ax, ta));
+	__m256 ry = _gm_madd256_ps(by, tb, _mm256_mul_ps(ay, ta));
+	__m256 rz = _gm_madd256_ps(bz, tb, _mm256_mul_ps(az, ta));
+	__m256 length_sq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(rw, rw), _mm256_mul_ps(rx, rx)), _mm256_add_ps(_mm256_mul_ps(ry, ry), _mm256_mul_ps(rz, rz)));
+	__m256 inv_length = fast_inv_sqrt256_ps(length_sq);
+	_mm256_storeu_ps(&out.w[i], _mm256_mul_ps(rw, inv_length));
+	_mm256_storeu_ps(&out.x[i], _mm256_mul_ps(rx, inv_length));
+	_mm256_storeu_ps(&out.y[i], _mm256_mul_ps(ry, inv_length));
+	_mm256_storeu_ps(&out.z[i], _mm256_mul_ps(rz, inv_length));
+}
+#endif
+
+// Normalised lerp, for keys close enough together that slerp isn't worth it
+inline void nlerp_batch(const versor_soa& a, const versor_soa& b, const float* t, const versor_soa& out, size_t n) {
+	size_t i = 0;
+#if GAMEMATHS_AVX
+	for(; i < (n & ~(size_t)7); i += 8) _gm_quat_lerp256_ps(a, b, t, out, i, false);
+#endif
+#if GAMEMATHS_SSE
+	for(; i < (n & ~(size_t)3); i += 4) _gm_quat_lerp_ps(a, b, t, out, i, false);
+#endif
+	for(; i < n; ++i) {
+		versor q = {a.w[i], a.x[i], a.y[i], a.z[i]};
+		versor r = {b.w[i], b.x[i], b.y[i], b.z[i]};
+		if(dot(q, r) < 0.0f) q = -q;
+		// Component-wise rather than versor operator+, which would normalise before we do
+		versor result;
+		for(int k = 0; k < 4; ++k) {
+			result.q[k] = q.q[k] * (1.0f - t[i]) + r.q[k] * t[i];
+		}
+		result = result * fast_inv_sqrtf(dot(result, result));
+		out.w[i] = result.q[0];
+		out.x[i] = result.q[1];
+		out.y[i] = result.q[2];
+		out.z[i] = result.q[3];
+	}
+}
+
+// Same results as slerp_fast() to within rounding
+inline void slerp_batch(const versor_soa& a, const versor_soa& b, const float* t, const versor_soa& out, size_t n) {
+	size_t i = 0;
+#if GAMEMATHS_AVX
+	for(; i < (n & ~(size_t)7); i += 8) _gm_quat_lerp256_ps(a, b, t, out, i, true);
+#endif
+#if GAMEMATHS_SSE
+	for(; i < (n & ~(size_t)3); i += 4) _gm_quat_lerp_ps(a, b, t, out, i, true);
+#endif
+	for(; i < n; ++i) {
+		versor q = {a.w[i], a.x[i], a.y[i], a.z[i]};
+		versor r = {b.w[i], b.x[i], b.y[i], b.z[i]};
+		versor result = slerp_fast(q, r, t[i]);
+		out.w[i] = result.q[0];
+		out.x[i] = result.q[1];
+		out.y[i] = result.q[2];
+		out.z[i] = result.q[3];
+	}
+}
+
+// 1 / sqrt(len_squared) for the batch normalise functions, 0 where len_squared is 0 (or NaN) so zero vectors
+// stay zero. Lanes fast_inv_sqrt_ps() can't do (denormal or inf) take the slow sqrt and divide, like inv_sqrtf_any()
+#if GAMEMATHS_SSE
+inline __m128 _gm_inv_length_ps(__m128 len_squared) {
+	__m128 in_range = _mm_and_ps(_mm_cmpge_ps(len_squared, _mm_set1_ps(FLT_MIN)), _mm_cmple_ps(len_squared, _mm_set1_ps(FLT_MAX)));
+	__m128 result = _mm_and_ps(fast_inv_sqrt_ps(len_squared), in_range);
+	if(_mm_movemask_ps(in_range) != 0xF) {
+		__m128 slow = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(len_squared));
+		slow = _mm_and_ps(slow, _mm_cmpgt_ps(len_squared, _mm_setzero_ps()));
+		result = _mm_or_ps(result, _mm_andnot_ps(in_range, slow));
+	}
+	return result;
+}
+#endif
+#if GAMEMATHS_AVX
+inline __m256 _gm_inv_length256_ps(__m256 len_squared) {
+	__m256 in_range = _mm256_and_ps(_mm256_cmp_ps(len_squared, _mm256_set1_ps(FLT_MIN), _CMP_GE_OQ),
+	                                _mm256_cmp_ps(len_squared, _mm256_set1_ps(FLT_MAX), _CMP_LE_OQ));
+	__m256 result = _mm256_and_ps(fast_inv_sqrt256_ps(len_squared), in_range);
+	if(_mm256_movemask_ps(in_range) != 0xFF) {
+		__m256 slow = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(len_squared));
+		slow = _mm256_and_ps(slow, _mm256_cmp_ps(len_squared, _mm256_setzero_ps(), _CMP_GT_OQ));
+		result = _mm256_or_ps(result, _mm256_andnot_ps(in_range, slow));
+	}
+	return result;
+}
+#endif
+
+// normalise() for vectors stored as separate x, y and z arrays, 4 (SSE) or 8 (AVX) at a time.
+// Zero vectors stay zero. out may be the same arrays as in
+inline void normalise_soa(const float* in_x, const float* in_y, const float* in_z,
+                          float* out_x, float* out_y, float* out_z, size_t n) {
+	size_t i = 0;
+#if GAMEMATHS_AVX
+	for(; i < (n & ~(size_t)7); i += 8) {
+		__m256 x = _mm256_loadu_ps(&in_x[i]);
+		__m256 y = _mm256_loadu_ps(&in_y[i]);
+		__m256 z = _mm256_loadu_ps(&in_z[i]);
+		__m256 len_squared = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z));
+		__m256 inv_length = _gm_inv_length256_ps(len_squared);
+		_mm256_storeu_ps(&out_x[i], _mm256_mul_ps(x, inv_length));
+		_mm256_storeu_ps(&out_y[i], _mm256_mul_ps(y, inv_length));
+		_mm256_storeu_ps(&out_z[i], _mm256_mul_ps(z, inv_length));
+	}
+#endif
+#if GAMEMATHS_SSE
+	for(; i < (n & ~(size_t)3); i += 4) {
+		__m128 x = _mm_loadu_ps(&in_x[i]);
+		__m128 y = _mm_loadu_ps(&in_y[i]);
+		__m128 z = _mm_loadu_ps(&in_z[i]);
+		__m128 len_squared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+		__m128 inv_length = _gm_inv_length_ps(len_squared);
+		_mm_storeu_ps(&out_x[i], _mm_mul_ps(x, inv_length));
+		_mm_storeu_ps(&out_y[i], _mm_mul_ps(y, inv_length));
+		_mm_storeu_ps(&out_z[i], _mm_mul_ps(z, inv_length));
+	}
+#endif
+	for(; i < n; ++i) {
+		vec3 v = normalise(vec3{in_x[i], in_y[i], in_z[i]});
+		out_x[i] = v.x;
+		out_y[i] = v.y;
+		out_z[i] = v.z;
+	}
+}
+
+// normalise() for each quaternion, to undo drift after accumulating rotations. out may be the same as q
+inline void normalise_batch(const versor_soa& q, const versor_soa& out, size_t n) {
+	size_t i = 0;
+#if GAMEMATHS_AVX
+	for(; i < (n & ~(size_t)7); i += 8) {
+		__m256 w = _mm256_loadu_ps(&q.w[i]), x = _mm256_loadu_ps(&q.x[i]), y = _mm256_loadu_ps(&q.y[i]), z = _mm256_loadu_ps(&q.z[i]);
+		__m256 mag_sq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(w, w), _mm256_mul_ps(x, x)), _mm256_add_ps(_mm256_mul_ps(y, y), _mm256_mul_ps(z, z)));
+		__m256 inv_length = _gm_inv_length256_ps(mag_sq);
+		_mm256_storeu_ps(&out.w[i], _mm256_mul_ps(w, inv_length));
+		_mm256_storeu_ps(&out.x[i], _mm256_mul_ps(x, inv_length));
+		_mm256_storeu_ps(&out.y[i], _mm256_mul_ps(y, inv_length));
+		_mm256_storeu_ps(&out.z[i], _mm256_mul_ps(z, inv_length));
+	}
+#endif
+#if GAMEMATHS_SSE
+	for(; i < (n & ~(size_t)3); i += 4) {
+		__m128 w = _mm_loadu_ps(&q.w[i]), x = _mm_loadu_ps(&q.x[i]), y = _mm_loadu_ps(&q.y[i]), z = _mm_loadu_ps(&q.z[i]);
+		__m128 mag_sq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(w, w), _mm_mul_ps(x, x)), _mm_add_ps(_mm_mul_ps(y, y), _mm_mul_ps(z, z)));
+		__m128 inv_length = _gm_inv_length_ps(mag_sq);
+		_mm_storeu_ps(&out.w[i], _mm_mul_ps(w, inv_length));
+		_mm_storeu_ps(&out.x[i], _mm_mul_ps(x, inv_length));
+		_mm_storeu_ps(&out.y[i], _mm_mul_ps(y, inv_length));
+		_mm_storeu_ps(&out.z[i], _mm_mul_ps(z, inv_length));
+	}
+#endif
+	for(; i < n; ++i) {
+		versor result = normalise(versor{q.w[i], q.x[i], q.y[i], q.z[i]});
+		out.w[i] = result.q[0];
+		out.x[i] = result.q[1];
+		out.y[i] = result.q[2];
+		out.z[i] = result.q[3];
+	}
+}
+
+// Intersection tests for many spheres/boxes at once, 4 (SSE) or 8 (AVX) per iteration, each giving
+// the same answer as the single value version. Meant for culling and broad phase collision over SoA bounds
+#if GAMEMATHS_SSE
+// out[k] = bit k of mask
+inline void _gm_store_mask(bool* out, int mask, int count) {
+	for(int k = 0; k < count; ++k) {
+		out[k] = ((mask >> k) & 1) != 0;
+	}
+}
+#endif
+
+inline void spheres_in_frustum(const frustum& f, const sphere_soa& spheres, bool* out_visible, size_t n) {
+	size_t i = 0;
+#if GAMEMATHS_AVX
+	for(; i < (n & ~(size_t)7); i += 8) {
+		__m256 x = _mm256_loadu_ps(&spheres.x[i]);
+		__m256 y = _mm256_loadu_ps(&spheres.y[i]);
+		__m256 z = _mm256_loadu_ps(&spheres.z[i]);
+		__m256 neg_radius = _mm256_xor_ps(_mm256_loadu_ps(&spheres.radius[i]), _mm256_set1_ps(-0.0f));
+		__m256 outside = _mm256_setzero_ps();
+		for(int p = 0; p < FRUSTUM_NUM_PLANES; ++p) {
+			const plane& pl = f.planes[p];
+			__m256 dist = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(pl.normal.x), x), _mm256_mul_ps(_mm256_set1_ps(pl.normal.y), y));
+			dist = _mm256_add_ps(_mm256_add_ps(dist, _mm256_mul_ps(_mm256_set1_ps(pl.normal.z), z)), _mm256_set1_ps(pl.d));
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(dist, neg_radius, _CMP_LT_OQ));
+		}
+		_gm_store_mask(&out_visible[i], ~_mm256_movemask_ps(outside), 8);
+	}
+#endif
+#if GAMEMATHS_SSE
+	for(; i < (n & ~(size_t)3); i += 4) {
+		__m128 x = _mm_loadu_ps(&spheres.x[i]);
+		__m128 y = _mm_loadu_ps(&spheres.y[i]);
+		__m128 z = _mm_loadu_ps(&spheres.z[i]);
+		__m128 neg_radius = _mm_xor_ps(_mm_loadu_ps(&spheres.radius[i]), _mm_set1_ps(-0.0f));
+		__m128 outside = _mm_setzero_ps();
+		for(int p = 0; p < FRUSTUM_NUM_PLANES; ++p) {
+			const plane& pl = f.planes[p];
+			__m128 dist = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(pl.normal.x), x), _mm_mul_ps(_mm_set1_ps(pl.normal.y), y));
+			dist = _mm_add_ps(_mm_add_ps(dist, _mm_mul_ps(_mm_set1_ps(pl.normal.z), z)), _mm_set1_ps(pl.d));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(dist, neg_radius));
+		}
+		_gm_store_mask(&out_visible[i], ~_mm_movemask_ps(outside), 4);
+	}
+#endif
+	for(; i < n; ++i) {
+		out_visible[i] = sphere_in_frustum(f, sphere{vec3{spheres.x[i], spheres.y[i], spheres.z[i]}, spheres.radius[i]});
+	}
+}
+
+// The corner to test against each plane is the same for every box, so it's picked once per call, not per box
+inline void aabbs_in_frustum(const frustum& f, const aabb_soa& boxes, bool* out_visible, size_t n) {
+	size_t i = 0;
+#if GAMEMATHS_SSE
+	const float* corner_x[FRUSTUM_NUM_PLANES];
+	const float* corner_y[FRUSTUM_NUM_PLANES];
+	const float* corner_z[FRUSTUM_NUM_PLANES];
+	for(int p = 0; p < FRUSTUM_NUM_PLANES; ++p) {
+		corner_x[p] = (f.planes[p].normal.x > 0.0f) ? boxes.max_x : boxes.min_x;
+		corner_y[p] = (f.planes[p].normal.y > 0.0f) ? boxes.max_y : boxes.min_y;
+		corner_z[p] = (f.planes[p].normal.z > 0.0f) ? boxes.max_z : boxes.min_z;
+	}
+#endif
+#if GAMEMATHS_AVX
+	for(; i < (n & ~(size_t)7); i += 8) {
+		__m256 outside = _mm256_setzero_ps();
+		for(int p = 0; p < FRUSTUM_NUM_PLANES; ++p) {
+			const plane& pl = f.planes[p];
+			__m256 x = _mm256_loadu_ps(&corner_x[p][i]);
+			__m256 y = _mm256_loadu_ps(&corner_y[p][i]);
+			__m256 z = _mm256_loadu_ps(&corner_z[p][i]);
+			__m256 dist = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(pl.normal.x), x), _mm256_mul_ps(_mm256_set1_ps(pl.normal.y), y));
+			dist = _mm256_add_ps(_mm256_add_ps(dist, _mm256_mul_ps(_mm256_set1_ps(pl.normal.z), z)), _mm256_set1_ps(pl.d));
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(dist, _mm256_setzero_ps(), _CMP_LT_OQ));
+		}
+		_gm_store_mask(&out_visible[i], ~_mm256_movemask_ps(outside), 8);
+	}
+#endif
+#if GAMEMATHS_SSE
+	for(; i < (n & ~(size_t)3); i += 4) {
+		__m128 outside = _mm_setzero_ps();
+		for(int p = 0; p < FRUSTUM_NUM_PLANES; ++p) {
+			const plane& pl = f.planes[p];
+			__m128 x = _mm_loadu_ps(&corner_x[p][i]);
+			__m128 y = _mm_loadu_ps(&corner_y[p][i]);
+			__m128 z = _mm_loadu_ps(&corner_z[p][i]);
+			__m128 dist = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(pl.normal.x), x), _mm_mul_ps(_mm_set1_ps(pl.normal.y), y));
+			dist = _mm_add_ps(_mm_add_ps(dist, _mm_mul_ps(_mm_set1_ps(pl.normal.z), z)), _mm_set1_ps(pl.d));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(dist, _mm_setzero_ps()));
+		}
+		_gm_store_mask(&out_visible[i], ~_mm_movemask_ps(outside), 4);
+	}
+#endif
+	for(; i < n; ++i) {
+		aabb box = {vec3{boxes.min_x[i], boxes.min_y[i], boxes.min_z[i]}, vec3{boxes.max_x[i], boxes.max_y[i], boxes.max_z[i]}};
+		out_visible[i] = aabb_in_frustum(f, box);
+	}
+}
+
+// out_overlap[i] = aabbs_overlap(box, boxes[i])
+inline void aabbs_overlap_batch(const aabb& box, const aabb_soa& boxes, bool* out_overlap, size_t n) {
+	size_t i = 0;
+#if GAMEMATHS_AVX
+	for(; i < (n & ~(size_t)7); i += 8) {
+		__m256 overlap = _mm256_and_ps(_mm256_cmp_ps(_mm256_set1_ps(box.min.x), _mm256_loadu_ps(&boxes.max_x[i]), _CMP_LE_OQ),
+									   _mm256_cmp_ps(_mm256_loadu_ps(&boxes.min_x[i]), _mm256_set1_ps(box.max.x), _CMP_LE_OQ));
+		overlap = _mm256_and_ps(overlap, _mm256_cmp_ps(_mm256_set1_ps(box.min.y), _mm256_loadu_ps(&boxes.max_y[i]), _CMP_LE_OQ));
+		overlap = _mm256_and_ps(overlap, _mm256_cmp_ps(_mm256_loadu_ps(&boxes.min_y[i]), _mm256_set1_ps(box.max.y), _CMP_LE_OQ));
+		overlap = _mm256_and_ps(overlap, _mm256_cmp_ps(_mm256_set1_ps(box.min.z), _mm256_loadu_ps(&boxes.max_z[i]), _CMP_LE_OQ));
+		overlap = _mm256_and_ps(overlap, _mm256_cmp_ps(_mm256_loadu_ps(&boxes.min_z[i]), _mm256_set1_ps(box.max.z), _CMP_LE_OQ));
+		_gm_store_mask(&out_overlap[i], _mm256_movemask_ps(overlap), 8);
+	}
+#endif
+#if GAMEMATHS_SSE
+	for(; i < (n & ~(size_t)3); i += 4) {
+		__m128 overlap = _mm_and_ps(_mm_cmple_ps(_mm_set1_ps(box.min.x), _mm_loadu_ps(&boxes.max_x[i])),
+									_mm_cmple_ps(_mm_loadu_ps(&boxes.min_x[i]), _mm_set1_ps(box.max.x)));
+		overlap = _mm_and_ps(overlap, _mm_cmple_ps(_mm_set1_ps(box.min.y), _mm_loadu_ps(&boxes.max_y[i])));
+		overlap = _mm_and_ps(overlap, _mm_cmple_ps(_mm_loadu_ps(&boxes.min_y[i]), _mm_set1_ps(box.max.y)));
+		overlap = _mm_and_ps(overlap, _mm_cmple_ps(_mm_set1_ps(box.min.z), _mm_loadu_ps(&boxes.max_z[i])));
+		overlap = _mm_and_ps(overlap, _mm_cmple_ps(_mm_loadu_ps(&boxes.min_z[i]), _mm_set1_ps(box.max.z)));
+		_gm_store_mask(&out_overlap[i], _mm_movemask_ps(overlap), 4);
+	}
+#endif
+	for(; i < n; ++i) {
+		aabb other = {vec3{boxes.min_x[i], boxes.min_y[i], boxes.min_z[i]}, vec3{boxes.max_x[i], boxes.max_y[i], boxes.max_z[i]}};
+		out_overlap[i] = aabbs_overlap(box, other);
+	}
+}
+
+// out_t[i] = ray_hits_aabb(r, boxes[i]): sort or take the min of out_t for the closest hit when picking.
+// minps/maxps return their second operand for NaN like MIN/MAX do, so lanes match the scalar version exactly
+inline void ray_hits_aabbs(ray r, const aabb_soa& boxes, float* out_t, size_t n) {
+	size_t i = 0;
+#if GAMEMATHS_SSE
+	float inv_dir[3] = {1.0f / r.dir.x, 1.0f / r.dir.y, 1.0f / r.dir.z};
+	const float* min_axis[3] = {boxes.min_x, boxes.min_y, boxes.min_z};
+	const float* max_axis[3] = {boxes.max_x, boxes.max_y, boxes.max_z};
+#endif
+#if GAMEMATHS_AVX
+	for(; i < (n & ~(size_t)7); i += 8) {
+		__m256 t_min = _mm256_setzero_ps(), t_max = _mm256_set1_ps(INFINITY);
+		for(int axis = 0; axis < 3; ++axis) {
+			__m256 origin = _mm256_set1_ps(r.origin.v[axis]), inv = _mm256_set1_ps(inv_dir[axis]);
+			__m256 t0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(&min_axis[axis][i]), origin), inv);
+			__m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(&max_axis[axis][i]), origin), inv);
+			t_min = _mm256_max_ps(_mm256_min_ps(t0, t1), t_min);
+			t_max = _mm256_min_ps(_mm256_max_ps(t0, t1), t_max);
+		}
+		__m256 hit = _mm256_cmp_ps(t_min, t_max, _CMP_LE_OQ);
+		_mm256_storeu_ps(&out_t[i], _mm256_blendv_ps(_mm256_set1_ps(INFINITY), t_min, hit));
+	}
+#endif
+#if GAMEMATHS_SSE
+	for(; i < (n & ~(size_t)3); i += 4) {
+		__m128 t_min = _mm_setzero_ps(), t_max = _mm_set1_ps(INFINITY);
+		for(int axis = 0; axis < 3; ++axis) {
+			__m128 origin = _mm_set1_ps(r.origin.v[axis]), inv = _mm_set1_ps(inv_dir[axis]);
+			__m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&min_axis[axis][i]), origin), inv);
+			__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&max_axis[axis][i]), origin), inv);
+			t_min = _mm_max_ps(_mm_min_ps(t0, t1), t_min);
+			t_max = _mm_min_ps(_mm_max_ps(t0, t1), t_max);
+		}
+		__m128 hit = _mm_cmple_ps(t_min, t_max);
+		_mm_storeu_ps(&out_t[i], _mm_or_ps(_mm_and_ps(hit, t_min), _mm_andnot_ps(hit, _mm_set1_ps(INFINITY))));
+	}
+#endif
+	for(; i < n; ++i) {
+		aabb box = {vec3{boxes.min_x[i], boxes.min_y[i], boxes.min_z[i]}, vec3{boxes.max_x[i], boxes.max_y[i], boxes.max_z[i]}};
+		out_t[i] = ray_hits_aabb(r, box);
+	}
+}
+
+/*----------------------------COMPILE-TIME CHECKS-----------------------------*/
+// Everything that doesn't need sqrt, trig or SIMD is constexpr, so fixed transforms (level geometry,
+// offsets) can be built at compile time into read-only data. These prove that keeps working.
+// Chosen so every result is exact in float.
+static_assert(DEG2RAD(180.0f) == PI32, "");
+static_assert(dot(cross(vec3{1, 0, 0}, vec3{0, 1, 0}), vec3{0, 0, 1}) == 1.0f, "");
+static_assert(length2(vec3{1, 2, 3} * 2.0f - vec3{2, 4, 6}) == 0.0f, "");
+static_assert(transpose(transpose(translate(identity_mat4(), vec3{1, 2, 3}))) == translate(identity_mat4(), vec3{1, 2, 3}), "");
+static_assert(mat4_mul_reference(translate(identity_mat4(), vec3{1, 2, 3}), scale_mat4(vec3{2, 2, 2})) ==
+              translate(scale_mat4(vec3{2, 2, 2}), vec3{1, 2, 3}), "");
+static_assert(mat4_mul_vec4_reference(translate(scale_mat4(vec3{5, 1, 5}), vec3{-7, 0, -3}), vec4{1, 1, 1, 1}).x == -2.0f, "");
+static_assert(determinant(scale_mat4(vec3{2, 3, 4})) == 24.0f, "");
+static_assert(quat_to_mat4(versor{1, 0, 0, 0}) == identity_mat4(), "");
+static_assert(quat_rotate(versor{0, 0, 1, 0}, vec3{1, 0, 0}).x == -1.0f, ""); // half turn about y
+static_assert(mat3x4_to_mat4(mat4_to_mat3x4(translate(identity_mat4(), vec3{1, 2, 3}))) == translate(identity_mat4(), vec3{1, 2, 3}), "");
+static_assert(mat3x4_to_mat4(transform_to_mat3x4(identity_transform())) == identity_mat4(), "");
+static_assert(transform_point(rigid_inverse(trs_mat3x4(vec3{1, 2, 3}, versor{0, 0, 1, 0}, vec3{1, 1, 1})), vec3{1, 2, 3}).z == 0.0f, "");
+static_assert(aabbs_overlap(aabb{vec3{0, 0, 0}, vec3{1, 1, 1}}, aabb{vec3{1, 1, 1}, vec3{2, 2, 2}}), "");
+static_assert(!aabbs_overlap(aabb{vec3{0, 0, 0}, vec3{1, 1, 1}}, aabb{vec3{0, 2, 0}, vec3{1, 3, 1}}), "");
+
 /*-----------------------------PRINT FUNCTIONS--------------------------------*/
 inline void print(vec2 v) {
 	printf("[%.2f, %.2f]\n", v.x, v.y);
@@ -0,0 +1,326 @@
+#include "KmxLoader.h"
+
+#include <stdio.h>
+#include <stddef.h> //offsetof
+#include <string.h> //memchr
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "GameMaths.h"
+#include "string_functions.h"
+
+global_variable KmxMappedFile _kmxMappedFiles[KMX_MAX_MAPPED_FILES];
+
+// Maps the whole file read-only, returns NULL on failure
+static const uint8* _map_file(const char* path, uint64* outSize)
+{
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE) return NULL;
+
+	LARGE_INTEGER size;
+	if(!GetFileSizeEx(file, &size) || (size.QuadPart == 0)) {
+		CloseHandle(file);
+		return NULL;
+	}
+
+	// The view keeps the mapping (and file) open, we don't need the handles once it exists
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if(!mapping) return NULL;
+	void* bytes = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if(!bytes) return NULL;
+
+	*outSize = (uint64)size.QuadPart;
+	return (const uint8*)bytes;
+#else
+	int fd = open(path, O_RDONLY);
+	if(fd < 0) return NULL;
+
+	struct stat fileStats;
+	if((fstat(fd, &fileStats) != 0) || (fileStats.st_size <= 0)) {
+		close(fd);
+		return NULL;
+	}
+
+	// The mapping stays valid after the file is closed
+	void* bytes = mmap(NULL, (size_t)fileStats.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(bytes == MAP_FAILED) return NULL;
+
+	*outSize = (uint64)fileStats.st_size;
+	return (const uint8*)bytes;
+#endif
+}
+
+static void _unmap_file(const uint8* bytes, uint64 size)
+{
+#if defined(_WIN32)
+	(void)size;
+	UnmapViewOfFile(bytes);
+#else
+	munmap((void*)bytes, (size_t)size);
+#endif
+}
+
+static KmxMappedFile* _acquire_kmx_file(const char* fileName)
+{
+	char path[KMX_MAX_PATH_LENGTH];
+	if(string_length(KMX_PATH) + string_length(fileName) >= KMX_MAX_PATH_LENGTH) {
+		fprintf(stderr, "ERROR: KMX path too long: %s%s\n", KMX_PATH, fileName);
+		return NULL;
+	}
+	concat_strings(KMX_PATH, fileName, path);
+
+	// Share the mapping if it's already loaded
+	KmxMappedFile* freeSlot = NULL;
+	for(uint32 i = 0; i < KMX_MAX_MAPPED_FILES; ++i)
+	{
+		KmxMappedFile* file = &_kmxMappedFiles[i];
+		if(file->refCount == 0) {
+			if(!freeSlot) freeSlot = file;
+		}
+		else if(strings_are_equal(file->path, path)) {
+			file->refCount++;
+			return file;
+		}
+	}
+	if(!freeSlot) {
+		fprintf(stderr, "ERROR: Can't load %s, already have KMX_MAX_MAPPED_FILES (%d) KMX files loaded\n", path, KMX_MAX_MAPPED_FILES);
+		return NULL;
+	}
+
+	uint64 size = 0;
+	const uint8* bytes = _map_file(path, &size);
+	if(!bytes) {
+		fprintf(stderr, "ERROR: Failed to open %s\n", path);
+		return NULL;
+	}
+
+	copy_string(path, freeSlot->path, KMX_MAX_PATH_LENGTH);
+	freeSlot->bytes = bytes;
+	freeSlot->size = size;
+	freeSlot->refCount = 1;
+	return freeSlot;
+}
+
+static void _release_kmx_file(KmxMappedFile* file)
+{
+	assert(file->refCount > 0);
+	if(--file->refCount > 0) return;
+
+	_unmap_file(file->bytes, file->size);
+	*file = {};
+}
+
+static bool _invalid(const char* what)
+{
+	fprintf(stderr, "ERROR: Invalid KMX %s\n", what);
+	return false;
+}
+
+// Does an array of count elements at offset fit in dataSize bytes, aligned for its element type?
+// Offsets are relative to the header's data member, which is 4 byte aligned in a mapping
+static bool _array_in_bounds(uint64 dataSize, uint32 offset, uint64 count, uint64 elementSize, uint32 alignment)
+{
+	if(offset % alignment != 0) return false;
+	return (offset <= dataSize) && (count * elementSize <= dataSize - offset);
+}
+
+// animate() binary searches key times so they have to be in order
+static bool _key_times_valid(const float* keyTimes, uint32 numKeys)
+{
+	for(uint32 i = 0; i < numKeys; ++i)
+	{
+		if(!isfinite(keyTimes[i])) return false;
+		if((i > 0) && (keyTimes[i] < keyTimes[i-1])) return false;
+	}
+	return true;
+}
+
+bool validate_kmx_mesh(const void* bytes, uint64 size, uint32* outNumBonesUsed)
+{
+	uint64 headerSize = offsetof(KmxSkinnedMesh, data);
+	if(size < headerSize) return _invalid("mesh: file is smaller than the header");
+
+	const KmxSkinnedMesh* mesh = (const KmxSkinnedMesh*)bytes;
+	if(mesh->magic != KMX_MAGIC) return _invalid("mesh: bad magic");
+	if(mesh->version != KMX_VERSION) {
+		fprintf(stderr, "WARNING: KMX mesh has version %u, expected %u. Loading it anyway\n", mesh->version, KMX_VERSION);
+	}
+
+	uint64 dataSize = size - headerSize;
+	uint64 vertCount = mesh->vertCount;
+	if(!_array_in_bounds(dataSize, mesh->indexOffset, mesh->indexCount, sizeof(uint16), 2)) return _invalid("mesh: indices out of bounds");
+	if(!_array_in_bounds(dataSize, mesh->vpOffset, vertCount * 3, sizeof(float), 4)) return _invalid("mesh: vertex positions out of bounds");
+	if(!_array_in_bounds(dataSize, mesh->vnOffset, vertCount * 3, sizeof(float), 4)) return _invalid("mesh: vertex normals out of bounds");
+	if(!_array_in_bounds(dataSize, mesh->vtOffset, vertCount * 2, sizeof(float), 4)) return _invalid("mesh: vertex tex coords out of bounds");
+	if(!_array_in_bounds(dataSize, mesh->vboneIdOffset, vertCount * 4, sizeof(uint32), 4)) return _invalid("mesh: vertex bone ids out of bounds");
+	if(!_array_in_bounds(dataSize, mesh->vboneWeightOffset, vertCount * 4, sizeof(float), 4)) return _invalid("mesh: vertex bone weights out of bounds");
+	if(mesh->indexCount % 3 != 0) return _invalid("mesh: index count isn't a multiple of 3");
+
+	const uint16* indices = (const uint16*)(&mesh->data + mesh->indexOffset);
+	for(uint32 i = 0; i < mesh->indexCount; ++i)
+	{
+		if(indices[i] >= vertCount) return _invalid("mesh: index out of range");
+	}
+
+	// The shader indexes the bone palette with every id, whatever its weight
+	const uint32* vboneIds = (const uint32*)(&mesh->data + mesh->vboneIdOffset);
+	uint64 numBonesUsed = 0;
+	for(uint64 i = 0; i < vertCount * 4; ++i)
+		numBonesUsed = MAX(numBonesUsed, (uint64)vboneIds[i] + 1);
+	if(!_array_in_bounds(dataSize, mesh->inverseBindPosesOffset, numBonesUsed, sizeof(mat4), 4)) return _invalid("mesh: inverse bind poses out of bounds");
+
+	if(outNumBonesUsed) *outNumBonesUsed = (uint32)numBonesUsed;
+	return true;
+}
+
+bool validate_kmx_skeleton(const void* bytes, uint64 size)
+{
+	uint64 headerSize = offsetof(KmxSkeleton, data);
+	if(size < headerSize) return _invalid("skeleton: file is smaller than the header");
+
+	const KmxSkeleton* skeleton = (const KmxSkeleton*)bytes;
+	if(skeleton->magic != KMX_MAGIC) return _invalid("skeleton: bad magic");
+	if(skeleton->version != KMX_VERSION) {
+		fprintf(stderr, "WARNING: KMX skeleton has version %u, expected %u. Loading it anyway\n", skeleton->version, KMX_VERSION);
+	}
+
+	uint64 dataSize = size - headerSize;
+	uint32 numBones = skeleton->numBones;
+	if(numBones == 0) return _invalid("skeleton: no bones");
+	if(!_array_in_bounds(dataSize, skeleton->bonesOffset, numBones, sizeof(KmxBone), 4)) return _invalid("skeleton: bones out of bounds");
+	if(!_array_in_bounds(dataSize, skeleton->animationsOffset, skeleton->numAnimations, sizeof(KmxAnimation), 4)) return _invalid("skeleton: animations out of bounds");
+
+	const KmxBone* bones = (const KmxBone*)(&skeleton->data + skeleton->bonesOffset);
+	for(uint32 boneIndex = 0; boneIndex < numBones; ++boneIndex)
+	{
+		const KmxBone* bone = &bones[boneIndex];
+		if(!memchr(bone->name, 0, sizeof(bone->name))) return _invalid("skeleton: bone name isn't terminated");
+		// Parents have to come before their children, see concatenate_bone_transforms(). Rules out cycles too
+		if((bone->parentIndex < -1) || (bone->parentIndex >= (int32)boneIndex)) {
+			fprintf(stderr, "ERROR: Invalid KMX skeleton: bone %u has parent %d, bones must come after their parents\n", boneIndex, bone->parentIndex);
+			return false;
+		}
+	}
+
+	const KmxAnimation* animations = (const KmxAnimation*)(&skeleton->data + skeleton->animationsOffset);
+	for(uint32 animationIndex = 0; animationIndex < skeleton->numAnimations; ++animationIndex)
+	{
+		const KmxAnimation* animation = &animations[animationIndex];
+		if(!memchr(animation->name, 0, sizeof(animation->name))) return _invalid("skeleton: animation name isn't terminated");
+		if(!isfinite(animation->duration) || (animation->duration < 0)) {
+			fprintf(stderr, "ERROR: Invalid KMX skeleton: animation %u has duration %f\n", animationIndex, animation->duration);
+			return false;
+		}
+		if(!_array_in_bounds(dataSize, animation->keyFramesOffset, numBones, sizeof(KmxBoneKeyFrames), 4)) {
+			fprintf(stderr, "ERROR: Invalid KMX skeleton: animation %u's keyframes out of bounds\n", animationIndex);
+			return false;
+		}
+
+		const KmxBoneKeyFrames* boneKeyFrames = (const KmxBoneKeyFrames*)(&skeleton->data + animation->keyFramesOffset);
+		for(uint32 boneIndex = 0; boneIndex < numBones; ++boneIndex)
+		{
+			const KmxBoneKeyFrames* keys = &boneKeyFrames[boneIndex];
+			bool tracksValid = _array_in_bounds(dataSize, keys->traKeyTimesOffset, keys->numTraKeys, sizeof(float), 4)
+							&& _array_in_bounds(dataSize, keys->traKeysOffset, keys->numTraKeys, sizeof(vec3), 4)
+							&& _array_in_bounds(dataSize, keys->rotKeyTimesOffset, keys->numRotKeys, sizeof(float), 4)
+							&& _array_in_bounds(dataSize, keys->rotKeysOffset, keys->numRotKeys, sizeof(versor), 4);
+			tracksValid = tracksValid
+						&& _key_times_valid((const float*)(&skeleton->data + keys->traKeyTimesOffset), keys->numTraKeys)
+						&& _key_times_valid((const float*)(&skeleton->data + keys->rotKeyTimesOffset), keys->numRotKeys);
+			if(!tracksValid) {
+				fprintf(stderr, "ERROR: Invalid KMX skeleton: animation %u, bone %u has bad keyframes\n", animationIndex, boneIndex);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+bool load_kmx_mesh(const char* fileName, KmxMeshView* outView)
+{
+	*outView = {};
+	KmxMappedFile* file = _acquire_kmx_file(fileName);
+	if(!file) return false;
+
+	uint32 numBonesUsed = 0;
+	if(!validate_kmx_mesh(file->bytes, file->size, &numBonesUsed)) {
+		fprintf(stderr, "ERROR: Failed to load mesh %s\n", file->path);
+		_release_kmx_file(file);
+		return false;
+	}
+
+	const KmxSkinnedMesh* mesh = (const KmxSkinnedMesh*)file->bytes;
+	outView->mesh = mesh;
+	outView->indices = (const uint16*)(&mesh->data + mesh->indexOffset);
+	outView->vp = (const float*)(&mesh->data + mesh->vpOffset);
+	outView->vn = (const float*)(&mesh->data + mesh->vnOffset);
+	outView->vt = (const float*)(&mesh->data + mesh->vtOffset);
+	outView->vboneIds = (const uint32*)(&mesh->data + mesh->vboneIdOffset);
+	outView->vboneWeights = (const float*)(&mesh->data + mesh->vboneWeightOffset);
+	outView->inverseBindPoses = (const mat4*)(&mesh->data + mesh->inverseBindPosesOffset);
+	outView->numBonesUsed = numBonesUsed;
+	outView->file = file;
+	return true;
+}
+
+bool load_kmx_skeleton(const char* fileName, KmxSkeletonView* outView)
+{
+	*outView = {};
+	KmxMappedFile* file = _acquire_kmx_file(fileName);
+	if(!file) return false;
+
+	if(!validate_kmx_skeleton(file->bytes, file->size)) {
+		fprintf(stderr, "ERROR: Failed to load skeleton %s\n", file->path);
+		_release_kmx_file(file);
+		return false;
+	}
+
+	const KmxSkeleton* skeleton = (const KmxSkeleton*)file->bytes;
+	outView->skeleton = skeleton;
+	outView->bones = (const KmxBone*)(&skeleton->data + skeleton->bonesOffset);
+	outView->animations = (const KmxAnimation*)(&skeleton->data + skeleton->animationsOffset);
+	outView->file = file;
+	return true;
+}
+
+void release_kmx_mesh(KmxMeshView* view)
+{
+	if(view->file) _release_kmx_file(view->file);
+	*view = {};
+}
+
+void release_kmx_skeleton(KmxSkeletonView* view)
+{
+	if(view->file) _release_kmx_file(view->file);
+	*view = {};
+}
+
+bool kmx_mesh_fits_skeleton(const KmxMeshView& mesh, const KmxSkeletonView& skeleton)
+{
+	uint32 numBones = skeleton.skeleton->numBones;
+	if(mesh.numBonesUsed > numBones) {
+		fprintf(stderr, "ERROR: %s uses %u bones, skeleton %s only has %u\n", mesh.file->path, mesh.numBonesUsed, skeleton.file->path, numBones);
+		return false;
+	}
+	uint64 dataSize = mesh.file->size - offsetof(KmxSkinnedMesh, data);
+	if(!_array_in_bounds(dataSize, mesh.mesh->inverseBindPosesOffset, numBones, sizeof(mat4), 4)) {
+		fprintf(stderr, "ERROR: %s doesn't have inverse bind poses for all %u bones of %s\n", mesh.file->path, numBones, skeleton.file->path);
+		return false;
+	}
+	return true;
+}
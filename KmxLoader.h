@@ -0,0 +1,61 @@
+#pragma once
+
+#include "utils.h"
+#include "Animation.h"
+
+// Loads .kmx files (from KMX_PATH) by memory mapping them read-only and handing out typed views straight into
+// the mapping, nothing is copied. Every count and offset in a file is checked against its size before any view
+// is returned, so the rest of the game can index the data without bounds checks.
+// Loading a file that's already loaded (e.g. a skeleton shared by many characters) shares its mapping.
+// Not thread safe, load and release on the main thread.
+
+#define KMX_PATH "Meshes/"
+#define KMX_MAGIC 0x20584D4B // "KMX "
+#define KMX_VERSION 1 // the version the exporter writes. Others load with a warning, the layout checks are what reject bad files
+#define KMX_MAX_MAPPED_FILES 32
+#define KMX_MAX_PATH_LENGTH 128
+
+struct mat4;
+
+struct KmxMappedFile {
+	char path[KMX_MAX_PATH_LENGTH];
+	const uint8* bytes;
+	uint64 size;
+	uint32 refCount; // 0 means this slot is free
+};
+
+// Pointers into the mapping, valid until released
+struct KmxMeshView {
+	const KmxSkinnedMesh* mesh;
+	const uint16* indices;
+	const float* vp;           // 3 per vertex
+	const float* vn;           // 3 per vertex
+	const float* vt;           // 2 per vertex
+	const uint32* vboneIds;    // 4 per vertex
+	const float* vboneWeights; // 4 per vertex
+	const mat4* inverseBindPoses;
+	uint32 numBonesUsed;       // highest bone id + 1, inverseBindPoses has at least this many
+	KmxMappedFile* file;
+};
+
+struct KmxSkeletonView {
+	const KmxSkeleton* skeleton;
+	const KmxBone* bones;
+	const KmxAnimation* animations;
+	KmxMappedFile* file;
+};
+
+// Checks a whole file's worth of bytes, printing what's wrong to stderr if it isn't a valid mesh/skeleton.
+// outNumBonesUsed (optional) gets the highest bone id + 1
+bool validate_kmx_mesh(const void* bytes, uint64 size, uint32* outNumBonesUsed = NULL);
+bool validate_kmx_skeleton(const void* bytes, uint64 size);
+
+// fileName is relative to KMX_PATH. Returns false (and leaves outView zeroed) if the file can't be mapped or isn't valid
+bool load_kmx_mesh(const char* fileName, KmxMeshView* outView);
+bool load_kmx_skeleton(const char* fileName, KmxSkeletonView* outView);
+// Unmaps the file once nothing else is using it
+void release_kmx_mesh(KmxMeshView* view);
+void release_kmx_skeleton(KmxSkeletonView* view);
+
+// Can the mesh be skinned by the skeleton? (every bone id is a skeleton bone and the file has an inverse bind pose for each)
+bool kmx_mesh_fits_skeleton(const KmxMeshView& mesh, const KmxSkeletonView& skeleton);
@@ -6,10 +6,9 @@
 
 void init_player(Player* player)
 {
-    player->pos = {};
-    player->scale = {0.25f, 0.5f, 0.25f};
-    player->R = identity_mat4();
-    player->M = translate(player->R * scale_mat4(player->scale), player->pos);
+    player->xform = identity_transform();
+    player->xform.scale = {0.25f, 0.5f, 0.25f};
+    player->M_dirty = true;
     player->vel = {};
     player->fwd = {0,0,-1};
     player->is_on_ground = false;
@@ -30,7 +29,7 @@ void update_player(Player* player, const GameInput &game_input, const Camera3D &
 
     float player_move_length2 = length2(player_move_dir);
     if(player_move_length2 > 1.0f)
-        player_move_dir *= (1.0f / sqrtf(player_move_length2));
+        player_move_dir *= fast_inv_sqrtf(player_move_length2);
 
     //Make player turn to face direction of travel
     if(player_move_length2 > 0.00001f)
@@ -42,15 +41,16 @@ void update_player(Player* player, const GameInput &game_input, const Camera3D &
         {
             const float player_turn_speed_rads = 4.0f * PI32;
             float rotation_amount = player_turn_speed_rads * dt;
-            float angle_remaining_rads = acosf(alignment);
+            float angle_remaining_rads = hot_acosf(alignment);
             
             rotation_amount = MIN(rotation_amount, angle_remaining_rads); //Clamp so we never rotate past target
 
             vec3 cross_prod = cross(player->fwd, player_move_dir);
             if(cross_prod.y < 0.0f) rotation_amount *= -1.0f;
             
-            player->R = rotate_y_rad(player->R, rotation_amount);
-            player->fwd = -vec3{player->R.m[8], player->R.m[9], player->R.m[10]};
+            player->xform.rot = quat_from_axis_rad(rotation_amount, 0, 1, 0) * player->xform.rot;
+            player->fwd = quat_rotate(player->xform.rot, vec3{0,0,-1});
+            player->M_dirty = true;
         }
     }
 
@@ -93,8 +93,19 @@ void update_player(Player* player, const GameInput &game_input, const Camera3D &
     }
 
     //Update player position
-    player->pos += player->vel * dt;
+    if(length2(player->vel) > 0.0f)
+    {
+        player->xform.pos += player->vel * dt;
+        player->M_dirty = true;
+    }
+}
 
-    //Update matrices
-    player->M = translate(player->R * scale_mat4(player->scale), player->pos);
+mat4 player_model_mat(Player* player)
+{
+    if(player->M_dirty)
+    {
+        player->M = transform_to_mat3x4(player->xform);
+        player->M_dirty = false;
+    }
+    return mat3x4_to_mat4(player->M);
 }
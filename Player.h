@@ -6,10 +6,9 @@
 struct Camera3D;
 
 struct Player {
-    vec3 pos;
-    vec3 scale;
-    mat4 R;
-    mat4 M;
+    transform xform;
+    mat3x4 M;       // model matrix, rebuilt from xform by player_model_mat() when M_dirty
+    bool M_dirty;   // set whenever xform changes
     vec3 vel;
     vec3 fwd;
     bool is_on_ground;
@@ -19,3 +18,4 @@ struct Player {
 
 void init_player(Player* player);
 void update_player(Player* player, const GameInput &game_input, const Camera3D &camera, float dt);
+mat4 player_model_mat(Player* player);
@@ -5,11 +5,10 @@
 #include "utils.h"
 #include "string_functions.h"
 
-#define SHADERS_FOLDER "Shaders/"
-
 //Internal functions
 static bool _load_shader_program(Shader* shader, const char* vert_file, const char* frag_file);
 static bool _load_and_compile_shader(GLuint* handle, const char* filename, GLuint shader_type);
+static void _get_uniform_locations(Shader* shader);
 
 Shader init_shader(const char* vert_file, const char* frag_file)
 {
@@ -22,21 +21,22 @@ Shader init_shader(const char* vert_file, const char* frag_file)
         return result;
     }
     result.compiled = true;
-    result.M_loc = glGetUniformLocation(result.id, "M");
-    result.V_loc = glGetUniformLocation(result.id, "V");
-    result.P_loc = glGetUniformLocation(result.id, "P");
+    _get_uniform_locations(&result);
     return result;
 }
 
 bool reload_shader_program(Shader* shader){
-    delete_program(shader);
-    if(!_load_shader_program(shader, shader->vert_file, shader->frag_file)) {
-        fprintf(stderr, "ERROR in reload_shader_program using vert shader %s and frag shader %s", shader->vert_file, shader->frag_file);
+    //Build the new program separately so we can keep using the old one if it doesn't compile
+    Shader reloaded = *shader;
+    if(!_load_shader_program(&reloaded, shader->vert_file, shader->frag_file)) {
+        fprintf(stderr, "ERROR in reload_shader_program using vert shader %s and frag shader %s, keeping old program\n", shader->vert_file, shader->frag_file);
         return false;
     }
-    shader->M_loc = glGetUniformLocation(shader->id, "M");
-    shader->V_loc = glGetUniformLocation(shader->id, "V");
-    shader->P_loc = glGetUniformLocation(shader->id, "P");
+    delete_program(shader);
+    reloaded.compiled = true;
+    _get_uniform_locations(&reloaded);
+    *shader = reloaded;
+    printf("Reloaded shader program %s + %s\n", shader->vert_file, shader->frag_file);
     return true;
 }
 
@@ -48,17 +48,44 @@ void delete_program(Shader* s){
         s->M_loc = -1;
         s->V_loc = -1;
         s->P_loc = -1;
+        s->colour_loc = -1;
+        s->pose_mats_loc = -1;
+        s->pose_mats_offset_loc = -1;
+        s->baked_frames_loc = -1;
+        s->instances_loc = -1;
+        s->instance_num_texels_loc = -1;
+        s->anim_time_loc = -1;
         s->compiled = false;
     }
 }
 
+bool shader_uses_file(const Shader* s, const char* filename){
+    return strings_are_equal(s->vert_file, filename) || strings_are_equal(s->frag_file, filename);
+}
+
+static void _get_uniform_locations(Shader* shader)
+{
+    shader->M_loc = glGetUniformLocation(shader->id, "M");
+    shader->V_loc = glGetUniformLocation(shader->id, "V");
+    shader->P_loc = glGetUniformLocation(shader->id, "P");
+    shader->colour_loc = glGetUniformLocation(shader->id, "colour");
+    shader->pose_mats_loc = glGetUniformLocation(shader->id, "poseMats");
+    shader->pose_mats_offset_loc = glGetUniformLocation(shader->id, "poseMatsOffset");
+    shader->baked_frames_loc = glGetUniformLocation(shader->id, "bakedFrames");
+    shader->instances_loc = glGetUniformLocation(shader->id, "instances");
+    shader->instance_num_texels_loc = glGetUniformLocation(shader->id, "instanceNumTexels");
+    shader->anim_time_loc = glGetUniformLocation(shader->id, "animTime");
+}
+
 static bool _load_shader_program(Shader* shader, const char* vert_file, const char* frag_file)
 {
     GLuint vs, fs;
     if(!_load_and_compile_shader(&vs, vert_file, GL_VERTEX_SHADER))
         return false;
-    if(!_load_and_compile_shader(&fs, frag_file, GL_FRAGMENT_SHADER))
+    if(!_load_and_compile_shader(&fs, frag_file, GL_FRAGMENT_SHADER)){
+        glDeleteShader(vs);
         return false;
+    }
     
     //Create and link program
     shader->id = glCreateProgram();
@@ -85,10 +112,13 @@ static bool _load_shader_program(Shader* shader, const char* vert_file, const ch
             glGetProgramInfoLog(shader->id, 2048, &log_length, prog_log);
             fprintf(stderr, "ERROR linking shader program. Program info log:\n%s\n", prog_log);
             result = false;
+            glDeleteProgram(shader->id);
         }
     }
-    glDetachShader(shader->id, vs);
-    glDetachShader(shader->id, fs);
+    if(result){
+        glDetachShader(shader->id, vs);
+        glDetachShader(shader->id, fs);
+    }
     glDeleteShader(vs);
     glDeleteShader(fs);
     
@@ -9,14 +9,22 @@
 #define VBONE_IDS_ATTRIB_LOC 3
 #define VBONE_WEIGHTS_ATTRIB_LOC 4
 
+#define SHADERS_FOLDER "Shaders/"
+
 struct Shader {
     GLuint id;
     const char* vert_file;
     const char* frag_file;
     GLuint M_loc, V_loc, P_loc;
+    GLuint colour_loc;
+    GLuint pose_mats_loc, pose_mats_offset_loc; //Skinning shaders only
+    GLuint baked_frames_loc, instances_loc, instance_num_texels_loc, anim_time_loc; //Baked crowd skinning shader only
     bool compiled;
 };
 
 Shader init_shader(const char* vert_file, const char* frag_file);
+// Recompiles s from its source files. If that fails s keeps its old program
 bool reload_shader_program(Shader* s);
 void delete_program(Shader* s);
+// Does s use filename (relative to SHADERS_FOLDER) as its vert or frag shader?
+bool shader_uses_file(const Shader* s, const char* filename);
@@ -7,20 +7,32 @@ in uvec4 boneIDs;
 in vec4 boneWeights;
 
 uniform mat4 M, V, P;
-uniform mat4 poseMats[100];
+// Bone pose matrices, 4 texels (columns) per bone. See BonePalette.h
+uniform samplerBuffer poseMats;
+uniform int poseMatsOffset;
 
 //out vec2 texCoords;
 out vec3 normal;
 
+mat4 get_pose_mat(uint boneID) {
+	int base = poseMatsOffset + 4*int(boneID);
+	return mat4(
+		texelFetch(poseMats, base),
+		texelFetch(poseMats, base + 1),
+		texelFetch(poseMats, base + 2),
+		texelFetch(poseMats, base + 3)
+	);
+}
+
 void main () {
 	// texCoords = vt;
 	normal = vn;
 
 	mat4 boneTransform = 
-	(poseMats[boneIDs[0]] * boneWeights[0]) +
-	(poseMats[boneIDs[1]] * boneWeights[1]) +
-	(poseMats[boneIDs[2]] * boneWeights[2]) +
-	(poseMats[boneIDs[3]] * boneWeights[3]);
+	(get_pose_mat(boneIDs[0]) * boneWeights[0]) +
+	(get_pose_mat(boneIDs[1]) * boneWeights[1]) +
+	(get_pose_mat(boneIDs[2]) * boneWeights[2]) +
+	(get_pose_mat(boneIDs[3]) * boneWeights[3]);
 
 	gl_Position = P*V*M * boneTransform * vec4(vp, 1.0);
 }
@@ -0,0 +1,60 @@
+#version 140
+
+in vec3 vp;
+in vec3 vn;
+// in vec2 vt;
+in uvec4 boneIDs;
+in vec4 boneWeights;
+
+uniform mat4 V, P;
+// Every frame of every baked clip, one row per frame, 3 texels (mat3x4 rows) per bone. See BakedAnimation.h
+uniform sampler2D bakedFrames;
+// instanceNumTexels (BAKED_INSTANCE_NUM_TEXELS) per instance: model matrix columns, then (first frame, num frames, frames per second, time offset)
+uniform samplerBuffer instances;
+uniform int instanceNumTexels;
+uniform float animTime;
+
+//out vec2 texCoords;
+out vec3 normal;
+
+void main () {
+	// texCoords = vt;
+
+	int instance = instanceNumTexels*gl_InstanceID;
+	mat4 M = mat4(texelFetch(instances, instance),
+	              texelFetch(instances, instance + 1),
+	              texelFetch(instances, instance + 2),
+	              texelFetch(instances, instance + 3));
+	vec4 clip = texelFetch(instances, instance + 4);
+	int firstFrame = int(clip.x);
+	int numFrames = int(clip.y);
+	float framesPerSecond = clip.z;
+
+	// Loop the clip and find the frames either side of now
+	float frame = 0.0;
+	if(numFrames > 1) {
+		float duration = float(numFrames - 1) / framesPerSecond;
+		frame = mod(animTime + clip.w, duration) * framesPerSecond;
+	}
+	int frame0 = min(int(frame), max(numFrames - 2, 0));
+	int frame1 = min(frame0 + 1, numFrames - 1);
+	float t = clamp(frame - float(frame0), 0.0, 1.0);
+	int row0 = firstFrame + frame0;
+	int row1 = firstFrame + frame1;
+
+	// Blend the rows of each bone's matrix, lerped between the two frames
+	vec4 m0 = vec4(0.0), m1 = vec4(0.0), m2 = vec4(0.0);
+	for(int i = 0; i < 4; ++i) {
+		int x = 3*int(boneIDs[i]);
+		m0 += mix(texelFetch(bakedFrames, ivec2(x,     row0), 0), texelFetch(bakedFrames, ivec2(x,     row1), 0), t) * boneWeights[i];
+		m1 += mix(texelFetch(bakedFrames, ivec2(x + 1, row0), 0), texelFetch(bakedFrames, ivec2(x + 1, row1), 0), t) * boneWeights[i];
+		m2 += mix(texelFetch(bakedFrames, ivec2(x + 2, row0), 0), texelFetch(bakedFrames, ivec2(x + 2, row1), 0), t) * boneWeights[i];
+	}
+
+	vec4 p = vec4(vp, 1.0);
+	vec3 skinnedPos = vec3(dot(m0, p), dot(m1, p), dot(m2, p));
+	vec3 skinnedNormal = vec3(dot(m0.xyz, vn), dot(m1.xyz, vn), dot(m2.xyz, vn));
+
+	normal = normalize(mat3(M)*skinnedNormal);
+	gl_Position = P*V*M * vec4(skinnedPos, 1.0);
+}
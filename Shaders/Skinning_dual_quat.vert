@@ -0,0 +1,47 @@
+#version 140
+
+in vec3 vp;
+in vec3 vn;
+// in vec2 vt;
+in uvec4 boneIDs;
+in vec4 boneWeights;
+
+uniform mat4 M, V, P;
+// Bone poses as dual quaternions, 2 texels per bone (real, dual). See BonePalette.h
+// Texels use versor layout (w, x, y, z)
+uniform samplerBuffer poseMats;
+uniform int poseMatsOffset;
+
+//out vec2 texCoords;
+out vec3 normal;
+
+void main () {
+	// texCoords = vt;
+
+	// Dual quaternion linear blending (Kavan et al. 2007)
+	// Quaternions are swizzled to (x, y, z, w) so .xyz is the vector part
+	int base0 = poseMatsOffset + 2*int(boneIDs[0]);
+	vec4 real0 = texelFetch(poseMats, base0).yzwx;
+	vec4 blendReal = real0 * boneWeights[0];
+	vec4 blendDual = texelFetch(poseMats, base0 + 1).yzwx * boneWeights[0];
+	for(int i = 1; i < 4; ++i) {
+		int base = poseMatsOffset + 2*int(boneIDs[i]);
+		vec4 real = texelFetch(poseMats, base).yzwx;
+		vec4 dual = texelFetch(poseMats, base + 1).yzwx;
+		// Take the short way round: q and -q are the same rotation
+		float w = (dot(real0, real) < 0.0) ? -boneWeights[i] : boneWeights[i];
+		blendReal += real * w;
+		blendDual += dual * w;
+	}
+	float invLength = 1.0 / length(blendReal);
+	blendReal *= invLength;
+	blendDual *= invLength;
+
+	vec3 r = blendReal.xyz;
+	vec3 translation = 2.0 * (blendReal.w * blendDual.xyz - blendDual.w * r + cross(r, blendDual.xyz));
+	vec3 skinnedPos = vp + 2.0 * cross(r, cross(r, vp) + blendReal.w * vp) + translation;
+	vec3 skinnedNormal = vn + 2.0 * cross(r, cross(r, vn) + blendReal.w * vn);
+
+	normal = normalize(mat3(M)*skinnedNormal);
+	gl_Position = P*V*M * vec4(skinnedPos, 1.0);
+}
@@ -0,0 +1,35 @@
+#version 140
+
+in vec3 vp;
+in vec3 vn;
+// in vec2 vt;
+in uvec4 boneIDs;
+in vec4 boneWeights;
+
+uniform mat4 M, V, P;
+// Bone pose matrices as the top 3 rows of an affine mat4, 3 texels per bone. See BonePalette.h
+uniform samplerBuffer poseMats;
+uniform int poseMatsOffset;
+
+//out vec2 texCoords;
+out vec3 normal;
+
+void main () {
+	// texCoords = vt;
+
+	// Blend the rows of each bone's matrix
+	vec4 row0 = vec4(0.0), row1 = vec4(0.0), row2 = vec4(0.0);
+	for(int i = 0; i < 4; ++i) {
+		int base = poseMatsOffset + 3*int(boneIDs[i]);
+		row0 += texelFetch(poseMats, base)     * boneWeights[i];
+		row1 += texelFetch(poseMats, base + 1) * boneWeights[i];
+		row2 += texelFetch(poseMats, base + 2) * boneWeights[i];
+	}
+
+	vec4 p = vec4(vp, 1.0);
+	vec3 skinnedPos = vec3(dot(row0, p), dot(row1, p), dot(row2, p));
+	vec3 skinnedNormal = vec3(dot(row0.xyz, vn), dot(row1.xyz, vn), dot(row2.xyz, vn));
+
+	normal = normalize(mat3(M)*skinnedNormal);
+	gl_Position = P*V*M * vec4(skinnedPos, 1.0);
+}
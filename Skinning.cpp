@@ -0,0 +1,154 @@
+#include "Skinning.h"
+
+#include "GameMaths.h"
+#include "Animation.h"
+
+void skin_vertices_reference(const mat4* pose_mats, const float* vp, const float* vn, const uint32* bone_ids, const float* bone_weights,
+                             uint32 vert_count, float* out_vp, float* out_vn)
+{
+    for(uint32 i = 0; i < vert_count; ++i)
+    {
+        const uint32* ids = &bone_ids[4*i];
+        const float* weights = &bone_weights[4*i];
+
+        mat4 bone_transform = pose_mats[ids[0]] * weights[0]
+                            + pose_mats[ids[1]] * weights[1]
+                            + pose_mats[ids[2]] * weights[2]
+                            + pose_mats[ids[3]] * weights[3];
+
+        vec4 p = bone_transform * vec4{vp[3*i], vp[3*i + 1], vp[3*i + 2], 1.0f};
+        vec4 n = bone_transform * vec4{vn[3*i], vn[3*i + 1], vn[3*i + 2], 0.0f};
+        vec3 skinned_normal = normalise(n.xyz);
+
+        out_vp[3*i]     = p.x;
+        out_vp[3*i + 1] = p.y;
+        out_vp[3*i + 2] = p.z;
+        out_vn[3*i]     = skinned_normal.x;
+        out_vn[3*i + 1] = skinned_normal.y;
+        out_vn[3*i + 2] = skinned_normal.z;
+    }
+}
+
+#if GAMEMATHS_SSE
+// Each matrix column is one SIMD register, so blending bones and transforming are all 4-wide.
+// (Going 4-wide across vertices instead would need a scalar gather per matrix element per lane.)
+
+#if GAMEMATHS_AVX
+#if GAMEMATHS_FMA
+#define _madd256(a, b, c) _mm256_fmadd_ps((a), (b), (c))
+#else
+#define _madd256(a, b, c) _mm256_add_ps(_mm256_mul_ps((a), (b)), (c))
+#endif
+
+static inline __m256 _combine_m128(__m128 lo, __m128 hi){
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+}
+
+// Blends 2 columns per register: cols01 = [col0 | col1], cols23 = [col2 | col3]
+static inline void _skin_vertex(const mat4* pose_mats, const uint32* ids, const float* weights,
+                                const float* vp, const float* vn, __m128* out_p, __m128* out_n)
+{
+    __m256 cols01 = _mm256_setzero_ps();
+    __m256 cols23 = _mm256_setzero_ps();
+    for(int j = 0; j < 4; ++j){
+        const float* m = pose_mats[ids[j]].m;
+        __m256 w = _mm256_set1_ps(weights[j]);
+        cols01 = _madd256(_mm256_loadu_ps(m), w, cols01);
+        cols23 = _madd256(_mm256_loadu_ps(m + 8), w, cols23);
+    }
+
+    __m256 p = _madd256(cols23, _combine_m128(_mm_set1_ps(vp[2]), _mm_set1_ps(1.0f)),
+                        _mm256_mul_ps(cols01, _combine_m128(_mm_set1_ps(vp[0]), _mm_set1_ps(vp[1]))));
+    __m256 n = _madd256(cols23, _combine_m128(_mm_set1_ps(vn[2]), _mm_setzero_ps()),
+                        _mm256_mul_ps(cols01, _combine_m128(_mm_set1_ps(vn[0]), _mm_set1_ps(vn[1]))));
+
+    *out_p = _mm_add_ps(_mm256_castps256_ps128(p), _mm256_extractf128_ps(p, 1));
+    *out_n = _mm_add_ps(_mm256_castps256_ps128(n), _mm256_extractf128_ps(n, 1));
+}
+#undef _madd256
+
+#else //SSE only
+static inline void _skin_vertex(const mat4* pose_mats, const uint32* ids, const float* weights,
+                                const float* vp, const float* vn, __m128* out_p, __m128* out_n)
+{
+    __m128 col0 = _mm_setzero_ps();
+    __m128 col1 = _mm_setzero_ps();
+    __m128 col2 = _mm_setzero_ps();
+    __m128 col3 = _mm_setzero_ps();
+    for(int j = 0; j < 4; ++j){
+        const float* m = pose_mats[ids[j]].m;
+        __m128 w = _mm_set1_ps(weights[j]);
+        col0 = _mm_add_ps(col0, _mm_mul_ps(_mm_loadu_ps(m), w));
+        col1 = _mm_add_ps(col1, _mm_mul_ps(_mm_loadu_ps(m + 4), w));
+        col2 = _mm_add_ps(col2, _mm_mul_ps(_mm_loadu_ps(m + 8), w));
+        col3 = _mm_add_ps(col3, _mm_mul_ps(_mm_loadu_ps(m + 12), w));
+    }
+
+    __m128 p = _mm_add_ps(_mm_mul_ps(col0, _mm_set1_ps(vp[0])), _mm_mul_ps(col1, _mm_set1_ps(vp[1])));
+    p = _mm_add_ps(p, _mm_add_ps(_mm_mul_ps(col2, _mm_set1_ps(vp[2])), col3));
+    __m128 n = _mm_add_ps(_mm_mul_ps(col0, _mm_set1_ps(vn[0])), _mm_mul_ps(col1, _mm_set1_ps(vn[1])));
+    n = _mm_add_ps(n, _mm_mul_ps(col2, _mm_set1_ps(vn[2])));
+
+    *out_p = p;
+    *out_n = n;
+}
+#endif //GAMEMATHS_AVX
+
+// Normalises xyz of v, leaves zero vectors as zero like normalise(vec3)
+static inline __m128 _normalise_xyz(__m128 v)
+{
+    __m128 sq = _mm_mul_ps(v, v);
+    __m128 len2 = _mm_add_ps(sq, _mm_add_ps(_mm_shuffle_ps(sq, sq, _MM_SHUFFLE(3,0,2,1)),
+                                            _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(3,1,0,2))));
+    __m128 result = _mm_mul_ps(v, fast_inv_sqrt_ps(len2));
+    return _mm_and_ps(result, _mm_cmpgt_ps(len2, _mm_setzero_ps()));
+}
+
+// Packs xyz of 4 vectors into 12 consecutive floats
+static inline void _store_xyz4(float* out, __m128 a, __m128 b, __m128 c, __m128 d)
+{
+    __m128 z0x1 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0,0,2,2));
+    __m128 z2x3 = _mm_shuffle_ps(c, d, _MM_SHUFFLE(0,0,2,2));
+    _mm_storeu_ps(out,     _mm_shuffle_ps(a, z0x1, _MM_SHUFFLE(2,0,1,0))); // x0 y0 z0 x1
+    _mm_storeu_ps(out + 4, _mm_shuffle_ps(b, c,    _MM_SHUFFLE(1,0,2,1))); // y1 z1 x2 y2
+    _mm_storeu_ps(out + 8, _mm_shuffle_ps(z2x3, d, _MM_SHUFFLE(2,1,2,0))); // z2 x3 y3 z3
+}
+
+void skin_vertices(const mat4* pose_mats, const float* vp, const float* vn, const uint32* bone_ids, const float* bone_weights,
+                   uint32 vert_count, float* out_vp, float* out_vn)
+{
+    uint32 i = 0;
+    for(; i + 4 <= vert_count; i += 4)
+    {
+        __m128 p[4], n[4];
+        for(uint32 k = 0; k < 4; ++k){
+            uint32 v = i + k;
+            _skin_vertex(pose_mats, &bone_ids[4*v], &bone_weights[4*v], &vp[3*v], &vn[3*v], &p[k], &n[k]);
+            n[k] = _normalise_xyz(n[k]);
+        }
+        _store_xyz4(&out_vp[3*i], p[0], p[1], p[2], p[3]);
+        _store_xyz4(&out_vn[3*i], n[0], n[1], n[2], n[3]);
+    }
+
+    //Leftovers
+    skin_vertices_reference(pose_mats, &vp[3*i], &vn[3*i], &bone_ids[4*i], &bone_weights[4*i],
+                            vert_count - i, &out_vp[3*i], &out_vn[3*i]);
+}
+
+#else //No SIMD
+void skin_vertices(const mat4* pose_mats, const float* vp, const float* vn, const uint32* bone_ids, const float* bone_weights,
+                   uint32 vert_count, float* out_vp, float* out_vn)
+{
+    skin_vertices_reference(pose_mats, vp, vn, bone_ids, bone_weights, vert_count, out_vp, out_vn);
+}
+#endif //GAMEMATHS_SSE
+
+void skin_mesh(const KmxSkinnedMesh& mesh, const mat4* pose_mats, float* out_vp, float* out_vn)
+{
+    const float* vp = (const float*)(&mesh.data + mesh.vpOffset);
+    const float* vn = (const float*)(&mesh.data + mesh.vnOffset);
+    const uint32* bone_ids = (const uint32*)(&mesh.data + mesh.vboneIdOffset);
+    const float* bone_weights = (const float*)(&mesh.data + mesh.vboneWeightOffset);
+
+    skin_vertices(pose_mats, vp, vn, bone_ids, bone_weights, mesh.vertCount, out_vp, out_vn);
+}
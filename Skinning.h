@@ -0,0 +1,20 @@
+#pragma once
+
+#include "utils.h"
+
+struct mat4;
+struct KmxSkinnedMesh;
+
+// CPU linear blend skinning, for headless builds and for validating the GPU skinning shaders.
+// Same maths as Shaders/Skinning.vert, but normals are skinned too (and re-normalised).
+// vp/vn are 3 floats per vertex, bone_ids/bone_weights are 4 per vertex, as in KmxSkinnedMesh.
+// pose_mats is the palette written by animate(). Output arrays must not alias the inputs.
+void skin_vertices(const mat4* pose_mats, const float* vp, const float* vn, const uint32* bone_ids, const float* bone_weights, 
+                   uint32 vert_count, float* out_vp, float* out_vn);
+
+// Plain scalar version of skin_vertices, the reference the SIMD paths are checked against
+void skin_vertices_reference(const mat4* pose_mats, const float* vp, const float* vn, const uint32* bone_ids, const float* bone_weights, 
+                             uint32 vert_count, float* out_vp, float* out_vn);
+
+// Skins every vertex of mesh. out_vp/out_vn must hold mesh.vertCount*3 floats
+void skin_mesh(const KmxSkinnedMesh& mesh, const mat4* pose_mats, float* out_vp, float* out_vn);
@@ -74,6 +74,10 @@
 #define GL_MINOR_VERSION                  0x821C
 #define GL_SHADING_LANGUAGE_VERSION       0x8B8C
 #define GL_STATIC_DRAW                    0x88E4
+#define GL_DYNAMIC_DRAW                   0x88E8
+#define GL_STREAM_DRAW                    0x88E0
+#define GL_TEXTURE_BUFFER                 0x8C2A
+#define GL_RGBA32F                        0x8814
 #define GL_TEXTURE0                       0x84C0
 #define GL_VERTEX_SHADER                  0x8B31
 
@@ -112,6 +116,7 @@ typedef ptrdiff_t GLsizeiptr;
     GLE(void,      DetachShader,            GLuint program, GLuint shader) \
     GLE(void,      EnableVertexAttribArray, GLuint index) \
     GLE(void,      DrawBuffers,             GLsizei n, const GLenum *bufs) \
+    GLE(void,      DrawElementsInstanced,   GLenum mode, GLsizei count, GLenum type, const GLvoid *indices, GLsizei instancecount) \
     GLE(void,      FramebufferTexture2D,    GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level) \
     GLE(void,      GenBuffers,              GLsizei n, GLuint *buffers) \
     GLE(void,      GenFramebuffers,         GLsizei n, GLuint * framebuffers) \
@@ -124,6 +129,7 @@ typedef ptrdiff_t GLsizeiptr;
     GLE(GLint,     GetUniformLocation,      GLuint program, const GLchar *name) \
     GLE(void,      LinkProgram,             GLuint program) \
     GLE(void,      ShaderSource,            GLuint shader, GLsizei count, const GLchar* const *string, const GLint *length) \
+    GLE(void,      TexBuffer,               GLenum target, GLenum internalformat, GLuint buffer) \
     GLE(void,      Uniform1i,               GLint location, GLint v0) \
     GLE(void,      Uniform1f,               GLint location, GLfloat v0) \
     GLE(void,      Uniform2f,               GLint location, GLfloat v0, GLfloat v1) \
@@ -134,6 +140,7 @@ typedef ptrdiff_t GLsizeiptr;
     GLE(void,      Uniform4fv,              GLint location, GLsizei count, const GLfloat *value) \
     GLE(void,      UniformMatrix4fv,        GLint location, GLsizei count, GLboolean transpose, const GLfloat *value) \
     GLE(void,      UseProgram,              GLuint program) \
+    GLE(void,      VertexAttribIPointer,    GLuint index, GLint size, GLenum type, GLsizei stride, const GLvoid * pointer) \
     GLE(void,      VertexAttribPointer,     GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const GLvoid * pointer) \
     /* end */
 
@@ -17,6 +17,18 @@
 #include "DebugDrawing.h"
 #include "Mesh.h"
 #include "Animation.h"
+#include "FileWatcher.h"
+#include "BonePalette.h"
+#include "Skinning.h"
+#include "AnimationJobs.h"
+#include "AnimationCompression.h"
+#include "AnimationSoa.h"
+#include "AnimationBlending.h"
+#include "AnimationLod.h"
+#include "AnimationGraph.h"
+#include "KmxLoader.h"
+#include "BakedAnimation.h"
+#include "BakedCrowd.h"
 
 #include "Input.cpp"
 #include "Camera3D.cpp"
@@ -27,6 +39,18 @@
 #include "string_functions.cpp"
 #include "Mesh.cpp"
 #include "Animation.cpp"
+#include "FileWatcher.cpp"
+#include "BonePalette.cpp"
+#include "Skinning.cpp"
+#include "AnimationJobs.cpp"
+#include "AnimationCompression.cpp"
+#include "AnimationSoa.cpp"
+#include "AnimationBlending.cpp"
+#include "AnimationLod.cpp"
+#include "AnimationGraph.cpp"
+#include "KmxLoader.cpp"
+#include "BakedAnimation.cpp"
+#include "BakedCrowd.cpp"
 
 int main(){
 	GLFWwindow* window = NULL;
@@ -60,59 +84,28 @@ int main(){
 
     //Load shaders
 	Shader basic_shader = init_shader("MVP.vert", "uniform_colour_sunlight.frag");
-	GLuint colour_loc = glGetUniformLocation(basic_shader.id, "colour");
+
+	//Watch shader folder so edited shaders get reloaded without restarting
+	FileWatcher shader_watcher;
+	init_file_watcher(&shader_watcher, SHADERS_FOLDER);
 
 #if 0 // WIP: Animation
 
-	Shader skinningShader = init_shader("Skinning.vert", "uniform_colour_sunlight.frag");
-	int32 pose_mats_locs[MAX_NUM_BONES];
+	SkinningMode skinningMode = SKINNING_MODE_MAT3X4;
+	Shader skinningShader = init_shader(skinning_vert_shader(skinningMode), "uniform_colour_sunlight.frag");
 
-	//Get uniform locations for pose mats
-	{
-		glUseProgram(skinningShader.id);
-		char name[16];
-
-		for (uint32 i = 0; i < MAX_NUM_BONES; i++) {
-			sprintf(name, "poseMats[%u]", i);
-			pose_mats_locs[i] = glGetUniformLocation(skinningShader.id, name);
-			if (pose_mats_locs[i] < 0) {
-				printf("ERROR getting uniform location: '%s' not found in shader\n", name);
-			}
-		}
-	}
-	KmxSkinnedMesh* kmxMesh = NULL;
+	KmxMeshView kmxMesh;
 	GLuint kmx_vao;
 	uint32 kmx_indexCount;
 	{
-		FILE* fp = fopen("/Users/kevin/Desktop/test.kmx", "rb");
-		assert(fp);
-		fseek(fp, 0, SEEK_END);
-		uint64 file_length = ftell(fp);
-		rewind(fp);
-
-		void* file_bytes = malloc(file_length);
-		assert(file_bytes);
-
-		fread(file_bytes, file_length, 1, fp);
-		fclose(fp);
-
-		kmxMesh = (KmxSkinnedMesh*)file_bytes;
-		assert(kmxMesh->magic == *(uint32*)("KMX "));
-
-		kmx_indexCount = kmxMesh->indexCount;
+		if(!load_kmx_mesh("test.kmx", &kmxMesh)) return 1;
 
-		uint16* indices = (uint16*)(&kmxMesh->data + kmxMesh->indexOffset);
-		float* vp = (float*)(&kmxMesh->data + kmxMesh->vpOffset);
-		float* vn = (float*)(&kmxMesh->data + kmxMesh->vnOffset);
-		// float* vt = (float*)(&kmxMesh->data + kmxMesh->vtOffset);
-		uint32* vbone_ids = (uint32*)(&kmxMesh->data + kmxMesh->vboneIdOffset);
-		float* vbone_weights = (float*)(&kmxMesh->data + kmxMesh->vboneWeightOffset);
-		// mat4* ibp_mats = (mat4*)(&kmxMesh->data + kmxMesh->inverseBindPosesOffset);
+		kmx_indexCount = kmxMesh.mesh->indexCount;
 
-		// for(uint32 i=0; i < kmxMesh->vertCount; ++i)
+		// for(uint32 i=0; i < kmxMesh.mesh->vertCount; ++i)
 		// {
-		// 	printf("%i %i %i %i   ", vbone_ids[4*i], vbone_ids[4*i + 1], vbone_ids[4*i + 2], vbone_ids[4*i + 3]);
-		// 	printf("%f %f %f %f\n", vbone_weights[4*i], vbone_weights[4*i + 1], vbone_weights[4*i + 2], vbone_weights[4*i + 3]);
+		// 	printf("%i %i %i %i   ", kmxMesh.vboneIds[4*i], kmxMesh.vboneIds[4*i + 1], kmxMesh.vboneIds[4*i + 2], kmxMesh.vboneIds[4*i + 3]);
+		// 	printf("%f %f %f %f\n", kmxMesh.vboneWeights[4*i], kmxMesh.vboneWeights[4*i + 1], kmxMesh.vboneWeights[4*i + 2], kmxMesh.vboneWeights[4*i + 3]);
 		// }
 
 		glGenVertexArrays(1, &kmx_vao);
@@ -122,96 +115,100 @@ int main(){
         
         glGenBuffers(1, &index_vbo);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_vbo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, kmxMesh->indexCount*sizeof(uint16), indices, GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, kmxMesh.mesh->indexCount*sizeof(uint16), kmxMesh.indices, GL_STATIC_DRAW);
 
         glGenBuffers(1, &pos_vbo);
         glBindBuffer(GL_ARRAY_BUFFER, pos_vbo);
-        glBufferData(GL_ARRAY_BUFFER, kmxMesh->vertCount*3*sizeof(float), vp, GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, kmxMesh.mesh->vertCount*3*sizeof(float), kmxMesh.vp, GL_STATIC_DRAW);
         glEnableVertexAttribArray(VP_ATTRIB_LOC);
         glVertexAttribPointer(VP_ATTRIB_LOC, 3, GL_FLOAT, GL_FALSE, 0, NULL);
 
         glGenBuffers(1, &norm_vbo);
         glBindBuffer(GL_ARRAY_BUFFER, norm_vbo);
-        glBufferData(GL_ARRAY_BUFFER, kmxMesh->vertCount*3*sizeof(float), vn, GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, kmxMesh.mesh->vertCount*3*sizeof(float), kmxMesh.vn, GL_STATIC_DRAW);
         glEnableVertexAttribArray(VN_ATTRIB_LOC);
         glVertexAttribPointer(VN_ATTRIB_LOC, 3, GL_FLOAT, GL_FALSE, 0, NULL);
 
         glGenBuffers(1, &bone_ids_vbo);
         glBindBuffer(GL_ARRAY_BUFFER, bone_ids_vbo);
-        glBufferData(GL_ARRAY_BUFFER, kmxMesh->vertCount*4*sizeof(uint32), vbone_ids, GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, kmxMesh.mesh->vertCount*4*sizeof(uint32), kmxMesh.vboneIds, GL_STATIC_DRAW);
         glEnableVertexAttribArray(VBONE_IDS_ATTRIB_LOC);
         glVertexAttribIPointer(VBONE_IDS_ATTRIB_LOC, 4, GL_UNSIGNED_INT, 0, NULL);
 
         glGenBuffers(1, &bone_weights_vbo);
         glBindBuffer(GL_ARRAY_BUFFER, bone_weights_vbo);
-        glBufferData(GL_ARRAY_BUFFER, kmxMesh->vertCount*4*sizeof(float), vbone_weights, GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, kmxMesh.mesh->vertCount*4*sizeof(float), kmxMesh.vboneWeights, GL_STATIC_DRAW);
         glEnableVertexAttribArray(VBONE_WEIGHTS_ATTRIB_LOC);
         glVertexAttribPointer(VBONE_WEIGHTS_ATTRIB_LOC, 4, GL_FLOAT, GL_FALSE, 0, NULL);
 
         check_gl_error();
 	}
 
-	KmxSkeleton* skeleton = NULL;
-	{
-		FILE* fp = fopen("/Users/kevin/Desktop/test_skel2.kmx", "rb");
-		assert(fp);
-		fseek(fp, 0, SEEK_END);
-		uint64 file_length = ftell(fp);
-		rewind(fp);
+	KmxSkeletonView skeletonView;
+	if(!load_kmx_skeleton("test_skel2.kmx", &skeletonView)) return 1;
+	if(!kmx_mesh_fits_skeleton(kmxMesh, skeletonView)) return 1;
+	const KmxSkeleton* skeleton = skeletonView.skeleton;
 
-		void* file_bytes = malloc(file_length);
-		assert(file_bytes);
-		fread(file_bytes, file_length, 1, fp);
-		fclose(fp);
+	// printf("Bones:\n");
+	// for(uint32 i=0; i < skeleton->numBones; ++i)
+	// {
+	// 	printf("%u name: %s, parent: %i\n", i, skeletonView.bones[i].name, skeletonView.bones[i].parentIndex);
+	// }
 
-		skeleton = (KmxSkeleton*)file_bytes;
-		assert(skeleton->magic == *(uint32*)("KMX "));
+	// printf("Animations:\n");
+	// for(uint32 i=0; i < skeleton->numAnimations; ++i)
+	// {
+	// 	printf("%u name: %s, duration: %f\n", i, skeletonView.animations[i].name, skeletonView.animations[i].duration);
+	// }
 
-		// KmxBone* bones = (KmxBone*)(&skeleton->data + skeleton->bonesOffset);
-		// KmxAnimation* anims = (KmxAnimation*)(&skeleton->data + skeleton->animationsOffset);
+	// for(uint32 i=0; i<skeleton->numBones; ++i){
+	// 	print(kmxMesh.inverseBindPoses[i]);
+	// }
 
-		// printf("Bones:\n");
-		// for(uint32 i=0; i < skeleton->numBones; ++i)
-		// {
-		// 	printf("%u name: %s, parent: %i\n", i, bones[i].name, bones[i].parentIndex);
-		// }
+	#define NUM_ANIMATED_CHARACTERS 16
+	uint32 CURRENT_ANIM_INDEX = 1;
+	const mat4* inverseBindPoses = kmxMesh.inverseBindPoses;
+	mat4* poseMats = (mat4*)malloc(NUM_ANIMATED_CHARACTERS * skeleton->numBones * sizeof(mat4));
 
-		// printf("Animations:\n");
-		// for(uint32 i=0; i < skeleton->numAnimations; ++i)
-		// {
-		// 	printf("%u name: %s, duration: %f\n", i, anims[i].name, anims[i].duration);
-
-		// 	printf("Keyframe data:\n");
-		// 	KmxBoneKeyFrames* keys = (KmxBoneKeyFrames*)(&skeleton->data + anims[i].keyFramesOffset);
-		// 	for(uint32 boneIndex=0; boneIndex < skeleton->numBones; ++boneIndex)
-		// 	{
-		// 		KmxBoneKeyFrames* currBoneKeyFrames = &keys[boneIndex];
-		// 		printf("Bone %u:\n", boneIndex);
-		// 		float* traKeyTimes = (float*)(&skeleton->data + currBoneKeyFrames->traKeyTimesOffset);
-		// 		vec3* traKeys = (vec3*)(&skeleton->data + currBoneKeyFrames->traKeysOffset);
-
-		// 		for(int k=0; k < currBoneKeyFrames->numTraKeys; ++k)
-		// 		{
-		// 			printf("t: %f, tra: [%f, %f, %f]\n", traKeyTimes[k], traKeys[k].x, traKeys[k].y, traKeys[k].z);
-		// 		}
-
-		// 		float* rotKeyTimes = (float*)(&skeleton->data + currBoneKeyFrames->rotKeyTimesOffset);
-		// 		versor* rotKeys = (versor*)(&skeleton->data + currBoneKeyFrames->rotKeysOffset);
-
-		// 		for(int k=0; k < currBoneKeyFrames->numRotKeys; ++k)
-		// 		{
-		// 			printf("t: %f, rot: [%f, %f, %f, %f]\n", rotKeyTimes[k], rotKeys[k].q[0], rotKeys[k].q[1], rotKeys[k].q[2], rotKeys[k].q[3]);
-		// 		}
-		// 	}
-		// }
+	AnimationLodSettings animLodSettings = {10.0f, 25.0f, 15.0f};
+	uint8* farBoneMask = (uint8*)malloc(skeleton->numBones);
+	build_far_bone_mask(*skeleton, farBoneMask);
+
+	KmxAnimationCursor animCursors[NUM_ANIMATED_CHARACTERS];
+	AnimationLodState animLods[NUM_ANIMATED_CHARACTERS];
+	AnimationInstance animInstances[NUM_ANIMATED_CHARACTERS];
+	for(uint32 i = 0; i < NUM_ANIMATED_CHARACTERS; ++i)
+	{
+		init_animation_cursor(&animCursors[i], *skeleton);
+		init_animation_lod(&animLods[i], *skeleton, farBoneMask);
+		animInstances[i] = {skeleton, (int32)CURRENT_ANIM_INDEX, 0.0f, inverseBindPoses, &poseMats[i * skeleton->numBones], &animCursors[i], &animLods[i]};
 	}
 
-	// mat4* ibp_mats = (mat4*)(&kmxMesh->data + kmxMesh->inverseBindPosesOffset);
-	// for(int i=0; i<skeleton->numBones; ++i){
-	// 	print(ibp_mats[i]);
-	// }
+	AnimationJobSystem animJobs;
+	init_animation_jobs(&animJobs);
+
+	BonePalette bonePalette;
+	init_bone_palette(&bonePalette, skeleton->numBones, NUM_ANIMATED_CHARACTERS, skinningMode);
 
-	mat4* poseMats = (mat4*)malloc(skeleton->numBones * sizeof(mat4));
+	//Crowd skinned entirely on the GPU from baked animations, one draw call and no CPU animation per frame
+	Shader bakedSkinningShader = init_shader("Skinning_baked.vert", "uniform_colour_sunlight.frag");
+	BakedAnimation bakedAnims;
+	bake_animations(&bakedAnims, *skeleton, inverseBindPoses);
+	upload_baked_animation(&bakedAnims);
+
+	#define NUM_BAKED_CHARACTERS 1024
+	BakedCrowd bakedCrowd;
+	init_baked_crowd(&bakedCrowd, NUM_BAKED_CHARACTERS);
+	{
+		BakedInstance* instances = (BakedInstance*)malloc(NUM_BAKED_CHARACTERS * sizeof(BakedInstance));
+		for(uint32 i = 0; i < NUM_BAKED_CHARACTERS; ++i)
+		{
+			mat4 M = translate(identity_mat4(), vec3{-40.0f + 2.5f*(i % 32), 0, -20.0f - 2.5f*(i / 32)});
+			set_baked_instance(&instances[i], bakedAnims, i % bakedAnims.num_clips, 0.37f*i, M);
+		}
+		upload_baked_crowd(&bakedCrowd, instances, NUM_BAKED_CHARACTERS);
+		free(instances);
+	}
 #endif
 
 	check_gl_error();
@@ -246,6 +243,24 @@ int main(){
 
 		poll_joystick(new_input);
 
+		//Hot-reload shaders whose source files changed since last frame
+		{
+			char changed_files[FILE_WATCHER_MAX_CHANGED_FILES][FILE_WATCHER_FILENAME_LENGTH];
+			uint32 num_changed_files = pop_changed_files(&shader_watcher, changed_files, FILE_WATCHER_MAX_CHANGED_FILES);
+
+			Shader* shaders[] = {&basic_shader, &debug_draw_data.shader};
+			for(uint32 shader_index = 0; shader_index < ARRAY_COUNT(shaders); ++shader_index)
+			{
+				for(uint32 file_index = 0; file_index < num_changed_files; ++file_index)
+				{
+					if(shader_uses_file(shaders[shader_index], changed_files[file_index])){
+						reload_shader_program(shaders[shader_index]); //Keeps old program on failure
+						break;
+					}
+				}
+			}
+		}
+
 		if(new_input->use_controller != old_input->use_controller)
 			printf(new_input->use_controller ? "Use Controller\n" : "Don't Use Controller\n");
 		
@@ -352,22 +367,65 @@ int main(){
 
 		//Move player
 		if(!freecam_mode) update_player(&player, game_input, camera, dt);
-		if(player.pos.y < 0){
+		if(player.xform.pos.y < 0){
 			player.is_jumping = false;
 			player.is_on_ground = true;
-			player.pos.y = 0;
+			player.xform.pos.y = 0;
 			player.vel.y = 0;
+			player.M_dirty = true;
 		}
 		
 		//Update camera
 		CameraMode cam_mode = CAM_MODE_FOLLOW_PLAYER;
 		if(freecam_mode) cam_mode = CAM_MODE_DEBUG;
 		
-		update_camera(&camera, cam_mode, game_input, player.pos, dt);
+		update_camera(&camera, cam_mode, game_input, player.xform.pos, dt);
+
+		//Projection only changes with the window's shape
+		static float projection_aspect_ratio = 0.0f;
+		if(window_data.aspect_ratio != projection_aspect_ratio)
+		{
+			camera.P = perspective(90.0f, window_data.aspect_ratio, NEAR_PLANE_Z, FAR_PLANE_Z);
+			projection_aspect_ratio = window_data.aspect_ratio;
+		}
+
+#if 0 // WIP: Animation
+		//Start animating characters on worker threads, joined before we draw them
+		{
+			static float animTime = 0.0f;
+			animTime += dt;
+
+			const KmxAnimation* animation = &skeletonView.animations[CURRENT_ANIM_INDEX];
+			if(animTime > animation->duration)
+				animTime -= animation->duration;
 
-		camera.P = perspective(90.0f, window_data.aspect_ratio, NEAR_PLANE_Z, FAR_PLANE_Z);
+			//Cull every character's bounds against the view frustum in one go
+			static float boundsX[NUM_ANIMATED_CHARACTERS], boundsY[NUM_ANIMATED_CHARACTERS];
+			static float boundsZ[NUM_ANIMATED_CHARACTERS], boundsRadius[NUM_ANIMATED_CHARACTERS];
+			static bool inViewFrustum[NUM_ANIMATED_CHARACTERS];
+			for(uint32 i = 0; i < NUM_ANIMATED_CHARACTERS; ++i)
+			{
+				boundsX[i] = 2.0f*i; boundsY[i] = 3; boundsZ[i] = 0;
+				boundsRadius[i] = 1.5f;
+			}
+			sphere_soa bounds = {boundsX, boundsY, boundsZ, boundsRadius};
+			spheres_in_frustum(frustum_from_matrix(camera.P * camera.V), bounds, inViewFrustum, NUM_ANIMATED_CHARACTERS);
+
+			//Stagger characters through the animation so they don't all move in lockstep
+			for(uint32 i = 0; i < NUM_ANIMATED_CHARACTERS; ++i)
+			{
+				float t = animTime + i * (animation->duration / NUM_ANIMATED_CHARACTERS);
+				if(t > animation->duration) t -= animation->duration;
+				animInstances[i].time = t;
+
+				vec3 boundsCentre = {boundsX[i], boundsY[i], boundsZ[i]};
+				choose_animation_lod(&animLods[i], animLodSettings, camera.pos, boundsCentre, boundsRadius[i], inViewFrustum[i], dt);
+			}
+			kick_animation_jobs(&animJobs, animInstances, NUM_ANIMATED_CHARACTERS);
+		}
+#endif
 
-		add_vec(&debug_draw_data, player.pos + vec3{0, 0.75f, 0}, player.fwd);
+		add_vec(&debug_draw_data, player.xform.pos + vec3{0, 0.75f, 0}, player.fwd);
 
 		glUseProgram(basic_shader.id);
 		glUniformMatrix4fv(basic_shader.V_loc, 1, GL_FALSE, camera.V.m);
@@ -375,21 +433,23 @@ int main(){
 
 		//Draw player
 		glBindVertexArray(player_mesh.vao);
-		glUniform4fv(colour_loc, 1, player.colour.v);
-		glUniformMatrix4fv(basic_shader.M_loc, 1, GL_FALSE, player.M.m);
+		glUniform4fv(basic_shader.colour_loc, 1, player.colour.v);
+		glUniformMatrix4fv(basic_shader.M_loc, 1, GL_FALSE, player_model_mat(&player).m);
         glDrawElements(GL_TRIANGLES, player_mesh.num_indices, GL_UNSIGNED_SHORT, 0);
 
 		//Draw ground
 		glBindVertexArray(cube_mesh.vao);
-		glUniform4fv(colour_loc, 1, vec4{0.8f, 0.1f, 0.2f, 1}.v);
-		glUniformMatrix4fv(basic_shader.M_loc, 1, GL_FALSE, translate(scale_mat4(vec3{25, 0.1, 25}), vec3{0, -0.25 ,0}).m);
+		glUniform4fv(basic_shader.colour_loc, 1, vec4{0.8f, 0.1f, 0.2f, 1}.v);
+		static constexpr mat4 ground_model_mat = translate(scale_mat4(vec3{25, 0.1, 25}), vec3{0, -0.25 ,0});
+		glUniformMatrix4fv(basic_shader.M_loc, 1, GL_FALSE, ground_model_mat.m);
         glDrawElements(GL_TRIANGLES, cube_mesh.num_indices, GL_UNSIGNED_SHORT, 0);
 
 		//Draw some boxes
-		glUniform4fv(colour_loc, 1, vec4{0.2f, 0.1f, 0.8f, 1}.v);
+		glUniform4fv(basic_shader.colour_loc, 1, vec4{0.2f, 0.1f, 0.8f, 1}.v);
 
 		#define NUM_BOXES 5
-		mat4 box_model_mat[NUM_BOXES] = 
+		//Built at compile time, read-only data
+		static constexpr mat4 box_model_mat[NUM_BOXES] = 
 		{
 			translate(scale_mat4(vec3{5, 1, 5}), vec3{-7, 0, -3}),
 			translate(scale_mat4(vec3{5, 1, 5}), vec3{11, 0, -4}),
@@ -405,60 +465,40 @@ int main(){
 
 #if 0 // WIP: Animation
 		glBindVertexArray(kmx_vao);
-		glUniformMatrix4fv(basic_shader.M_loc, 1, GL_FALSE, translate(identity_mat4(), vec3{-3,2,0}).m);
+		static constexpr mat4 kmx_model_mat = translate(identity_mat4(), vec3{-3,2,0});
+		glUniformMatrix4fv(basic_shader.M_loc, 1, GL_FALSE, kmx_model_mat.m);
 		glDrawElements(GL_TRIANGLES, kmx_indexCount, GL_UNSIGNED_SHORT, 0);
 
 		{
-			static float animTime = 0.0f;
-			animTime += dt;
-
-			uint32 CURRENT_ANIM_INDEX = 1;
-
-			KmxAnimation* animations = (KmxAnimation*)(&skeleton->data + skeleton->animationsOffset);
-			KmxAnimation* animation = &animations[CURRENT_ANIM_INDEX];
-			if(animTime > animation->duration)
-				animTime -= animation->duration;
-
-			mat4* inverseBindPoses = (mat4*)(&kmxMesh->data + kmxMesh->inverseBindPosesOffset);
-
-			animate(*skeleton, CURRENT_ANIM_INDEX, animTime, inverseBindPoses, &poseMats);
+			wait_for_animation_jobs(&animJobs);
 
 			glUseProgram(skinningShader.id);
 
-			// {
-			// 	uint32* vbone_ids = (uint32*)(&kmxMesh->data + kmxMesh->vboneIdOffset);
-			// 	float* vbone_weights = (float*)(&kmxMesh->data + kmxMesh->vboneWeightOffset);
-
-			// 	for(uint32 i=0; i < kmxMesh->vertCount; ++i)
-			// 	{
-			// 		mat4 pose0 = poseMats[vbone_ids[4*i]];
-			// 		mat4 pose1 = poseMats[vbone_ids[4*i + 1]];
-			// 		mat4 pose2 = poseMats[vbone_ids[4*i + 2]];
-			// 		mat4 pose3 = poseMats[vbone_ids[4*i + 3]];
-
-			// 		mat4 pose = pose0 * vbone_weights[4*i]
-			// 				  + pose1 * vbone_weights[4*i + 1]
-			// 				  + pose2 * vbone_weights[4*i + 2]
-			// 				  + pose3 * vbone_weights[4*i + 3];
-
-			// 		assert(pose == identity_mat4());
-			// 	}
-			// 	return 0;
-			// }
-
-			for(uint32 i = 0; i < skeleton->numBones; i++) {
-				glUniformMatrix4fv(pose_mats_locs[i], 1, GL_FALSE, poseMats[i].m);
-			}
+			// CPU skinning reference (Skinning.h), e.g. to check Skinning.vert output:
+			// skin_mesh(*kmxMesh.mesh, poseMats, skinnedVp, skinnedVn);
+
+			upload_bone_palette(&bonePalette, poseMats, NUM_ANIMATED_CHARACTERS);
 
-			glUniformMatrix4fv(skinningShader.M_loc, 1, GL_FALSE, translate(identity_mat4(), vec3{0,2,0}).m);
 			glUniformMatrix4fv(skinningShader.V_loc, 1, GL_FALSE, camera.V.m);
 			glUniformMatrix4fv(skinningShader.P_loc, 1, GL_FALSE, camera.P.m);
-			glUniform4fv(glGetUniformLocation(skinningShader.id, "colour"), 1, vec4{0.8f, 0.1f, 0.6f, 1}.v);
-
+			glUniform4fv(skinningShader.colour_loc, 1, vec4{0.8f, 0.1f, 0.6f, 1}.v);
 			glBindVertexArray(kmx_vao);
-			glDrawElements(GL_TRIANGLES, kmx_indexCount, GL_UNSIGNED_SHORT, 0);
 
+			for(uint32 i = 0; i < NUM_ANIMATED_CHARACTERS; ++i)
+			{
+				if(animLods[i].level == ANIMATION_LOD_OFFSCREEN) continue;
+
+				bind_bone_palette(&bonePalette, skinningShader, i);
+				glUniformMatrix4fv(skinningShader.M_loc, 1, GL_FALSE, translate(identity_mat4(), vec3{2.0f*i, 2, 0}).m);
+				glDrawElements(GL_TRIANGLES, kmx_indexCount, GL_UNSIGNED_SHORT, 0);
+			}
 		}
+
+		glUseProgram(bakedSkinningShader.id);
+		glUniformMatrix4fv(bakedSkinningShader.V_loc, 1, GL_FALSE, camera.V.m);
+		glUniformMatrix4fv(bakedSkinningShader.P_loc, 1, GL_FALSE, camera.P.m);
+		glUniform4fv(bakedSkinningShader.colour_loc, 1, vec4{0.3f, 0.6f, 0.3f, 1}.v);
+		draw_baked_crowd(bakedCrowd, bakedAnims, bakedSkinningShader, kmx_vao, kmx_indexCount, (float)curr_time);
 #endif
 		debug_draw_flush(&debug_draw_data, camera);
 
@@ -467,5 +507,14 @@ int main(){
 		check_gl_error();
 	}//end main loop
 
+	shutdown_file_watcher(&shader_watcher);
+#if 0 // WIP: Animation
+	shutdown_animation_jobs(&animJobs);
+	delete_baked_crowd(&bakedCrowd);
+	delete_baked_animation(&bakedAnims);
+	release_kmx_skeleton(&skeletonView);
+	release_kmx_mesh(&kmxMesh);
+#endif
+
     return 0;
 }
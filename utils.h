@@ -27,6 +27,8 @@ typedef double f64;
 #define global_variable static
 #define local_persist static
 
+#define ARRAY_COUNT(arr) (sizeof(arr)/sizeof((arr)[0]))
+
 //Custom assert function which pauses program in debugger instead of crashing
 #if DEBUG_BUILD 
 #if defined(__clang__) || defined(__GNUC__)